@@ -0,0 +1,189 @@
+/*************************************************************************
+* Interrupt driven I2C (TWI) transmit queue for MicroLCD
+*
+* Queue layout: [address][length][data...] per transmission. The caller
+* writes at the producer index and commits a whole transmission at once,
+* the TWI interrupt consumes committed transmissions back to back using
+* repeated starts and releases the bus when the queue is empty.
+*************************************************************************/
+
+#include "LCDBus.h"
+
+#ifdef MICROLCD_ASYNC_TWI
+
+#include <avr/interrupt.h>
+#include <util/twi.h>
+
+#define QUEUE_MASK (ASYNC_TWI_QUEUE_SIZE - 1)
+
+#if (ASYNC_TWI_QUEUE_SIZE & QUEUE_MASK) != 0 || ASYNC_TWI_QUEUE_SIZE > 256
+#error "ASYNC_TWI_QUEUE_SIZE must be a power of 2 no larger than 256"
+#endif
+
+AsyncTwiClass AsyncTwi;
+
+static volatile uint8_t queue[ASYNC_TWI_QUEUE_SIZE];
+static volatile uint8_t queue_head = 0;     // end of the committed transmissions
+static volatile uint8_t queue_tail = 0;     // next byte the interrupt will send
+static volatile uint8_t tx_remaining = 0;   // data bytes left in the transmission on the bus
+static volatile bool tx_busy = false;
+static volatile uint16_t tx_errors = 0;
+static uint32_t tx_bytes = 0;
+static uint8_t write_index = 0;             // producer index of the open transmission
+
+#define TWCR_ENABLE (_BV(TWEN) | _BV(TWIE) | _BV(TWINT))
+
+static inline uint8_t queue_free()
+{
+    return (queue_tail - write_index - 1) & QUEUE_MASK;
+}
+
+static inline uint8_t queue_pop()
+{
+    uint8_t tail = queue_tail;
+    uint8_t b = queue[tail];
+    queue_tail = (tail + 1) & QUEUE_MASK;
+    return b;
+}
+
+// Start the next committed transmission or release the bus
+static inline void start_next()
+{
+    if (queue_tail != queue_head) {
+        TWCR = TWCR_ENABLE | _BV(TWSTA);
+    } else {
+        TWCR = _BV(TWEN) | _BV(TWINT) | _BV(TWSTO);
+        tx_busy = false;
+    }
+}
+
+ISR(TWI_vect)
+{
+    switch (TW_STATUS) {
+    case TW_START:
+    case TW_REP_START:
+        TWDR = queue_pop() << 1;    // SLA+W
+        tx_remaining = queue_pop();
+        TWCR = TWCR_ENABLE;
+        break;
+    case TW_MT_SLA_ACK:
+    case TW_MT_DATA_ACK:
+        if (tx_remaining) {
+            TWDR = queue_pop();
+            tx_remaining--;
+            TWCR = TWCR_ENABLE;
+        } else {
+            start_next();
+        }
+        break;
+    case TW_MT_SLA_NACK:
+    case TW_MT_DATA_NACK:
+    case TW_MT_ARB_LOST:
+    default:
+        // Drop the rest of this transmission and carry on with the next one
+        tx_errors++;
+        queue_tail = (queue_tail + tx_remaining) & QUEUE_MASK;
+        tx_remaining = 0;
+        // Stop to reset the bus, a start straight after it if there is more to send
+        if (queue_tail != queue_head) {
+            TWCR = TWCR_ENABLE | _BV(TWSTO) | _BV(TWSTA);
+        } else {
+            TWCR = _BV(TWEN) | _BV(TWINT) | _BV(TWSTO);
+            tx_busy = false;
+        }
+        break;
+    }
+}
+
+void AsyncTwiClass::begin()
+{
+    // Internal pull ups, as Wire does
+    digitalWrite(SDA, HIGH);
+    digitalWrite(SCL, HIGH);
+    TWSR = 0;   // prescaler 1
+    TWCR = _BV(TWEN);
+}
+
+void AsyncTwiClass::setClock(uint32_t frequency)
+{
+    flush();
+    TWBR = ((F_CPU / frequency) - 16) / 2;
+}
+
+void AsyncTwiClass::beginTransmission(uint8_t address)
+{
+    // Reserve the address and length bytes
+    while (queue_free() < 2) ;
+    m_start = write_index;
+    queue[write_index] = address;
+    write_index = (write_index + 2) & QUEUE_MASK;
+    m_length = 0;
+    m_open = true;
+}
+
+size_t AsyncTwiClass::write(uint8_t data)
+{
+    if (!m_open || m_length >= ASYNC_TWI_MAX_TRANSMISSION) return 0;
+    while (queue_free() == 0) ;  // the interrupt is sending earlier transmissions
+    queue[write_index] = data;
+    write_index = (write_index + 1) & QUEUE_MASK;
+    m_length++;
+    return 1;
+}
+
+size_t AsyncTwiClass::write(const uint8_t *data, size_t length)
+{
+    size_t written = 0;
+    while (written < length && write(data[written])) written++;
+    return written;
+}
+
+uint8_t AsyncTwiClass::endTransmission()
+{
+    if (!m_open) return 4;
+    m_open = false;
+    queue[(m_start + 1) & QUEUE_MASK] = m_length;
+    tx_bytes += m_length + 1;
+
+    uint8_t intr_state = SREG;
+    cli();
+    queue_head = write_index;
+    if (!tx_busy) {
+        tx_busy = true;
+        while (TWCR & _BV(TWSTO)) ;     // let the previous stop finish
+        TWCR = TWCR_ENABLE | _BV(TWSTA);
+    }
+    SREG = intr_state;
+    return 0;
+}
+
+bool AsyncTwiClass::isBusy()
+{
+    return tx_busy;
+}
+
+void AsyncTwiClass::flush()
+{
+    while (tx_busy) ;
+}
+
+uint8_t AsyncTwiClass::queueFree()
+{
+    return queue_free();
+}
+
+uint16_t AsyncTwiClass::errorCount()
+{
+    uint8_t intr_state = SREG;
+    cli();
+    uint16_t errors = tx_errors;
+    SREG = intr_state;
+    return errors;
+}
+
+uint32_t AsyncTwiClass::bytesSent()
+{
+    return tx_bytes;
+}
+
+#endif
@@ -0,0 +1,49 @@
+/*************************************************************************
+* Interrupt driven I2C (TWI) transmit queue for MicroLCD
+* Mirrors the transmit half of the Wire API so the display drivers can
+* queue their transmissions and return while the TWI interrupt sends them.
+*************************************************************************/
+
+#ifndef ASYNC_TWI_H
+#define ASYNC_TWI_H
+
+#include <Arduino.h>
+
+// Size of the transmit queue in bytes, must be a power of 2. Each transmission
+// uses two extra bytes for its address and length
+#ifndef ASYNC_TWI_QUEUE_SIZE
+#define ASYNC_TWI_QUEUE_SIZE 128
+#endif
+
+// Longest single transmission, the same limit Wire has
+#define ASYNC_TWI_MAX_TRANSMISSION 32
+
+class AsyncTwiClass
+{
+public:
+    void begin();
+    void setClock(uint32_t frequency);
+    void beginTransmission(uint8_t address);
+    size_t write(uint8_t data);
+    size_t write(const uint8_t *data, size_t length);
+    // Queue the transmission and return straight away. Waits only when the queue is full
+    uint8_t endTransmission();
+    // Is the bus still sending queued transmissions?
+    bool isBusy();
+    // Wait until everything queued has been sent
+    void flush();
+    // Bytes that can be queued without waiting, each transmission also takes two for its address and length
+    uint8_t queueFree();
+    // Transmissions dropped because a device did not acknowledge or the bus failed
+    uint16_t errorCount();
+    // Bytes queued since startup including the address bytes, for measuring bus usage
+    uint32_t bytesSent();
+private:
+    uint8_t m_start;
+    uint8_t m_length;
+    bool m_open;
+};
+
+extern AsyncTwiClass AsyncTwi;
+
+#endif
@@ -0,0 +1,32 @@
+/*************************************************************************
+* I2C transport used by the MicroLCD display drivers
+*
+* With MICROLCD_ASYNC_TWI the drivers queue their transmissions into
+* AsyncTwi and return while the TWI interrupt sends them, otherwise they
+* block in Wire. The bus clock is set once in begin().
+*************************************************************************/
+
+#ifndef LCD_BUS_H
+#define LCD_BUS_H
+
+#define MICROLCD_ASYNC_TWI
+#define MICROLCD_I2C_CLOCK 400000
+
+#ifdef MICROLCD_ASYNC_TWI
+#include "AsyncTwi.h"
+#define LCD_I2C AsyncTwi
+#else
+#include <Wire.h>
+#define LCD_I2C Wire
+#endif
+
+// Largest data run per transmission, the transmit buffer also holds the control byte
+#if defined(MICROLCD_ASYNC_TWI)
+#define SSD1306_DATA_CHUNK (ASYNC_TWI_MAX_TRANSMISSION - 1)
+#elif defined(BUFFER_LENGTH)
+#define SSD1306_DATA_CHUNK (BUFFER_LENGTH - 1)
+#else
+#define SSD1306_DATA_CHUNK 31
+#endif
+
+#endif
@@ -6,7 +6,7 @@
 *************************************************************************/
 
 #include <Arduino.h>
-#include <Wire.h>
+#include "LCDBus.h"
 #include "MicroLCD.h"
 
 // fonts data
@@ -299,29 +299,25 @@ size_t LCD_SSD1306::write(uint8_t c)
         m_col = 0;
         return 1;
     }
-#ifdef TWBR
-    uint8_t twbrbackup = TWBR;
-    TWBR = 18; // upgrade to 400KHz!
-#endif
 #ifndef MEMORY_SAVING
     if (m_font == FONT_SIZE_SMALL) {
 #endif
-        Wire.beginTransmission(_i2caddr);
-        Wire.write(0x40);
+        LCD_I2C.beginTransmission(_i2caddr);
+        LCD_I2C.write(0x40);
         if (c > 0x20 && c < 0x7f) {
             c -= 0x21;
             for (byte i = 0; i < 5; i++) {
                 byte d = pgm_read_byte(&font5x8[c][i]);
-                Wire.write(d);
-                if (m_flags & FLAG_PIXEL_DOUBLE_H) Wire.write(d);
+                LCD_I2C.write(d);
+                if (m_flags & FLAG_PIXEL_DOUBLE_H) LCD_I2C.write(d);
             }
-            Wire.write(0);
+            LCD_I2C.write(0);
         } else {
             for (byte i = (m_flags & FLAG_PIXEL_DOUBLE_H) ? 11 : 6; i > 0; i--) {
-                Wire.write(0);
+                LCD_I2C.write(0);
             }
         }
-        Wire.endTransmission();
+        LCD_I2C.endTransmission();
         m_col += (m_flags & FLAG_PIXEL_DOUBLE_H) ? 11 : 6;
         if (m_col >= 128) {
             m_col = 0;
@@ -336,49 +332,49 @@ size_t LCD_SSD1306::write(uint8_t c)
             ssd1306_command(m_col & 0xf);//set lower column address
             ssd1306_command(0x10 | (m_col >> 4));//set higher column address
 
-            Wire.beginTransmission(_i2caddr);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(_i2caddr);
+            LCD_I2C.write(0x40);
             for (byte i = 0; i <= 14; i += 2) {
                 byte d = pgm_read_byte(&font8x16_terminal[c][i]);
-                Wire.write(d);
-                if (m_flags & FLAG_PIXEL_DOUBLE_H) Wire.write(d);
+                LCD_I2C.write(d);
+                if (m_flags & FLAG_PIXEL_DOUBLE_H) LCD_I2C.write(d);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
 
             ssd1306_command(0xB0 + m_row + 1);//set page address
             ssd1306_command(m_col & 0xf);//set lower column address
             ssd1306_command(0x10 | (m_col >> 4));//set higher column address
 
-            Wire.beginTransmission(_i2caddr);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(_i2caddr);
+            LCD_I2C.write(0x40);
             for (byte i = 1; i <= 15; i += 2) {
                 byte d = pgm_read_byte(&font8x16_terminal[c][i]);
-                Wire.write(d);
-                if (m_flags & FLAG_PIXEL_DOUBLE_H) Wire.write(d);
+                LCD_I2C.write(d);
+                if (m_flags & FLAG_PIXEL_DOUBLE_H) LCD_I2C.write(d);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
         } else {
             ssd1306_command(0xB0 + m_row);//set page address
             ssd1306_command(m_col & 0xf);//set lower column address
             ssd1306_command(0x10 | (m_col >> 4));//set higher column address
 
-            Wire.beginTransmission(_i2caddr);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(_i2caddr);
+            LCD_I2C.write(0x40);
             for (byte i = (m_flags & FLAG_PIXEL_DOUBLE_H) ? 16 : 8; i > 0; i--) {
-                Wire.write(0);
+                LCD_I2C.write(0);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
 
             ssd1306_command(0xB0 + m_row + 1);//set page address
             ssd1306_command(m_col & 0xf);//set lower column address
             ssd1306_command(0x10 | (m_col >> 4));//set higher column address
 
-            Wire.beginTransmission(_i2caddr);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(_i2caddr);
+            LCD_I2C.write(0x40);
             for (byte i = (m_flags & FLAG_PIXEL_DOUBLE_H) ? 16 : 8; i > 0; i--) {
-                Wire.write(0);
+                LCD_I2C.write(0);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
         }
         m_col += (m_flags & FLAG_PIXEL_DOUBLE_H) ? 17 : 9;
         if (m_col >= 128) {
@@ -386,34 +382,114 @@ size_t LCD_SSD1306::write(uint8_t c)
             m_row += 2;
         }
     }
-#endif
-#ifdef TWBR
-    TWBR = twbrbackup;
 #endif
     return 1;
 }
 
-void LCD_SSD1306::writeDigit(byte n)
+// Column advance of a glyph when text can be drawn as a run, 0 when it has to go a character at a time
+byte LCD_SSD1306::runAdvance()
 {
-#ifdef TWBR
-    uint8_t twbrbackup = TWBR;
-    TWBR = 18; // upgrade to 400KHz!
+    if (m_flags & FLAG_PIXEL_DOUBLE_H) return 0;
+    if (m_font == FONT_SIZE_SMALL) return 6;
+#ifndef MEMORY_SAVING
+    if (m_font == FONT_SIZE_MEDIUM) return 9;
 #endif
+    return 0;
+}
+
+// Draw one page row of a run of glyphs with a single addressing transmission and the
+// columns packed into as few data transmissions as the transmit buffer allows
+void LCD_SSD1306::writeRun(const uint8_t *text, byte count, byte pageOffset)
+{
+    byte buffer[SSD1306_DATA_CHUNK];
+    byte length = 0;
+    byte glyph[16];
+    byte advance = runAdvance();
+
+    setAddress(m_row + pageOffset, m_col);
+    for (byte n = 0; n < count; n++) {
+        byte c = text[n];
+        // One flash block read per glyph rather than a pgm_read_byte per column
+        memset(glyph, 0, sizeof(glyph));
+        if (c > 0x20 && c < 0x7f) {
+            if (m_font == FONT_SIZE_SMALL) {
+                memcpy_P(glyph, font5x8[c - 0x21], 5);
+            } else {
+                // The 8x16 font is interleaved top page, bottom page per column
+                byte columns[16];
+                memcpy_P(columns, font8x16_terminal[c - 0x21], 16);
+                for (byte i = 0; i < 8; i++) glyph[i] = columns[i * 2 + pageOffset];
+            }
+        }
+        for (byte i = 0; i < advance; i++) {
+            buffer[length++] = glyph[i];
+            if (length == SSD1306_DATA_CHUNK) {
+                LCD_I2C.beginTransmission(_i2caddr);
+                LCD_I2C.write(0x40);
+                LCD_I2C.write(buffer, length);
+                LCD_I2C.endTransmission();
+                length = 0;
+            }
+        }
+    }
+    if (length > 0) {
+        LCD_I2C.beginTransmission(_i2caddr);
+        LCD_I2C.write(0x40);
+        LCD_I2C.write(buffer, length);
+        LCD_I2C.endTransmission();
+    }
+}
+
+// Strings are drawn a page row at a time instead of addressing the display for every character.
+// Anything that needs wrapping, a line break or a font without a run path goes through write(c).
+// The control panel only draws its text through here when built without LCD_FRAMEBUFFER, the
+// framebuffer sends the changed columns with writePage() which packs them into bursts the same way
+size_t LCD_SSD1306::write(const uint8_t *buffer, size_t size)
+{
+    size_t done = 0;
+    while (done < size) {
+        byte advance = runAdvance();
+        byte count = 0;
+        if (advance > 0) {
+            while (done + count < size && count < 255 && buffer[done + count] != '\n' && buffer[done + count] != '\r'
+                && m_col + (count + 1) * advance <= 128) {
+                count++;
+            }
+        }
+        if (count == 0) {
+            write(buffer[done++]);
+            continue;
+        }
+
+        writeRun(buffer + done, count, 0);
+        if (m_font != FONT_SIZE_SMALL) writeRun(buffer + done, count, 1);
+        m_col += count * advance;
+        done += count;
+        if (m_col >= 128) {
+            m_col = 0;
+            m_row += (m_font == FONT_SIZE_SMALL) ? 1 : 2;
+        }
+    }
+    return size;
+}
+
+void LCD_SSD1306::writeDigit(byte n)
+{
     if (m_font == FONT_SIZE_SMALL) {
-        Wire.beginTransmission(_i2caddr);
-        Wire.write(0x40);
+        LCD_I2C.beginTransmission(_i2caddr);
+        LCD_I2C.write(0x40);
         if (n <= 9) {
             n += '0' - 0x21;
             for (byte i = 0; i < 5; i++) {
-                Wire.write(pgm_read_byte(&font5x8[n][i]));
+                LCD_I2C.write(pgm_read_byte(&font5x8[n][i]));
             }
-            Wire.write(0);
+            LCD_I2C.write(0);
         } else {
             for (byte i = 0; i < 6; i++) {
-                Wire.write(0);
+                LCD_I2C.write(0);
             }
         }
-        Wire.endTransmission();
+        LCD_I2C.endTransmission();
         m_col += 6;
     } else if (m_font == FONT_SIZE_MEDIUM) {
         write(n <= 9 ? ('0' + n) : ' ');
@@ -425,49 +501,49 @@ void LCD_SSD1306::writeDigit(byte n)
             ssd1306_command(m_col & 0xf);//set lower column address
             ssd1306_command(0x10 | (m_col >> 4));//set higher column address
 
-            Wire.beginTransmission(_i2caddr);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(_i2caddr);
+            LCD_I2C.write(0x40);
             for (i = 0; i < 16; i ++) {
                 byte d = pgm_read_byte(&digits16x16[n][i]);
-                Wire.write(d);
-                if (m_flags & FLAG_PIXEL_DOUBLE_H) Wire.write(d);
+                LCD_I2C.write(d);
+                if (m_flags & FLAG_PIXEL_DOUBLE_H) LCD_I2C.write(d);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
 
             ssd1306_command(0xB0 + m_row + 1);//set page address
             ssd1306_command(m_col & 0xf);//set lower column address
             ssd1306_command(0x10 | (m_col >> 4));//set higher column address
 
-            Wire.beginTransmission(_i2caddr);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(_i2caddr);
+            LCD_I2C.write(0x40);
             for (; i < 32; i ++) {
                 byte d = pgm_read_byte(&digits16x16[n][i]);
-                Wire.write(d);
-                if (m_flags & FLAG_PIXEL_DOUBLE_H) Wire.write(d);
+                LCD_I2C.write(d);
+                if (m_flags & FLAG_PIXEL_DOUBLE_H) LCD_I2C.write(d);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
         } else {
             ssd1306_command(0xB0 + m_row);//set page address
             ssd1306_command(m_col & 0xf);//set lower column address
             ssd1306_command(0x10 | (m_col >> 4));//set higher column address
 
-            Wire.beginTransmission(_i2caddr);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(_i2caddr);
+            LCD_I2C.write(0x40);
             for (byte i = (m_flags & FLAG_PIXEL_DOUBLE_H) ? 32 : 16; i > 0; i--) {
-                Wire.write(0);
+                LCD_I2C.write(0);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
 
             ssd1306_command(0xB0 + m_row + 1);//set page address
             ssd1306_command(m_col & 0xf);//set lower column address
             ssd1306_command(0x10 | (m_col >> 4));//set higher column address
 
-            Wire.beginTransmission(_i2caddr);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(_i2caddr);
+            LCD_I2C.write(0x40);
             for (byte i = (m_flags & FLAG_PIXEL_DOUBLE_H) ? 32 : 16; i > 0; i--) {
-                Wire.write(0);
+                LCD_I2C.write(0);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
         }
         m_col += (m_flags & FLAG_PIXEL_DOUBLE_H) ? 30 : 16;
 #endif
@@ -478,79 +554,76 @@ void LCD_SSD1306::writeDigit(byte n)
             ssd1306_command(m_col & 0xf);//set lower column address
             ssd1306_command(0x10 | (m_col >> 4));//set higher column address
 
-            Wire.beginTransmission(_i2caddr);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(_i2caddr);
+            LCD_I2C.write(0x40);
             for (i = 0; i < 16; i ++) {
                 byte d = pgm_read_byte(&digits16x24[n][i * 3]);
-                Wire.write(d);
-                if (m_flags & FLAG_PIXEL_DOUBLE_H) Wire.write(d);
+                LCD_I2C.write(d);
+                if (m_flags & FLAG_PIXEL_DOUBLE_H) LCD_I2C.write(d);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
 
             ssd1306_command(0xB0 + m_row + 1);//set page address
             ssd1306_command(m_col & 0xf);//set lower column address
             ssd1306_command(0x10 | (m_col >> 4));//set higher column address
 
-            Wire.beginTransmission(_i2caddr);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(_i2caddr);
+            LCD_I2C.write(0x40);
             for (i = 0; i < 16; i ++) {
                 byte d = pgm_read_byte(&digits16x24[n][i * 3 + 1]);
-                Wire.write(d);
-                if (m_flags & FLAG_PIXEL_DOUBLE_H) Wire.write(d);
+                LCD_I2C.write(d);
+                if (m_flags & FLAG_PIXEL_DOUBLE_H) LCD_I2C.write(d);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
 
             ssd1306_command(0xB0 + m_row + 2);//set page address
             ssd1306_command(m_col & 0xf);//set lower column address
             ssd1306_command(0x10 | (m_col >> 4));//set higher column address
 
-            Wire.beginTransmission(_i2caddr);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(_i2caddr);
+            LCD_I2C.write(0x40);
             for (i = 0; i < 16; i ++) {
                 byte d = pgm_read_byte(&digits16x24[n][i * 3 + 2]);
-                Wire.write(d);
-                if (m_flags & FLAG_PIXEL_DOUBLE_H) Wire.write(d);
+                LCD_I2C.write(d);
+                if (m_flags & FLAG_PIXEL_DOUBLE_H) LCD_I2C.write(d);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
         } else {
             ssd1306_command(0xB0 + m_row);//set page address
             ssd1306_command(m_col & 0xf);//set lower column address
             ssd1306_command(0x10 | (m_col >> 4));//set higher column address
 
-            Wire.beginTransmission(_i2caddr);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(_i2caddr);
+            LCD_I2C.write(0x40);
             for (byte i = (m_flags & FLAG_PIXEL_DOUBLE_H) ? 32 : 16; i > 0; i--) {
-                Wire.write(0);
+                LCD_I2C.write(0);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
 
             ssd1306_command(0xB0 + m_row + 1);//set page address
             ssd1306_command(m_col & 0xf);//set lower column address
             ssd1306_command(0x10 | (m_col >> 4));//set higher column address
 
-            Wire.beginTransmission(_i2caddr);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(_i2caddr);
+            LCD_I2C.write(0x40);
             for (byte i = (m_flags & FLAG_PIXEL_DOUBLE_H) ? 32 : 16; i > 0; i--) {
-                Wire.write(0);
+                LCD_I2C.write(0);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
 
             ssd1306_command(0xB0 + m_row + 2);//set page address
             ssd1306_command(m_col & 0xf);//set lower column address
             ssd1306_command(0x10 | (m_col >> 4));//set higher column address
 
-            Wire.beginTransmission(_i2caddr);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(_i2caddr);
+            LCD_I2C.write(0x40);
             for (byte i = (m_flags & FLAG_PIXEL_DOUBLE_H) ? 32 : 16; i > 0; i--) {
-                Wire.write(0);
+                LCD_I2C.write(0);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
         }
         m_col += (m_flags & FLAG_PIXEL_DOUBLE_H) ? 30 : 16;
     }
-#ifdef TWBR
-    TWBR = twbrbackup;
-#endif
 }
 
 void LCD_SSD1306::draw(const PROGMEM byte* buffer, byte width, byte height)
@@ -562,10 +635,6 @@ void LCD_SSD1306::draw(const PROGMEM byte* buffer, byte width, byte height)
     const PROGMEM byte *p = buffer;
     height >>= 3;
     width >>= 3;
-#ifdef TWBR
-    uint8_t twbrbackup = TWBR;
-    TWBR = 18; // upgrade to 400KHz!
-#endif
     for (byte i = 0; i < height; i++) {
       // send a bunch of data in one xmission
         ssd1306_command(0xB0 + i + m_row);//set page address
@@ -573,18 +642,15 @@ void LCD_SSD1306::draw(const PROGMEM byte* buffer, byte width, byte height)
         ssd1306_command(0x10 | (m_col >> 4));//set higher column address
 
         for(byte j = 0; j < 8; j++){
-            Wire.beginTransmission(_i2caddr);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(_i2caddr);
+            LCD_I2C.write(0x40);
             for (byte k = 0; k < width; k++, p++) {
-                Wire.write(pgm_read_byte(p));
+                LCD_I2C.write(pgm_read_byte(p));
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
         }
     }
     m_col += width;
-#ifdef TWBR
-    TWBR = twbrbackup;
-#endif
 }
 
 void LCD_SSD1306::clearLine(byte line)
@@ -593,10 +659,6 @@ void LCD_SSD1306::clearLine(byte line)
     ssd1306_command(SSD1306_SETHIGHCOLUMN | 0x0);  // hi col = 0
     ssd1306_command(SSD1306_SETSTARTLINE | 0x0); // line #0
 
-#ifdef TWBR
-    uint8_t twbrbackup = TWBR;
-    TWBR = 18; // upgrade to 400KHz!
-#endif
 
     // send a bunch of data in one xmission
     ssd1306_command(0xB0 + line);//set page address
@@ -604,16 +666,13 @@ void LCD_SSD1306::clearLine(byte line)
     ssd1306_command(0x10);//set higher column address
 
     for(byte j = 0; j < 8; j++){
-        Wire.beginTransmission(_i2caddr);
-        Wire.write(0x40);
+        LCD_I2C.beginTransmission(_i2caddr);
+        LCD_I2C.write(0x40);
         for (byte k = 0; k < 16; k++) {
-            Wire.write(0);
+            LCD_I2C.write(0);
         }
-        Wire.endTransmission();
+        LCD_I2C.endTransmission();
     }
-#ifdef TWBR
-    TWBR = twbrbackup;
-#endif
 }
 
 void LCD_SSD1306::clear(byte x, byte y, byte width, byte height)
@@ -625,10 +684,6 @@ void LCD_SSD1306::clear(byte x, byte y, byte width, byte height)
     height >>= 3;
     width >>= 3;
     y >>= 3;
-#ifdef TWBR
-    uint8_t twbrbackup = TWBR;
-    TWBR = 18; // upgrade to 400KHz!
-#endif
     for (byte i = 0; i < height; i++) {
       // send a bunch of data in one xmission
         ssd1306_command(0xB0 + i + y);//set page address
@@ -636,17 +691,14 @@ void LCD_SSD1306::clear(byte x, byte y, byte width, byte height)
         ssd1306_command(0x10 | (x >> 4));//set higher column address
 
         for(byte j = 0; j < 8; j++){
-            Wire.beginTransmission(_i2caddr);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(_i2caddr);
+            LCD_I2C.write(0x40);
             for (byte k = 0; k < width; k++) {
-                Wire.write(0);
+                LCD_I2C.write(0);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
         }
     }
-#ifdef TWBR
-    TWBR = twbrbackup;
-#endif
     setCursor(0, 0);
 }
 
@@ -66,12 +66,16 @@ public:
 	void setContrast(byte Contrast);
     void draw(const PROGMEM byte* buffer, byte width, byte height);
     size_t write(uint8_t c);
+    size_t write(const uint8_t *buffer, size_t size);
+    using Print::write;
     void clear(byte x = 0, byte y = 0, byte width = 128, byte height = 64);
     void clearLine(byte line);
     byte getLines() { return 21; }
     byte getCols() { return 8; }
 private:
     void writeDigit(byte n);
+    byte runAdvance();
+    void writeRun(const uint8_t *text, byte count, byte pageOffset);
     byte m_col;
     byte m_row;
 };
@@ -79,7 +83,7 @@ private:
 class LCD_SH1106 : public LCD_Common, public Print
 {
 public:
-    void begin();
+    void begin(byte i2caddr = 0x3C);
     void setCursor(byte column, byte line);
     void draw(const PROGMEM byte* buffer, byte width, byte height);
     size_t write(uint8_t c);
@@ -93,6 +97,7 @@ private:
     void writeDigit(byte n);
     byte m_col;
     byte m_row;
+    byte m_i2caddr;
 };
 
 #include "PCD8544.h"
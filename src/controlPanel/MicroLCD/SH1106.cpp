@@ -1,23 +1,22 @@
 #include <Arduino.h>
-#include <Wire.h>
+#include "LCDBus.h"
 #include "MicroLCD.h"
 
-#define I2C_ADDR 0x78 >> 1
 
 void LCD_SH1106::WriteCommand(unsigned char ins)
 {
-  Wire.beginTransmission(I2C_ADDR);//0x78 >> 1
-  Wire.write(0x00);//0x00
-  Wire.write(ins);
-  Wire.endTransmission();
+  LCD_I2C.beginTransmission(m_i2caddr);
+  LCD_I2C.write(0x00);//0x00
+  LCD_I2C.write(ins);
+  LCD_I2C.endTransmission();
 }
 
 void LCD_SH1106::WriteData(unsigned char dat)
 {
-  Wire.beginTransmission(I2C_ADDR);//0x78 >> 1
-  Wire.write(0x40);//0x40
-  Wire.write(dat);
-  Wire.endTransmission();
+  LCD_I2C.beginTransmission(m_i2caddr);
+  LCD_I2C.write(0x40);//0x40
+  LCD_I2C.write(dat);
+  LCD_I2C.endTransmission();
 }
 
 void LCD_SH1106::setCursor(unsigned char x, unsigned char y)
@@ -38,10 +37,6 @@ void LCD_SH1106::clear(byte x, byte y, byte width, byte height)
     height >>= 3;
     width >>= 3;
     y >>= 3;
-#ifdef TWBR
-    uint8_t twbrbackup = TWBR;
-    TWBR = 18; // upgrade to 400KHz!
-#endif
     for (byte i = 0; i < height; i++) {
       // send a bunch of data in one xmission
         WriteCommand(0xB0 + i + y);//set page address
@@ -49,17 +44,14 @@ void LCD_SH1106::clear(byte x, byte y, byte width, byte height)
         WriteCommand(0x10 | (x >> 4));//set higher column address
 
         for(byte j = 0; j < 8; j++){
-            Wire.beginTransmission(I2C_ADDR);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(m_i2caddr);
+            LCD_I2C.write(0x40);
             for (byte k = 0; k < width; k++) {
-                Wire.write(0);
+                LCD_I2C.write(0);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
         }
     }
-#ifdef TWBR
-    TWBR = twbrbackup;
-#endif
     setCursor(0, 0);
 }
 
@@ -73,29 +65,25 @@ size_t LCD_SH1106::write(uint8_t c)
         return 1;
     }
 
-#ifdef TWBR
-    uint8_t twbrbackup = TWBR;
-    TWBR = 18; // upgrade to 400KHz!
-#endif
 #ifndef MEMORY_SAVING
     if (m_font == FONT_SIZE_SMALL) {
 #endif
-        Wire.beginTransmission(I2C_ADDR);
-        Wire.write(0x40);
+        LCD_I2C.beginTransmission(m_i2caddr);
+        LCD_I2C.write(0x40);
         if (c > 0x20 && c < 0x7f) {
             c -= 0x21;
             for (byte i = 0; i < 5; i++) {
                 byte d = pgm_read_byte(&font5x8[c][i]);
-                Wire.write(d);
-                if (m_flags & FLAG_PIXEL_DOUBLE_H) Wire.write(d);
+                LCD_I2C.write(d);
+                if (m_flags & FLAG_PIXEL_DOUBLE_H) LCD_I2C.write(d);
             }
-            Wire.write(0);
+            LCD_I2C.write(0);
         } else {
             for (byte i = (m_flags & FLAG_PIXEL_DOUBLE_H) ? 11 : 6; i > 0; i--) {
-                Wire.write(0);
+                LCD_I2C.write(0);
             }
         }
-        Wire.endTransmission();
+        LCD_I2C.endTransmission();
         m_col += (m_flags & FLAG_PIXEL_DOUBLE_H) ? 11 : 6;
         if (m_col >= 128) {
             m_col = 0;
@@ -110,49 +98,49 @@ size_t LCD_SH1106::write(uint8_t c)
             WriteCommand(m_col & 0xf);//set lower column address
             WriteCommand(0x10 | (m_col >> 4));//set higher column address
 
-            Wire.beginTransmission(I2C_ADDR);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(m_i2caddr);
+            LCD_I2C.write(0x40);
             for (byte i = 0; i <= 14; i += 2) {
                 byte d = pgm_read_byte(&font8x16_terminal[c][i]);
-                Wire.write(d);
-                if (m_flags & FLAG_PIXEL_DOUBLE_H) Wire.write(d);
+                LCD_I2C.write(d);
+                if (m_flags & FLAG_PIXEL_DOUBLE_H) LCD_I2C.write(d);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
 
             WriteCommand(0xB0 + m_row + 1);//set page address
             WriteCommand(m_col & 0xf);//set lower column address
             WriteCommand(0x10 | (m_col >> 4));//set higher column address
 
-            Wire.beginTransmission(I2C_ADDR);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(m_i2caddr);
+            LCD_I2C.write(0x40);
             for (byte i = 1; i <= 15; i += 2) {
                 byte d = pgm_read_byte(&font8x16_terminal[c][i]);
-                Wire.write(d);
-                if (m_flags & FLAG_PIXEL_DOUBLE_H) Wire.write(d);
+                LCD_I2C.write(d);
+                if (m_flags & FLAG_PIXEL_DOUBLE_H) LCD_I2C.write(d);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
         } else {
             WriteCommand(0xB0 + m_row);//set page address
             WriteCommand(m_col & 0xf);//set lower column address
             WriteCommand(0x10 | (m_col >> 4));//set higher column address
 
-            Wire.beginTransmission(I2C_ADDR);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(m_i2caddr);
+            LCD_I2C.write(0x40);
             for (byte i = (m_flags & FLAG_PIXEL_DOUBLE_H) ? 16 : 8; i > 0; i--) {
-                Wire.write(0);
+                LCD_I2C.write(0);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
 
             WriteCommand(0xB0 + m_row + 1);//set page address
             WriteCommand(m_col & 0xf);//set lower column address
             WriteCommand(0x10 | (m_col >> 4));//set higher column address
 
-            Wire.beginTransmission(I2C_ADDR);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(m_i2caddr);
+            LCD_I2C.write(0x40);
             for (byte i = (m_flags & FLAG_PIXEL_DOUBLE_H) ? 16 : 8; i > 0; i--) {
-                Wire.write(0);
+                LCD_I2C.write(0);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
         }
         m_col += (m_flags & FLAG_PIXEL_DOUBLE_H) ? 17 : 9;
         if (m_col >= 128) {
@@ -160,34 +148,27 @@ size_t LCD_SH1106::write(uint8_t c)
             m_row += 2;
         }
     }
-#endif
-#ifdef TWBR
-    TWBR = twbrbackup;
 #endif
     return 1;
 }
 
 void LCD_SH1106::writeDigit(byte n)
 {
-#ifdef TWBR
-    uint8_t twbrbackup = TWBR;
-    TWBR = 18; // upgrade to 400KHz!
-#endif
     if (m_font == FONT_SIZE_SMALL) {
-        Wire.beginTransmission(I2C_ADDR);
-        Wire.write(0x40);
+        LCD_I2C.beginTransmission(m_i2caddr);
+        LCD_I2C.write(0x40);
         if (n <= 9) {
             n += '0' - 0x21;
             for (byte i = 0; i < 5; i++) {
-                Wire.write(pgm_read_byte(&font5x8[n][i]));
+                LCD_I2C.write(pgm_read_byte(&font5x8[n][i]));
             }
-            Wire.write(0);
+            LCD_I2C.write(0);
         } else {
             for (byte i = 0; i < 6; i++) {
-                Wire.write(0);
+                LCD_I2C.write(0);
             }
         }
-        Wire.endTransmission();
+        LCD_I2C.endTransmission();
         m_col += 6;
     } else if (m_font == FONT_SIZE_MEDIUM) {
         write(n <= 9 ? ('0' + n) : ' ');
@@ -199,49 +180,49 @@ void LCD_SH1106::writeDigit(byte n)
             WriteCommand(m_col & 0xf);//set lower column address
             WriteCommand(0x10 | (m_col >> 4));//set higher column address
 
-            Wire.beginTransmission(I2C_ADDR);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(m_i2caddr);
+            LCD_I2C.write(0x40);
             for (i = 0; i < 16; i ++) {
                 byte d = pgm_read_byte(&digits16x16[n][i]);
-                Wire.write(d);
-                if (m_flags & FLAG_PIXEL_DOUBLE_H) Wire.write(d);
+                LCD_I2C.write(d);
+                if (m_flags & FLAG_PIXEL_DOUBLE_H) LCD_I2C.write(d);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
 
             WriteCommand(0xB0 + m_row + 1);//set page address
             WriteCommand(m_col & 0xf);//set lower column address
             WriteCommand(0x10 | (m_col >> 4));//set higher column address
 
-            Wire.beginTransmission(I2C_ADDR);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(m_i2caddr);
+            LCD_I2C.write(0x40);
             for (; i < 32; i ++) {
                 byte d = pgm_read_byte(&digits16x16[n][i]);
-                Wire.write(d);
-                if (m_flags & FLAG_PIXEL_DOUBLE_H) Wire.write(d);
+                LCD_I2C.write(d);
+                if (m_flags & FLAG_PIXEL_DOUBLE_H) LCD_I2C.write(d);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
         } else {
             WriteCommand(0xB0 + m_row);//set page address
             WriteCommand(m_col & 0xf);//set lower column address
             WriteCommand(0x10 | (m_col >> 4));//set higher column address
 
-            Wire.beginTransmission(I2C_ADDR);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(m_i2caddr);
+            LCD_I2C.write(0x40);
             for (byte i = (m_flags & FLAG_PIXEL_DOUBLE_H) ? 32 : 16; i > 0; i--) {
-                Wire.write(0);
+                LCD_I2C.write(0);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
 
             WriteCommand(0xB0 + m_row + 1);//set page address
             WriteCommand(m_col & 0xf);//set lower column address
             WriteCommand(0x10 | (m_col >> 4));//set higher column address
 
-            Wire.beginTransmission(I2C_ADDR);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(m_i2caddr);
+            LCD_I2C.write(0x40);
             for (byte i = (m_flags & FLAG_PIXEL_DOUBLE_H) ? 32 : 16; i > 0; i--) {
-                Wire.write(0);
+                LCD_I2C.write(0);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
         }
         m_col += (m_flags & FLAG_PIXEL_DOUBLE_H) ? 30 : 16;
 #endif
@@ -252,87 +233,80 @@ void LCD_SH1106::writeDigit(byte n)
             WriteCommand(m_col & 0xf);//set lower column address
             WriteCommand(0x10 | (m_col >> 4));//set higher column address
 
-            Wire.beginTransmission(I2C_ADDR);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(m_i2caddr);
+            LCD_I2C.write(0x40);
             for (i = 0; i < 16; i ++) {
                 byte d = pgm_read_byte(&digits16x24[n][i * 3]);
-                Wire.write(d);
-                if (m_flags & FLAG_PIXEL_DOUBLE_H) Wire.write(d);
+                LCD_I2C.write(d);
+                if (m_flags & FLAG_PIXEL_DOUBLE_H) LCD_I2C.write(d);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
 
             WriteCommand(0xB0 + m_row + 1);//set page address
             WriteCommand(m_col & 0xf);//set lower column address
             WriteCommand(0x10 | (m_col >> 4));//set higher column address
 
-            Wire.beginTransmission(I2C_ADDR);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(m_i2caddr);
+            LCD_I2C.write(0x40);
             for (i = 0; i < 16; i ++) {
                 byte d = pgm_read_byte(&digits16x24[n][i * 3 + 1]);
-                Wire.write(d);
-                if (m_flags & FLAG_PIXEL_DOUBLE_H) Wire.write(d);
+                LCD_I2C.write(d);
+                if (m_flags & FLAG_PIXEL_DOUBLE_H) LCD_I2C.write(d);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
 
             WriteCommand(0xB0 + m_row + 2);//set page address
             WriteCommand(m_col & 0xf);//set lower column address
             WriteCommand(0x10 | (m_col >> 4));//set higher column address
 
-            Wire.beginTransmission(I2C_ADDR);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(m_i2caddr);
+            LCD_I2C.write(0x40);
             for (i = 0; i < 16; i ++) {
                 byte d = pgm_read_byte(&digits16x24[n][i * 3 + 2]);
-                Wire.write(d);
-                if (m_flags & FLAG_PIXEL_DOUBLE_H) Wire.write(d);
+                LCD_I2C.write(d);
+                if (m_flags & FLAG_PIXEL_DOUBLE_H) LCD_I2C.write(d);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
         } else {
             WriteCommand(0xB0 + m_row);//set page address
             WriteCommand(m_col & 0xf);//set lower column address
             WriteCommand(0x10 | (m_col >> 4));//set higher column address
 
-            Wire.beginTransmission(I2C_ADDR);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(m_i2caddr);
+            LCD_I2C.write(0x40);
             for (byte i = (m_flags & FLAG_PIXEL_DOUBLE_H) ? 32 : 16; i > 0; i--) {
-                Wire.write(0);
+                LCD_I2C.write(0);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
 
             WriteCommand(0xB0 + m_row + 1);//set page address
             WriteCommand(m_col & 0xf);//set lower column address
             WriteCommand(0x10 | (m_col >> 4));//set higher column address
 
-            Wire.beginTransmission(I2C_ADDR);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(m_i2caddr);
+            LCD_I2C.write(0x40);
             for (byte i = (m_flags & FLAG_PIXEL_DOUBLE_H) ? 32 : 16; i > 0; i--) {
-                Wire.write(0);
+                LCD_I2C.write(0);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
 
             WriteCommand(0xB0 + m_row + 2);//set page address
             WriteCommand(m_col & 0xf);//set lower column address
             WriteCommand(0x10 | (m_col >> 4));//set higher column address
 
-            Wire.beginTransmission(I2C_ADDR);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(m_i2caddr);
+            LCD_I2C.write(0x40);
             for (byte i = (m_flags & FLAG_PIXEL_DOUBLE_H) ? 32 : 16; i > 0; i--) {
-                Wire.write(0);
+                LCD_I2C.write(0);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
         }
         m_col += (m_flags & FLAG_PIXEL_DOUBLE_H) ? 30 : 16;
     }
-#ifdef TWBR
-    TWBR = twbrbackup;
-#endif
 }
 
 void LCD_SH1106::draw(const PROGMEM byte* buffer, byte width, byte height)
 {
-#ifdef TWBR
-    uint8_t twbrbackup = TWBR;
-    TWBR = 18; // upgrade to 400KHz!
-#endif
 
     WriteCommand(SSD1306_SETLOWCOLUMN | 0x0);  // low col = 0
     WriteCommand(SSD1306_SETHIGHCOLUMN | 0x0);  // hi col = 0
@@ -348,23 +322,22 @@ void LCD_SH1106::draw(const PROGMEM byte* buffer, byte width, byte height)
         WriteCommand(0x10 | (m_col >> 4));//set higher column address
 
         for(byte j = 0; j < 8; j++){
-            Wire.beginTransmission(I2C_ADDR);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(m_i2caddr);
+            LCD_I2C.write(0x40);
             for (byte k = 0; k < width; k++, p++) {
-                Wire.write(pgm_read_byte(p));
+                LCD_I2C.write(pgm_read_byte(p));
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
         }
     }
-#ifdef TWBR
-    TWBR = twbrbackup;
-#endif
     m_col += width;
 }
 
-void LCD_SH1106::begin()
+void LCD_SH1106::begin(byte i2caddr)
 {
-  Wire.begin();
+  m_i2caddr = i2caddr;
+  LCD_I2C.begin();
+  LCD_I2C.setClock(MICROLCD_I2C_CLOCK);
 
   WriteCommand(0xAE);    /*display off*/
 
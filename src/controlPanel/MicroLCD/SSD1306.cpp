@@ -1,7 +1,7 @@
 #include <avr/pgmspace.h>
 //#include <util/delay.h>
 #include <stdlib.h>
-#include <Wire.h>
+#include "LCDBus.h"
 #include "SSD1306.h"
 
 SSD1306::SSD1306(int8_t SCLK, int8_t DC, int8_t RST, int8_t CS) {
@@ -24,7 +24,8 @@ void SSD1306::begin(uint8_t vccstate, uint8_t i2caddr) {
 
   // set pin directions
     // I2C Init
-    Wire.begin(); // Is this the right place for this?
+    LCD_I2C.begin(); // Is this the right place for this?
+    LCD_I2C.setClock(MICROLCD_I2C_CLOCK); // set once here rather than around every transfer
 
   // Setup reset pin direction (used by both SPI and I2C)
   pinMode(rst, OUTPUT);
@@ -125,12 +126,12 @@ void SSD1306::begin(uint8_t vccstate, uint8_t i2caddr) {
         ssd1306_command(0x10);//set higher column address
 
         for(byte j = 0; j < 8; j++){
-            Wire.beginTransmission(_i2caddr);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(_i2caddr);
+            LCD_I2C.write(0x40);
             for (byte k = 0; k < SSD1306_LCDWIDTH / 8; k++) {
-                Wire.write(0);
+                LCD_I2C.write(0);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
         }
     }
 }
@@ -147,10 +148,10 @@ void SSD1306::invertDisplay(uint8_t i) {
 void SSD1306::ssd1306_command(uint8_t c) {
     // I2C
     uint8_t control = 0x00;   // Co = 0, D/C = 0
-    Wire.beginTransmission(_i2caddr);
-    Wire.write(control);
-    Wire.write(c);
-    Wire.endTransmission();
+    LCD_I2C.beginTransmission(_i2caddr);
+    LCD_I2C.write(control);
+    LCD_I2C.write(c);
+    LCD_I2C.endTransmission();
 }
 
 // startscrollright
@@ -224,10 +225,35 @@ void SSD1306::stopscroll(void){
 void SSD1306::ssd1306_data(uint8_t c) {
     // I2C
     uint8_t control = 0x40;   // Co = 0, D/C = 1
-    Wire.beginTransmission(_i2caddr);
-    Wire.write(control);
-    Wire.write(c);
-    Wire.endTransmission();
+    LCD_I2C.beginTransmission(_i2caddr);
+    LCD_I2C.write(control);
+    LCD_I2C.write(c);
+    LCD_I2C.endTransmission();
+}
+
+// Set the page and column pointer in a single transmission
+void SSD1306::setAddress(uint8_t page, uint8_t column) {
+    LCD_I2C.beginTransmission(_i2caddr);
+    LCD_I2C.write(0x00);   // Co = 0, D/C = 0, the rest of the transmission is commands
+    LCD_I2C.write(0xB0 + page);//set page address
+    LCD_I2C.write(column & 0xf);//set lower column address
+    LCD_I2C.write(0x10 | (column >> 4));//set higher column address
+    LCD_I2C.endTransmission();
+}
+
+// Write a run of columns within one page using as few transmissions as the transmit buffer allows
+void SSD1306::writePage(uint8_t page, uint8_t column, const uint8_t *data, uint8_t length)
+{
+    setAddress(page, column);
+    while (length > 0) {
+        uint8_t chunk = length > SSD1306_DATA_CHUNK ? SSD1306_DATA_CHUNK : length;
+        LCD_I2C.beginTransmission(_i2caddr);
+        LCD_I2C.write(0x40);
+        LCD_I2C.write(data, chunk);
+        LCD_I2C.endTransmission();
+        data += chunk;
+        length -= chunk;
+    }
 }
 
 void SSD1306::fill(unsigned char dat)
@@ -238,10 +264,6 @@ void SSD1306::fill(unsigned char dat)
     ssd1306_command(0x10);//set higher column address
     ssd1306_command(0xB0);//set page address
 
-#ifdef TWBR
-    uint8_t twbrbackup = TWBR;
-    TWBR = 18; // upgrade to 400KHz!
-#endif
     for (byte i=0; i<(SSD1306_LCDHEIGHT/8); i++)
     {
         // send a bunch of data in one xmission
@@ -250,17 +272,14 @@ void SSD1306::fill(unsigned char dat)
         ssd1306_command(0x10);//set higher column address
 
         for(byte j = 0; j < 8; j++){
-            Wire.beginTransmission(_i2caddr);
-            Wire.write(0x40);
+            LCD_I2C.beginTransmission(_i2caddr);
+            LCD_I2C.write(0x40);
             for (byte k = 0; k < 16; k++) {
-                Wire.write(dat);
+                LCD_I2C.write(dat);
             }
-            Wire.endTransmission();
+            LCD_I2C.endTransmission();
         }
     }
-#ifdef TWBR
-    TWBR = twbrbackup;
-#endif
 }
 
 void SSD1306::draw8x8(byte* buffer, uint8_t x, uint8_t y)
@@ -270,8 +289,8 @@ void SSD1306::draw8x8(byte* buffer, uint8_t x, uint8_t y)
     ssd1306_command(x & 0xf);//set lower column address
     ssd1306_command(0x10 | (x >> 4));//set higher column address
 
-    Wire.beginTransmission(_i2caddr);
-    Wire.write(0x40);
-    Wire.write(buffer, 8);
-    Wire.endTransmission();
+    LCD_I2C.beginTransmission(_i2caddr);
+    LCD_I2C.write(0x40);
+    LCD_I2C.write(buffer, 8);
+    LCD_I2C.endTransmission();
 }
@@ -92,6 +92,8 @@ public:
   void begin(uint8_t switchvcc = SSD1306_SWITCHCAPVCC, uint8_t i2caddr = SSD1306_I2C_ADDRESS);
   void ssd1306_command(uint8_t c);
   void ssd1306_data(uint8_t c);
+  void setAddress(uint8_t page, uint8_t column);
+  void writePage(uint8_t page, uint8_t column, const uint8_t *data, uint8_t length);
 
   void invertDisplay(uint8_t i);
   void draw8x8(byte* buffer, byte x, byte y);
@@ -0,0 +1,104 @@
+/**
+    Analog inputs
+    Responsible for sampling the joystick and pots in the background. The ADC interrupt goes round the pins,
+    averages ANALOG_OVERSAMPLE conversions per pin and low pass filters the result into a cache that read() returns
+**/
+
+#ifndef ANALOG_INPUTS
+#define ANALOG_INPUTS
+
+#include <Arduino.h>
+#include <avr/interrupt.h>
+
+#define ANALOG_MAX_INPUTS 8
+#define ANALOG_OVERSAMPLE 8
+
+//Filter strength, each new average moves the value 1/2^ANALOG_FILTER_SHIFT of the way
+#define ANALOG_FILTER_SHIFT 2
+
+//The filtered values are kept with 4 extra bits of resolution
+#define ANALOG_FRACTION_BITS 4
+
+class AnalogInputs {
+    private:
+    uint8_t _pins[ANALOG_MAX_INPUTS];
+    uint8_t _slotForChannel[16];
+    uint8_t _count = 0;
+    uint8_t _current = 0;
+    uint8_t _samples = 0;
+    uint16_t _sum = 0;
+    volatile uint16_t _filtered[ANALOG_MAX_INPUTS];
+
+    static uint8_t channel(uint8_t pin) {
+        return pin >= A0 ? pin - A0 : pin;
+    }
+
+    //Point the multiplexer at a pin and start a conversion
+    void startConversion(uint8_t pin) {
+        uint8_t ch = channel(pin);
+#ifdef MUX5
+        ADCSRB = (ch & 0x08) ? _BV(MUX5) : 0;
+#endif
+        ADMUX = _BV(REFS0) | (ch & 0x07);
+        ADCSRA |= _BV(ADSC);
+    }
+
+    public:
+    //Start sampling the given pins. analogRead() must not be used on any pin after this
+    void begin(const uint8_t *pins, uint8_t count) {
+        if(count > ANALOG_MAX_INPUTS){count = ANALOG_MAX_INPUTS;}
+        memset(_slotForChannel, 0xFF, sizeof(_slotForChannel));
+        for(uint8_t i = 0; i < count; i++) {
+            _pins[i] = pins[i];
+            _slotForChannel[channel(pins[i]) & 0x0F] = i;
+            //Start the filters at the current value so they don't have to ramp up from 0
+            _filtered[i] = analogRead(pins[i]) << ANALOG_FRACTION_BITS;
+        }
+        _count = count;
+        _current = 0;
+        _samples = 0;
+        _sum = 0;
+
+        //Each conversion is started from the interrupt of the last so the multiplexer can be changed between them
+        //without throwing a sample away. ADC clock is 16MHz / 128, so ~9600 conversions a second
+        ADCSRA = _BV(ADEN) | _BV(ADIE) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+        startConversion(_pins[0]);
+    }
+
+    //Called from the ADC interrupt with the finished conversion
+    void conversionComplete(uint16_t value) {
+        _sum += value;
+        if(++_samples >= ANALOG_OVERSAMPLE) {
+            //Average with the extra resolution then filter
+            int16_t average = ((uint32_t)_sum << ANALOG_FRACTION_BITS) / ANALOG_OVERSAMPLE;
+            int16_t filtered = _filtered[_current];
+            _filtered[_current] = filtered + ((average - filtered) >> ANALOG_FILTER_SHIFT);
+            _sum = 0;
+            _samples = 0;
+            _current = (_current + 1) % _count;
+        }
+        startConversion(_pins[_current]);
+    }
+
+    //Get the filtered value of a pin (0 - 1023). Before begin() this falls back to analogRead()
+    uint16_t read(uint8_t pin) {
+        if(_count == 0){return analogRead(pin);}
+        uint8_t slot = _slotForChannel[channel(pin) & 0x0F];
+        if(slot == 0xFF){return 0;}
+        uint8_t oldSREG = SREG;
+        cli();
+        uint16_t value = _filtered[slot];
+        SREG = oldSREG;
+        return (value + (1 << (ANALOG_FRACTION_BITS - 1))) >> ANALOG_FRACTION_BITS;
+    }
+};
+
+AnalogInputs analogInputs;
+
+ISR(ADC_vect) {
+    uint16_t value = ADCL;
+    value |= ADCH << 8;
+    analogInputs.conversionComplete(value);
+}
+
+#endif
@@ -0,0 +1,147 @@
+/**
+    Clock sync
+    Responsible for keeping an estimate of the show controller's clock so moves can be timed against it
+
+    NTP style exchange over the KJIB socket, all times in microseconds:
+    Request (us to server):     Control TimeSync 0  DATA: T1 (4)                local micros() when sent
+    Reply (server to us):       Control TimeSync 1  DATA: T1 (4) T2 (4) T3 (4) T1 echoed, server clock when the
+                                                                                request arrived and when the reply left
+    T4 is our micros() when the reply arrived. The server clock is a free running microsecond count that wraps at 2^32
+    like micros() does, values are little endian like the rest of the 4 byte fields.
+
+    offset = ((T2 - T1) + (T3 - T4)) / 2        delay = (T4 - T1) - (T3 - T2)
+    The two clocks start whenever their boards did so the offset can be anything, it is kept modulo 2^32 and only the
+    differences between offsets, which are small, are taken as signed
+
+    Of the last CLOCK_SYNC_SAMPLES exchanges the one with the least delay is trusted, queuing only ever adds delay.
+    The offset can be out by at most half of that delay, which is reported as the accuracy. The drift between the
+    two crystals is tracked from how far the offset moves between trusted samples
+**/
+
+#ifndef CLOCK_SYNC
+#define CLOCK_SYNC
+
+#include <Arduino.h>
+
+#define CLOCK_SYNC_SAMPLES 8
+
+//Drift is only measured over at least this long (us) and never believed past +-CLOCK_SYNC_MAX_DRIFT (us per us)
+#define CLOCK_SYNC_MIN_DRIFT_SPAN 10000000UL
+#define CLOCK_SYNC_MAX_DRIFT 0.0005
+
+class ClockSync {
+    private:
+    struct Sample {
+        uint32_t local;     //T4
+        uint32_t offset;
+        uint32_t delay;
+    };
+
+    Sample _samples[CLOCK_SYNC_SAMPLES];
+    byte _sampleCount = 0;
+    byte _nextSample = 0;
+
+    bool _synced = false;
+    uint32_t _offset = 0;
+    uint32_t _reference = 0;    //Local time _offset was measured at
+    float _drift = 0;
+    uint32_t _driftLocal = 0;   //Sample the drift was last measured from
+    uint32_t _driftOffset = 0;
+    uint32_t _accuracy = 0;
+    unsigned long _lastSample = 0;
+
+    uint32_t _requestSent = 0;
+    bool _waiting = false;
+
+    //Offset at a local time, carried on from the last trusted sample by the drift
+    uint32_t offsetAt(uint32_t local) {
+        return _offset + (int32_t)(_drift * (int32_t)(local - _reference));
+    }
+
+    public:
+    //Start an exchange. Returns T1 to send to the server, a reply to any earlier request is ignored from now on
+    uint32_t request() {
+        _requestSent = micros();
+        _waiting = true;
+        return _requestSent;
+    }
+
+    //Take the server's reply. receivedAt is micros() when the packet arrived. Returns false if it wasn't for the last request
+    bool response(uint32_t t1, uint32_t t2, uint32_t t3, uint32_t receivedAt) {
+        if(!_waiting || t1 != _requestSent){return false;}
+        _waiting = false;
+
+        Sample &sample = _samples[_nextSample];
+        sample.local = receivedAt;
+        //Half way between the two one way offsets, which are within a round trip of each other
+        uint32_t outbound = t2 - t1;
+        sample.offset = outbound + (int32_t)((t3 - receivedAt) - outbound) / 2;
+        int32_t delay = (int32_t)(receivedAt - t1) - (int32_t)(t3 - t2);
+        sample.delay = delay < 0 ? 0 : delay;
+        _nextSample = (_nextSample + 1) % CLOCK_SYNC_SAMPLES;
+        if(_sampleCount < CLOCK_SYNC_SAMPLES){_sampleCount++;}
+        _lastSample = millis();
+
+        //Trust the sample with the least delay
+        byte best = 0;
+        for(byte i = 1; i < _sampleCount; i++) {
+            if(_samples[i].delay < _samples[best].delay){best = i;}
+        }
+        const Sample &trusted = _samples[best];
+        _accuracy = trusted.delay / 2;
+        if(_synced && trusted.local == _reference){return true;}
+
+        if(!_synced) {
+            _synced = true;
+            _driftLocal = trusted.local;
+            _driftOffset = trusted.offset;
+        }
+        else {
+            //Move the drift half way to how fast the offset has moved since it was last measured
+            int32_t span = trusted.local - _driftLocal;
+            if(span >= (int32_t)CLOCK_SYNC_MIN_DRIFT_SPAN) {
+                float measured = (float)(int32_t)(trusted.offset - _driftOffset) / span;
+                _drift = constrain(_drift + (measured - _drift) / 2.0, -CLOCK_SYNC_MAX_DRIFT, CLOCK_SYNC_MAX_DRIFT);
+                _driftLocal = trusted.local;
+                _driftOffset = trusted.offset;
+            }
+        }
+        _offset = trusted.offset;
+        _reference = trusted.local;
+        return true;
+    }
+
+    //Forget everything and wait for new samples, e.g. after the server restarts
+    void reset() {
+        _synced = false;
+        _sampleCount = 0;
+        _nextSample = 0;
+        _drift = 0;
+        _waiting = false;
+    }
+
+    bool synced() {return _synced;}
+
+    //Has there been a good sample recently
+    bool stale(unsigned long timeout) {return !_synced || millis() - _lastSample >= timeout;}
+
+    //Worst case error of the offset (us)
+    uint32_t accuracy() {return _accuracy;}
+
+    //Drift of our clock against the server's, parts per million
+    float driftPpm() {return _drift * 1000000.0;}
+
+    //The server's clock now
+    uint32_t now() {
+        uint32_t local = micros();
+        return local + offsetAt(local);
+    }
+
+    //The local micros() at which the server's clock will read serverTime
+    uint32_t toLocal(uint32_t serverTime) {
+        uint32_t local = serverTime - _offset;
+        return serverTime - offsetAt(local);
+    }
+};
+
+#endif
@@ -7,14 +7,37 @@
 #define CONTROLPANEL
 
 #include <Arduino.h>
-#include <EEPROMex.h>
 
 #define TOTAL_ROWS 4
 #define TOTAL_COLS 3
 #define PINS_OFFSET 2
 
+//The buttons are scanned once per millisecond from timer 2. A button has to read the same for
+//BUTTON_DEBOUNCE_COUNT scans in a row (integrating) to change state. Long press and repeat times are
+//per button (ms), these are the defaults
+#define BUTTON_DEBOUNCE_COUNT 5
+#define BUTTON_LONG_PRESS 1000
+#define BUTTON_REPEAT_INTERVAL 0
+#define BUTTON_EVENT_QUEUE_SIZE 16
+#define TOTAL_BUTTONS (TOTAL_ROWS * TOTAL_COLS + 1)
+#define STOP_BUTTON_ID (TOTAL_ROWS * TOTAL_COLS)
+
+class ControlPanel;
+ControlPanel *scannedControlPanel = nullptr;
+
 class ControlPanel {
     public:
+    enum ButtonEventType {
+        Press,
+        Release,
+        LongPress,
+        Repeat
+    };
+    //A button event. The id is row * TOTAL_COLS + col, the stop button is STOP_BUTTON_ID
+    struct ButtonEvent {
+        byte button;
+        ButtonEventType type;
+    };
     enum PotValues {
         Pin,
         Min,
@@ -24,20 +47,49 @@ class ControlPanel {
         Left,
         Right
     };
+    //Everything that is kept in the settings store
+    struct Settings {
+        int16_t pots[2][2];     //[pot][min, max]
+    };
     struct Buttons { 
         int pins[TOTAL_ROWS][TOTAL_COLS];
         int buttonStates[TOTAL_ROWS][TOTAL_COLS]; 
     };
     private:
-    int _memoryStartAddress;
-    int _totalMemoryAllocation = CONTROLPANEL_MEM_ALLOC;
     int _potSettings[2][3] = {{0, 0, 0}, {0, 0, 0}};
     int _stopPin = 0;
     Buttons _buttons;
 
+    //Scanner state, written from the timer interrupt
+    volatile uint8_t *_buttonPorts[TOTAL_BUTTONS];
+    uint8_t _buttonMasks[TOTAL_BUTTONS];
+    byte _integrators[TOTAL_BUTTONS];
+    unsigned int _heldFor[TOTAL_BUTTONS];
+    unsigned int _repeatIn[TOTAL_BUTTONS];
+    unsigned int _longPressTime[TOTAL_BUTTONS];
+    unsigned int _repeatInterval[TOTAL_BUTTONS];
+    volatile bool _buttonDown[TOTAL_BUTTONS];
+    ButtonEvent _events[BUTTON_EVENT_QUEUE_SIZE];
+    volatile byte _eventHead = 0;
+    volatile byte _eventTail = 0;
+
+    //Add a event to the queue, dropped if the main loop has fallen behind
+    void pushEvent(byte button, ButtonEventType type) {
+        byte next = (_eventHead + 1) % BUTTON_EVENT_QUEUE_SIZE;
+        if(next == _eventTail){return;}
+        _events[_eventHead].button = button;
+        _events[_eventHead].type = type;
+        _eventHead = next;
+    }
+
+    //Button id to its pin
+    int buttonPin(byte button) {
+        return button == STOP_BUTTON_ID ? _stopPin : _buttons.pins[button / TOTAL_COLS][button % TOTAL_COLS];
+    }
+
     //Calibrate a pot
-    void calibratePot(Pot pot, LCD lcd, String currentPot = "") {
-        int potValue = analogRead(_potSettings[pot][PotValues::Pin]);
+    void calibratePot(Pot pot, LCD &lcd, String currentPot = "") {
+        int potValue = analogInputs.read(_potSettings[pot][PotValues::Pin]);
         int minPotValue = 0;
         int maxPotValue = 1023;
         Serial.println("\n\nMove the pot to the center. Will start calibration in 5 seconds");
@@ -46,25 +98,25 @@ class ControlPanel {
         Serial.println(" Please set the POT to 0%");
         lcd.showText(currentPot, "", " Set to 0%");
         while(true) {
-            if(analogRead(_potSettings[pot][PotValues::Pin]) >= potValue + 10 || analogRead(_potSettings[pot][PotValues::Pin]) <= potValue - 10) {
+            if(analogInputs.read(_potSettings[pot][PotValues::Pin]) >= potValue + 10 || analogInputs.read(_potSettings[pot][PotValues::Pin]) <= potValue - 10) {
                 delay(5000);
                 Serial.println("  Getting the value");
                 lcd.showText(currentPot, "", " Got it!");
-                minPotValue = analogRead(_potSettings[pot][PotValues::Pin]);
+                minPotValue = analogInputs.read(_potSettings[pot][PotValues::Pin]);
                 delay(1000);
                 break;
             }
         }
         Serial.println(" Next set the POT to 100%");
         lcd.showText(currentPot, "", " Move to 100%");
-        potValue = analogRead(_potSettings[pot][PotValues::Pin]);
+        potValue = analogInputs.read(_potSettings[pot][PotValues::Pin]);
         while(true) {
-            if(analogRead(_potSettings[pot][PotValues::Pin]) >= potValue + 10 || analogRead(_potSettings[pot][PotValues::Pin]) <= potValue - 10) {
+            if(analogInputs.read(_potSettings[pot][PotValues::Pin]) >= potValue + 10 || analogInputs.read(_potSettings[pot][PotValues::Pin]) <= potValue - 10) {
                 delay(5000);
                 Serial.println("  Getting the value");
                 lcd.showText(currentPot, "", " Got it!");
                 delay(1000);
-                maxPotValue = analogRead(_potSettings[pot][PotValues::Pin]);
+                maxPotValue = analogInputs.read(_potSettings[pot][PotValues::Pin]);
                 break;
             }
         }
@@ -73,13 +125,11 @@ class ControlPanel {
         _potSettings[pot][PotValues::Max] = maxPotValue;
         Serial.println("Setting pot values min=" + (String)minPotValue + ", max=" + (String)maxPotValue);
         lcd.showText(currentPot, "", " Complete");
-        setSettingsToMemory();
     }
 
     public:
         //Constructor this assumes that the buttons are in a grid with the buttons going down each row before col
-        ControlPanel(int startPin, int leftPotPin, int rightPotPin, int memoryStartAddress) { //probs no work
-            _memoryStartAddress = memoryStartAddress;
+        ControlPanel(int startPin, int leftPotPin, int rightPotPin) {
             _stopPin = (startPin - 1) + (2 * (TOTAL_COLS * TOTAL_ROWS));
 
             //Set the pins
@@ -99,30 +149,98 @@ class ControlPanel {
             pinMode(_potSettings[Pot::Right][PotValues::Pin], INPUT);
         }
 
-        bool isStopButtonPressed() {
-            return isButtonPressed(_stopPin);
+        //Start scanning the buttons. Must be called from setup(), init() sets up timer 2 for PWM after the constructor has run
+        void begin() {
+            for(byte i = 0; i < TOTAL_BUTTONS; i++) {
+                int pin = buttonPin(i);
+                _buttonPorts[i] = portInputRegister(digitalPinToPort(pin));
+                _buttonMasks[i] = digitalPinToBitMask(pin);
+                _integrators[i] = 0;
+                _heldFor[i] = 0;
+                _repeatIn[i] = 0;
+                _longPressTime[i] = BUTTON_LONG_PRESS;
+                _repeatInterval[i] = BUTTON_REPEAT_INTERVAL;
+                _buttonDown[i] = false;
+            }
+
+            //Timer 2 CTC at 1KHz (16MHz / 64 / 250)
+            noInterrupts();
+            scannedControlPanel = this;
+            TCCR2A = _BV(WGM21);
+            TCCR2B = _BV(CS22);
+            OCR2A = (F_CPU / 64 / 1000) - 1;
+            TCNT2 = 0;
+            TIMSK2 = _BV(OCIE2A);
+            interrupts();
         }
 
-        bool isButtonPressed(int pin) {
-            int val = 0;
-            for(int k = 0; k < 20; k++) {
-                val += digitalRead(pin);
+        //Read every button straight from its port register and debounce it. Called from the timer interrupt
+        void scan() {
+            for(byte i = 0; i < TOTAL_BUTTONS; i++) {
+                //A button reads high when pressed
+                bool raw = (*_buttonPorts[i] & _buttonMasks[i]) != 0;
+                if(raw && _integrators[i] < BUTTON_DEBOUNCE_COUNT){_integrators[i]++;}
+                else if(!raw && _integrators[i] > 0){_integrators[i]--;}
+
+                if(!_buttonDown[i] && _integrators[i] == BUTTON_DEBOUNCE_COUNT) {
+                    _buttonDown[i] = true;
+                    _heldFor[i] = 0;
+                    _repeatIn[i] = _repeatInterval[i];
+                    pushEvent(i, ButtonEventType::Press);
+                }
+                else if(_buttonDown[i] && _integrators[i] == 0) {
+                    _buttonDown[i] = false;
+                    pushEvent(i, ButtonEventType::Release);
+                }
+                else if(_buttonDown[i]) {
+                    if(_heldFor[i] < 0xFFFF) {
+                        _heldFor[i]++;
+                        if(_heldFor[i] == _longPressTime[i]){pushEvent(i, ButtonEventType::LongPress);}
+                    }
+                    //Repeat while held, 0 means the button does not repeat
+                    if(_repeatIn[i] != 0 && --_repeatIn[i] == 0) {
+                        _repeatIn[i] = _repeatInterval[i];
+                        pushEvent(i, ButtonEventType::Repeat);
+                    }
+                }
             }
-            return val / 20;
         }
 
-        //Constantly check if a button is pressed. This should be called every loop cycle. Will return an array of button id's that have been pressed 
-        //[0][0] is the amount of buttons down
-        //[1][x..amountOfButtonsDown] is the button id(s) that are down
+        //Set how long a button is held for a long press and how often it repeats while held (ms, 0 to disable)
+        void configureButton(byte button, unsigned int longPressTime, unsigned int repeatInterval) {
+            noInterrupts();
+            _longPressTime[button] = longPressTime;
+            _repeatInterval[button] = repeatInterval;
+            interrupts();
+        }
+
+        //Get the next button event. Returns false if there are none waiting
+        bool nextEvent(ButtonEvent &event) {
+            if(_eventTail == _eventHead){return false;}
+            event = _events[_eventTail];
+            _eventTail = (_eventTail + 1) % BUTTON_EVENT_QUEUE_SIZE;
+            return true;
+        }
+
+        //Drop any events waiting, used once setup has finished with the buttons
+        void clearEvents() {
+            _eventTail = _eventHead;
+        }
+
+        //Is the button held down (debounced)
+        bool isButtonDown(byte button) {
+            return _buttonDown[button];
+        }
+
+        bool isStopButtonPressed() {
+            return _buttonDown[STOP_BUTTON_ID];
+        }
+
+        //Get the debounced state of every button. This only copies the states the scanner keeps up to date
         Buttons isButtonsPressed() {
             for(int i = 0; i < TOTAL_ROWS; i++) {
                 for(int j = 0; j < TOTAL_COLS; j++) {
-                    _buttons.buttonStates[i][j] = isButtonPressed(_buttons.pins[i][j]);
-                    // int val = 0;
-                    // for(int k = 0; k < 20; k++) {
-                    //     val += digitalRead(_buttons.pins[i][j]);
-                    // }
-                    // _buttons.buttonStates[i][j] = val / 20;
+                    _buttons.buttonStates[i][j] = _buttonDown[i * TOTAL_COLS + j];
                 }
             }
 
@@ -131,54 +249,22 @@ class ControlPanel {
 
         //Get the percentage of a pot
         float getPotPercentage(Pot pot){
-            return ((float)analogRead(_potSettings[pot][PotValues::Pin]) / (float)(_potSettings[pot][PotValues::Max] - _potSettings[pot][PotValues::Min])) * 100.0;
+            return ((float)analogInputs.read(_potSettings[pot][PotValues::Pin]) / (float)(_potSettings[pot][PotValues::Max] - _potSettings[pot][PotValues::Min])) * 100.0;
         }
 
-        //Set the settings to memory
-        boolean setSettingsToMemory() {
-            if(_memoryStartAddress == -1 || _memoryStartAddress + _totalMemoryAllocation > END_OF_MEMORY) {
-                Serial.println("Could not set control panel memory cause the start address was not set or is outside of useable memory");
-                return false;
-            }
-            else {
-                Serial.print("Set control panel to memory..");
-
-                Serial.print("LeftPot@" + (String)_memoryStartAddress + " , ");
-                EEPROM.writeInt(_memoryStartAddress, _potSettings[Pot::Left][PotValues::Min]);
-                EEPROM.writeInt(_memoryStartAddress + 2, _potSettings[Pot::Left][PotValues::Max]);
-
-                Serial.print("RightPot@" + (String)(_memoryStartAddress + 4) + " , ");
-                EEPROM.writeInt(_memoryStartAddress + 4, _potSettings[Pot::Right][PotValues::Min]);
-                EEPROM.writeInt(_memoryStartAddress + 6, _potSettings[Pot::Right][PotValues::Max]);
-                Serial.println(" Done");
-                return true;
-            } 
-        }
-
-        //Read the settings from memory
-        boolean readSettingsFromMemory() {
-            if(_memoryStartAddress == -1 || _memoryStartAddress + _totalMemoryAllocation > END_OF_MEMORY) {
-                Serial.println("Could not read control panel memory cause the start address was not set or is outside of useable memory");
-                return false;
+        //Copy the pot calibration out to be saved
+        void getSettings(Settings &settings) {
+            for(int pot = Pot::Left; pot <= Pot::Right; pot++) {
+                settings.pots[pot][0] = _potSettings[pot][PotValues::Min];
+                settings.pots[pot][1] = _potSettings[pot][PotValues::Max];
             }
-            else {
-                //If all the values are set to 255 then set the defaults
-                int amountOfUnsetData = 0;
-                for(int i = _memoryStartAddress; i < _memoryStartAddress + _totalMemoryAllocation; i++) {if(EEPROM.read(i) == 255){amountOfUnsetData++;}}
-                if(amountOfUnsetData == _totalMemoryAllocation) {
-                    //Data is not set default them
-                    Serial.println("Control panel settings are not set. Setting defaults");
-                    setSettingsToMemory();
-                    return true;
-                }
-                else {
-                    _potSettings[Pot::Left][PotValues::Min] = EEPROM.readInt(_memoryStartAddress);
-                    _potSettings[Pot::Left][PotValues::Max] = EEPROM.readInt(_memoryStartAddress + 2);
+        }
 
-                    _potSettings[Pot::Right][PotValues::Min] = EEPROM.readInt(_memoryStartAddress + 4);
-                    _potSettings[Pot::Right][PotValues::Max] = EEPROM.readInt(_memoryStartAddress + 6);
-                    return true;
-                }
+        //Use saved pot calibration
+        void setSettings(const Settings &settings) {
+            for(int pot = Pot::Left; pot <= Pot::Right; pot++) {
+                _potSettings[pot][PotValues::Min] = settings.pots[pot][0];
+                _potSettings[pot][PotValues::Max] = settings.pots[pot][1];
             }
         }
 
@@ -197,7 +283,7 @@ class ControlPanel {
         }
 
         //Calibrate
-        void calibrate(LCD leftLCD, LCD rightLCD) {
+        void calibrate(LCD &leftLCD, LCD &rightLCD) {
             rightLCD.showText("Calibration", "", "Follow left screen");
             Serial.println(" Calibration started for control panel");
             Serial.println(" \nThe left pot will be calibrated first");
@@ -217,4 +303,9 @@ class ControlPanel {
 
 };
 
+//Scan the buttons every millisecond
+ISR(TIMER2_COMPA_vect) {
+    if(scannedControlPanel != nullptr){scannedControlPanel->scan();}
+}
+
 #endif
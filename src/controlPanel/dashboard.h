@@ -0,0 +1,79 @@
+/**
+    Dashboard
+    Responsible for the status pages shown on the LCDs and the loop timing statistics they show
+**/
+
+#ifndef DASHBOARD
+#define DASHBOARD
+
+#include <Arduino.h>
+
+//Measures the time between calls to tick() and keeps the min/avg/max of the last window
+class LoopTimer {
+    private:
+    unsigned long _lastTick = 0;
+    unsigned long _windowStart = 0;
+    unsigned long _total = 0;
+    unsigned long _count = 0;
+    unsigned int _min = 0xFFFF;
+    unsigned int _max = 0;
+    unsigned int _reportedMin = 0;
+    unsigned int _reportedAverage = 0;
+    unsigned int _reportedMax = 0;
+
+    public:
+    //Call once at the top of every loop
+    void tick() {
+        unsigned long now = micros();
+        if(_lastTick != 0) {
+            unsigned long took = now - _lastTick;
+            if(took > 0xFFFF){took = 0xFFFF;}
+            _total += took;
+            _count++;
+            if(took < _min){_min = took;}
+            if(took > _max){_max = took;}
+        }
+        _lastTick = now;
+
+        //Publish the window and start a new one
+        if(now - _windowStart >= LOOP_STATS_WINDOW) {
+            _windowStart = now;
+            _reportedMin = _count == 0 ? 0 : _min;
+            _reportedAverage = _count == 0 ? 0 : _total / _count;
+            _reportedMax = _max;
+            _total = 0;
+            _count = 0;
+            _min = 0xFFFF;
+            _max = 0;
+        }
+    }
+
+    unsigned int minimum() {return _reportedMin;}
+    unsigned int average() {return _reportedAverage;}
+    unsigned int maximum() {return _reportedMax;}
+};
+
+//The page of information shown on the LCDs
+class Dashboard {
+    public:
+    enum Page {
+        Main,
+        Position,
+        Timing,
+        Network,
+        TotalPages
+    };
+
+    private:
+    Page _page = Page::Main;
+
+    public:
+    Page page() {return _page;}
+    void setPage(Page page) {_page = page;}
+
+    void nextPage() {
+        _page = (Page)((_page + 1) % Page::TotalPages);
+    }
+};
+
+#endif
@@ -0,0 +1,180 @@
+/**
+    DMX handler
+    Responsible for taking DMX from a lighting console over Ethernet so the head can be driven like a moving light
+
+    Art-Net (UDP 6454, broadcast or unicast to us) or sACN / E1.31 (UDP 5568, multicast 239.255.<universe>) with
+    DMX_SACN. Only the ArtDmx / E1.31 data packets for our universe are taken, Art-Net polls are not answered so the
+    console has to send to the broadcast address or to us directly. Art-Net universes are the 15 bit port address
+    from 0, sACN universes are from 1.
+
+    The channels are read from the start address (1 - 512) on, the rest of the universe is never buffered:
+    +0  Pan coarse      +1  Pan fine        16 bit, 0 - 65535 is the full travel
+    +2  Tilt coarse     +3  Tilt fine
+    +4  Speed           0 is the fastest, 255 the slowest, like a moving light's pan/tilt speed
+    +5  Zoom            0 wide - 255 tele
+    +6  Focus           0 - 63 hold, 64 - 127 near, 128 - 191 far, 192 - 255 auto focus
+**/
+
+#ifndef DMX_HANDLER
+#define DMX_HANDLER
+
+#include <Arduino.h>
+#include <Ethernet.h>
+#include <EthernetUdp.h>
+
+#define DMX_CHANNELS 7
+#define DMX_ARTNET_PORT 6454
+#define DMX_ARTNET_HEADER_SIZE 18
+#define DMX_SACN_PORT 5568
+#define DMX_SACN_HEADER_SIZE 126
+
+//Frame interval assumed until it has been measured (ms), consoles send at up to 44Hz
+#define DMX_DEFAULT_INTERVAL 23
+#define DMX_MIN_INTERVAL 10
+#define DMX_MAX_INTERVAL 100
+
+class DmxHandler {
+    public:
+    enum Channel {
+        PanCoarse,
+        PanFine,
+        TiltCoarse,
+        TiltFine,
+        Speed,
+        Zoom,
+        Focus
+    };
+
+    private:
+    EthernetUDP _udp;
+    uint16_t _universe;
+    uint16_t _startAddress;
+    byte _channels[DMX_CHANNELS];
+    byte _sequence = 0;
+    bool _haveSequence = false;
+    unsigned long _lastFrame = 0;
+    unsigned long _interval = DMX_DEFAULT_INTERVAL;
+    bool _receiving = false;
+    unsigned long _frames = 0;
+
+    static uint16_t get16(const byte *buffer) {return (uint16_t)buffer[0] << 8 | buffer[1];}
+
+    //Check the header of the packet being read. Returns the number of slots in it, 0 if it isn't DMX for us
+    int readHeader() {
+#ifdef DMX_SACN
+        byte header[DMX_SACN_HEADER_SIZE];
+        if(_udp.read(header, DMX_SACN_HEADER_SIZE) != DMX_SACN_HEADER_SIZE){return 0;}
+        if(memcmp(header + 4, "ASC-E1.17\0\0\0", 12) != 0){return 0;}
+        //Root vector data, framing vector data, DMP set property and a null start code
+        if(get16(header + 18) != 0 || get16(header + 20) != 0x0004 || get16(header + 40) != 0 || get16(header + 42) != 0x0002){return 0;}
+        if(header[117] != 0x02 || header[125] != 0){return 0;}
+        if(get16(header + 113) != _universe){return 0;}
+        //Preview data is for visualisers, a terminated stream means the source has gone
+        byte options = header[112];
+        if(options & 0x40) {
+            _receiving = false;
+            return 0;
+        }
+        if(options & 0x80){return 0;}
+        if(!sequenceOk(header[111])){return 0;}
+        return get16(header + 123) - 1;
+#else
+        byte header[DMX_ARTNET_HEADER_SIZE];
+        if(_udp.read(header, DMX_ARTNET_HEADER_SIZE) != DMX_ARTNET_HEADER_SIZE){return 0;}
+        if(memcmp(header, "Art-Net\0", 8) != 0){return 0;}
+        //OpDmx (0x5000, little endian) of protocol 14 or later
+        if(header[8] != 0x00 || header[9] != 0x50 || get16(header + 10) < 14){return 0;}
+        if(((uint16_t)(header[15] & 0x7F) << 8 | header[14]) != _universe){return 0;}
+        //Sequence 0 means the console doesn't number its packets
+        if(header[12] != 0 && !sequenceOk(header[12])){return 0;}
+        return get16(header + 16);
+#endif
+    }
+
+    //Drop packets that arrive out of order, a big jump back is a restarted console so it is taken
+    bool sequenceOk(byte sequence) {
+        int8_t step = sequence - _sequence;
+        if(_haveSequence && step <= 0 && step > -20){return false;}
+        _sequence = sequence;
+        _haveSequence = true;
+        return true;
+    }
+
+    //Read our channels out of the slots of the packet being read. Slots we don't get stay as they were
+    void readChannels(int slots) {
+        int skip = _startAddress - 1;
+        while(skip > 0) {
+            byte scratch[16];
+            int read = _udp.read(scratch, min(skip, (int)sizeof(scratch)));
+            if(read <= 0){return;}
+            skip -= read;
+        }
+        int count = constrain(slots - (_startAddress - 1), 0, DMX_CHANNELS);
+        _udp.read(_channels, count);
+    }
+
+    public:
+    //universe is the Art-Net port address or sACN universe, startAddress the DMX address of the first channel (1 - 512)
+    DmxHandler(uint16_t universe, uint16_t startAddress) {
+        _universe = universe;
+        _startAddress = constrain(startAddress, 1, 512 - DMX_CHANNELS + 1);
+        memset(_channels, 0, sizeof(_channels));
+    }
+
+    //Start listening. Ethernet must already be up (NetworkHandler::begin()). Returns false if there was no socket free
+    bool begin() {
+#ifdef DMX_SACN
+        return _udp.beginMulticast(IPAddress(239, 255, _universe >> 8, _universe & 0xFF), DMX_SACN_PORT);
+#else
+        return _udp.begin(DMX_ARTNET_PORT);
+#endif
+    }
+
+    //Read the waiting packets. Returns true if a new frame for our universe came in, only the latest counts
+    bool process() {
+        bool frame = false;
+        while(_udp.parsePacket() > 0) {
+            int slots = readHeader();
+            if(slots <= 0){continue;}
+            readChannels(slots);
+            frame = true;
+        }
+        if(!frame){return false;}
+
+        //Keep an average of the time between frames, it is how long each setpoint has to be reached in
+        unsigned long now = millis();
+        if(_receiving) {
+            unsigned long interval = constrain(now - _lastFrame, DMX_MIN_INTERVAL, DMX_MAX_INTERVAL);
+            _interval = (_interval * 3 + interval) / 4;
+        }
+        _lastFrame = now;
+        _receiving = true;
+        _frames++;
+        return true;
+    }
+
+    //Have frames been coming in within the last timeout (ms)
+    bool receiving(unsigned long timeout) {
+        if(_receiving && millis() - _lastFrame >= timeout) {
+            _receiving = false;
+            _haveSequence = false;
+            _interval = DMX_DEFAULT_INTERVAL;
+        }
+        return _receiving;
+    }
+
+    byte channel(Channel channel) {return _channels[channel];}
+
+    //Pan and tilt, 0 - 65535
+    uint16_t pan() {return (uint16_t)_channels[Channel::PanCoarse] << 8 | _channels[Channel::PanFine];}
+    uint16_t tilt() {return (uint16_t)_channels[Channel::TiltCoarse] << 8 | _channels[Channel::TiltFine];}
+
+    //Speed limit 1 - 100 %
+    float speed() {return 100.0 - (_channels[Channel::Speed] * 99.0) / 255.0;}
+
+    //Average time between frames (ms)
+    unsigned long interval() {return _interval;}
+    unsigned long frames() {return _frames;}
+};
+
+#endif
@@ -0,0 +1,82 @@
+/**
+    FreeD
+    Responsible for the camera tracking packets sent to virtual set and graphics systems
+
+    D1 packet, 29 bytes, multi byte values big endian and signed:
+    0xD1    CAMERA  PAN (3)     TILT (3)    ROLL (3)    X (3)   Y (3)   HEIGHT (3)  ZOOM (3)    FOCUS (3)   SPARE (2)   CHECKSUM
+    Angles are degrees * 32768, positions mm * 64. Zoom and focus are raw counts the receiver's lens file maps.
+    The checksum is 0x40 minus every byte before it.
+
+    Packets are sent at a fixed rate from the head's step positions. Sending holds the loop for the SPI transfer so
+    the caller only sends when no step is due in that time (Head::stepClear()), a packet that can't be sent in time
+    is dropped rather than sent late
+**/
+
+#ifndef FREED
+#define FREED
+
+#include <Arduino.h>
+
+#define FREED_PACKET_SIZE 29
+#define FREED_D1 0xD1
+
+class FreeD {
+    private:
+    byte _camera;
+    unsigned long _period;
+    unsigned long _next = 0;
+    unsigned long _sent = 0;
+    unsigned long _dropped = 0;
+
+    static void put24(byte *buffer, int32_t value) {
+        buffer[0] = (value >> 16) & 0xFF;
+        buffer[1] = (value >> 8) & 0xFF;
+        buffer[2] = value & 0xFF;
+    }
+
+    //Degrees to 24 bit, 15 bits of fraction. Kept to +-255 degrees so it doesn't wrap
+    static int32_t angle(float degrees) {
+        return constrain(degrees, -255.0, 255.0) * 32768.0;
+    }
+
+    public:
+    //camera is the id in the packet, rate the packets a second
+    FreeD(byte camera, unsigned int rate) {
+        _camera = camera;
+        _period = 1000000UL / rate;
+    }
+
+    //Is a packet due
+    bool due() {
+        return (int32_t)(micros() - _next) >= 0;
+    }
+
+    //A packet was sent, schedule the next. If packets were missed the schedule starts again from now
+    void sent() {
+        _sent++;
+        _next += _period;
+        if((int32_t)(micros() - _next) >= 0) {
+            _dropped += (micros() - _next) / _period + 1;
+            _next = micros() + _period;
+        }
+    }
+
+    unsigned long packetsSent() {return _sent;}
+    unsigned long packetsDropped() {return _dropped;}
+
+    //Fill a D1 packet. Pan and tilt in degrees, the head has no roll or position
+    void build(byte packet[FREED_PACKET_SIZE], float pan, float tilt, long zoom, long focus) {
+        memset(packet, 0, FREED_PACKET_SIZE);
+        packet[0] = FREED_D1;
+        packet[1] = _camera;
+        put24(packet + 2, angle(pan));
+        put24(packet + 5, angle(tilt));
+        put24(packet + 20, zoom);
+        put24(packet + 23, focus);
+        byte checksum = 0x40;
+        for(byte i = 0; i < FREED_PACKET_SIZE - 1; i++) {checksum -= packet[i];}
+        packet[FREED_PACKET_SIZE - 1] = checksum;
+    }
+};
+
+#endif
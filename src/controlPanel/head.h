@@ -28,6 +28,8 @@ class Stepper {
     bool _movingToPosition = false;
     bool _movingRelative = false;
     bool _isStopping = false;
+    long _lastPosition = 0;
+    unsigned long _lastStep = 0;        //micros() the last step was seen at
     // const int _totalMemoryAllocation = STEPPER_MEM_ALLOC;
     public:
     enum LimitType {
@@ -162,8 +164,18 @@ class Stepper {
 
     //Move to a specific location
     void moveTo(long position, float speed = 100.0, float acceleration = 100.0) {
+        prepareMove(speed, acceleration);
+        startMove(position);
+    }
+
+    //Set the speed and acceleration of the next startMove() ahead of time. The acceleration is the slow part (a square root)
+    void prepareMove(float speed, float acceleration) {
         _stepper.setMaxSpeed(_maxSpeed * (speed/100.0));
         _stepper.setAcceleration(_defaultAcceleration * (acceleration/100.0));
+    }
+
+    //Start moving to a position with the speed and acceleration already set
+    void startMove(long position) {
         if(position > _maxPosition - STEP_SAFE_ZONE){position = _maxPosition - STEP_SAFE_ZONE;}
         _stepper.moveTo(position);
         _movingToPosition = true;
@@ -243,6 +255,45 @@ class Stepper {
     long maxPosition() {
         return _maxPosition;
     }
+
+    //Top speed (steps/s) and acceleration (steps/s^2) that 100% is
+    int maxSpeed() {
+        return _maxSpeed;
+    }
+
+    int defaultAcceleration() {
+        return _defaultAcceleration;
+    }
+
+    long currentPosition() {
+        return _stepper.currentPosition();
+    }
+
+    long targetPosition() {
+        return _stepper.targetPosition();
+    }
+
+    //Current speed in steps per second
+    float speed() {
+        return _stepper.speed();
+    }
+
+    //Note when a step has been taken, call straight after run()
+    void noteStep() {
+        if(_stepper.currentPosition() != _lastPosition) {
+            _lastPosition = _stepper.currentPosition();
+            _lastStep = micros();
+        }
+    }
+
+    //Roughly how long until the next step is due at the current speed (us). 0 if it is already due
+    unsigned long timeToNextStep() {
+        float speed = abs(_stepper.speed());
+        if(speed < 1.0){return 1000000UL;}
+        unsigned long interval = 1000000.0 / speed;
+        unsigned long since = micros() - _lastStep;
+        return since >= interval ? 0 : interval - since;
+    }
 };
 
 class Head {
@@ -324,6 +375,26 @@ class Head {
         _steppers[StepperAxis::Y]->goHome(globalSpeed, acceleration);
     }
 
+    int maxSpeed(StepperAxis axis) {
+        return _steppers[axis]->maxSpeed();
+    }
+
+    long maxPosition(StepperAxis axis) {
+        return _steppers[axis]->maxPosition();
+    }
+
+    long currentPosition(StepperAxis axis) {
+        return _steppers[axis]->currentPosition();
+    }
+
+    long targetPosition(StepperAxis axis) {
+        return _steppers[axis]->targetPosition();
+    }
+
+    float speed(StepperAxis axis) {
+        return _steppers[axis]->speed();
+    }
+
     boolean movingToPosition() {
         return _steppers[StepperAxis::X]->isMovingToPosition() || _steppers[StepperAxis::Y]->isMovingToPosition();
     }
@@ -339,13 +410,65 @@ class Head {
         _steppers[StepperAxis::Y]->moveTo(y, speed, accleration);
     }
 
+    //Move to a specific location with both axes starting and arriving together. The axis that takes longest sets the pace,
+    //the other has its speed and acceleration scaled by its share of the distance so its profile is the same shape
+    void moveToXYTogether(long x, long y, float speed = 100.0, float acceleration = 100.0) {
+        prepareXYTogether(x, y, speed, acceleration);
+        startXY(x, y);
+    }
+
+    //Work out and set the speeds and accelerations for moveToXYTogether() without starting. startXY() then starts it
+    void prepareXYTogether(long x, long y, float speed = 100.0, float acceleration = 100.0) {
+        long target[2] = {x, y};
+        float distance[2];
+        float time[2];
+        for(int i = StepperAxis::X; i <= StepperAxis::Y; i++) {
+            distance[i] = abs(target[i] - _steppers[i]->currentPosition());
+            time[i] = moveTime(distance[i], _steppers[i]->maxSpeed() * (speed / 100.0), _steppers[i]->defaultAcceleration() * (acceleration / 100.0));
+        }
+        int lead = time[StepperAxis::Y] > time[StepperAxis::X] ? StepperAxis::Y : StepperAxis::X;
+        float leadSpeed = _steppers[lead]->maxSpeed() * (speed / 100.0);
+        float leadAcceleration = _steppers[lead]->defaultAcceleration() * (acceleration / 100.0);
+
+        for(int i = StepperAxis::X; i <= StepperAxis::Y; i++) {
+            float axisSpeed = speed;
+            float axisAcceleration = acceleration;
+            if(i != lead && distance[i] > 0) {
+                float scale = distance[i] / distance[lead];
+                axisSpeed = min(speed, (leadSpeed * scale * 100.0) / _steppers[i]->maxSpeed());
+                axisAcceleration = min(acceleration, (leadAcceleration * scale * 100.0) / _steppers[i]->defaultAcceleration());
+            }
+            _steppers[i]->prepareMove(axisSpeed, axisAcceleration);
+        }
+    }
+
+    //Start both axes toward a position with the speeds and accelerations already set
+    void startXY(long x, long y) {
+        _steppers[StepperAxis::X]->startMove(x);
+        _steppers[StepperAxis::Y]->startMove(y);
+    }
+
+    //Seconds a move takes from stopped to stopped. Triangular when it never reaches full speed
+    static float moveTime(float distance, float speed, float acceleration) {
+        if(speed <= 0 || acceleration <= 0){return 0;}
+        if(distance < (speed * speed) / acceleration){return 2.0 * sqrt(distance / acceleration);}
+        return distance / speed + speed / acceleration;
+    }
+
     //The main loop. Returns true if a stepper is moving
     boolean run() {
         boolean isRunning = false;
         if(_steppers[StepperAxis::X]->run() == Stepper::Status::Moving){isRunning=true;}
         if(_steppers[StepperAxis::Y]->run() == Stepper::Status::Moving){isRunning=true;}
+        _steppers[StepperAxis::X]->noteStep();
+        _steppers[StepperAxis::Y]->noteStep();
         return isRunning;
     }
+
+    //Is there at least window (us) before either axis needs to step. Slow work done in that gap doesn't hold up a step
+    bool stepClear(unsigned long window) {
+        return _steppers[StepperAxis::X]->timeToNextStep() >= window && _steppers[StepperAxis::Y]->timeToNextStep() >= window;
+    }
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,294 @@
+/**
+    Journal
+    Responsible for persisting state that changes often without wearing out the EEPROM or blocking the loop
+
+    The journal space is split into two banks. Writes are appended to the active bank as records, so the same
+    cells are not rewritten every time a value changes. When the active bank runs low the latest record of every
+    key is copied into the other bank, which then becomes active and the old bank is erased.
+
+    Bank:   MAGIC   'J'     SEQUENCE (2)    RECORDS...
+    Record: KEY     LENGTH  DATA (LENGTH)   CRC8
+
+    Unwritten EEPROM reads 0xFF, a 0xFF key is the end of the records. The new bank's header is written last
+    so a power cut during compaction leaves the old bank active.
+
+    EEPROM writes take ~3.3ms each. Nothing here waits for one: writes go into a queue and service(), called
+    every loop, starts the next byte only once the previous one has finished. avr-libc's eeprom_read_byte() spins
+    until a write in progress is done, so nothing reads the EEPROM while one is (ready()). Background work only runs
+    in a service() call that didn't start a write, and read() returns JOURNAL_BUSY rather than wait
+**/
+
+#ifndef JOURNAL
+#define JOURNAL
+
+#include <Arduino.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+
+#define JOURNAL_MAGIC 0xA5
+#define JOURNAL_MAGIC_1 'J'
+#define JOURNAL_HEADER_SIZE 4
+#define JOURNAL_RECORD_OVERHEAD 3
+#define JOURNAL_MAX_KEYS 16
+#define JOURNAL_MAX_LENGTH 32
+#define JOURNAL_QUEUE_SIZE 48
+#define JOURNAL_NO_ADDRESS 0xFFFF
+
+//read() couldn't get to the EEPROM because a write is in progress
+#define JOURNAL_BUSY 0xFF
+
+//Compaction starts when the active bank has less than this left
+#define JOURNAL_COMPACT_SPACE (JOURNAL_QUEUE_SIZE * 2)
+
+class Journal {
+    private:
+    enum State {
+        Idle,
+        Compacting,
+        Erasing
+    };
+    struct PendingWrite {
+        uint16_t address;
+        byte value;
+    };
+
+    uint16_t _start;
+    uint16_t _bankSize;
+    byte _activeBank = 0;
+    uint16_t _sequence = 0;
+    uint16_t _writeAddress;
+    uint16_t _records[JOURNAL_MAX_KEYS];    //Address of the latest record of each key
+
+    State _state = State::Idle;
+    byte _compactKey = 0;
+    uint16_t _compactDone = 0;              //Bit per key already in the new bank
+    uint16_t _eraseAddress = 0;
+    uint16_t _eraseEnd = 0;
+
+    PendingWrite _queue[JOURNAL_QUEUE_SIZE];
+    byte _queueHead = 0;
+    byte _queueTail = 0;
+
+    uint16_t bankStart(byte bank) {return _start + bank * _bankSize;}
+    uint16_t bankEnd(byte bank) {return bankStart(bank) + _bankSize;}
+
+    byte queued() {return (_queueHead - _queueTail + JOURNAL_QUEUE_SIZE) % JOURNAL_QUEUE_SIZE;}
+    byte queueFree() {return JOURNAL_QUEUE_SIZE - 1 - queued();}
+
+    void enqueue(uint16_t address, byte value) {
+        _queue[_queueHead].address = address;
+        _queue[_queueHead].value = value;
+        _queueHead = (_queueHead + 1) % JOURNAL_QUEUE_SIZE;
+    }
+
+    //Read a byte as it will be once the queue is written. Returns false if it has to come from the EEPROM while it is busy
+    bool readByte(uint16_t address, byte &value) {
+        for(byte i = _queueHead; i != _queueTail;) {
+            i = (i + JOURNAL_QUEUE_SIZE - 1) % JOURNAL_QUEUE_SIZE;
+            if(_queue[i].address == address) {
+                value = _queue[i].value;
+                return true;
+            }
+        }
+        if(!ready()){return false;}
+        value = eeprom_read_byte((const uint8_t *)address);
+        return true;
+    }
+
+    static byte crc(byte key, const byte *data, byte length) {
+        byte crc = _crc8_ccitt_update(0, key);
+        crc = _crc8_ccitt_update(crc, length);
+        for(byte i = 0; i < length; i++) {crc = _crc8_ccitt_update(crc, data[i]);}
+        return crc;
+    }
+
+    //Queue a record at the write address. The caller has checked the queue and bank have room
+    void appendRecord(byte key, const byte *data, byte length) {
+        uint16_t address = _writeAddress;
+        enqueue(address, key);
+        enqueue(address + 1, length);
+        for(byte i = 0; i < length; i++) {enqueue(address + 2 + i, data[i]);}
+        enqueue(address + 2 + length, crc(key, data, length));
+        _records[key] = address;
+        _writeAddress += length + JOURNAL_RECORD_OVERHEAD;
+    }
+
+    bool bankValid(byte bank, uint16_t &sequence) {
+        uint16_t start = bankStart(bank);
+        if(eeprom_read_byte((const uint8_t *)start) != JOURNAL_MAGIC || eeprom_read_byte((const uint8_t *)(start + 1)) != JOURNAL_MAGIC_1){return false;}
+        sequence = eeprom_read_word((const uint16_t *)(start + 2));
+        return true;
+    }
+
+    //Switch writing to the other bank and copy the live records over in the background
+    void startCompaction() {
+        _state = State::Compacting;
+        _compactKey = 0;
+        _compactDone = 0;
+        _activeBank = 1 - _activeBank;
+        _writeAddress = bankStart(_activeBank) + JOURNAL_HEADER_SIZE;
+    }
+
+    //Erase a bank in the background
+    void startErase(byte bank) {
+        _state = State::Erasing;
+        _eraseAddress = bankStart(bank);
+        _eraseEnd = bankEnd(bank);
+    }
+
+    //Move the compaction or erase on by what fits in the queue
+    void step() {
+        if(_state == State::Compacting) {
+            //Copy the next live key that has not been rewritten since the compaction started
+            while(_compactKey < JOURNAL_MAX_KEYS && (_records[_compactKey] == JOURNAL_NO_ADDRESS || (_compactDone & ((uint16_t)1 << _compactKey)))) {_compactKey++;}
+            if(_compactKey < JOURNAL_MAX_KEYS) {
+                byte data[JOURNAL_MAX_LENGTH];
+                byte length = read(_compactKey, data, JOURNAL_MAX_LENGTH);
+                if(length == JOURNAL_BUSY || queueFree() < length + JOURNAL_RECORD_OVERHEAD){return;}
+                appendRecord(_compactKey, data, length);
+                _compactDone |= (uint16_t)1 << _compactKey;
+                return;
+            }
+
+            //Everything is across, commit the new bank then retire the old one
+            if(queueFree() < JOURNAL_HEADER_SIZE + 1){return;}
+            uint16_t start = bankStart(_activeBank);
+            _sequence++;
+            enqueue(start + 2, _sequence & 0xFF);
+            enqueue(start + 3, _sequence >> 8);
+            enqueue(start + 1, JOURNAL_MAGIC_1);
+            enqueue(start, JOURNAL_MAGIC);
+            enqueue(bankStart(1 - _activeBank), 0xFF);
+            startErase(1 - _activeBank);
+        }
+        else if(_state == State::Erasing) {
+            //Only queue the bytes that are not already blank
+            while(_eraseAddress < _eraseEnd && queueFree() > 0) {
+                if(!ready()){return;}
+                if(eeprom_read_byte((const uint8_t *)_eraseAddress) != 0xFF){enqueue(_eraseAddress, 0xFF);}
+                _eraseAddress++;
+            }
+            if(_eraseAddress >= _eraseEnd) {
+                _state = State::Idle;
+                if(freeSpace() < JOURNAL_COMPACT_SPACE){startCompaction();}
+            }
+        }
+    }
+
+    public:
+    //The journal uses EEPROM from start up to end
+    Journal(uint16_t start, uint16_t end) {
+        _start = start;
+        _bankSize = (end - start) / 2;
+    }
+
+    //Find the active bank and the latest record of each key. Blocking, call once from setup(). Until service() is
+    //first called nothing is written so read() can be used straight after
+    void begin() {
+        eeprom_busy_wait();
+        for(byte i = 0; i < JOURNAL_MAX_KEYS; i++) {_records[i] = JOURNAL_NO_ADDRESS;}
+
+        uint16_t sequence0 = 0;
+        uint16_t sequence1 = 0;
+        bool valid0 = bankValid(0, sequence0);
+        bool valid1 = bankValid(1, sequence1);
+        if(!valid0 && !valid1) {
+            //Fresh journal, bank 0 becomes active once it is blank
+            _activeBank = 0;
+            _sequence = 0;
+            _writeAddress = bankStart(0) + JOURNAL_HEADER_SIZE;
+            for(uint16_t address = bankStart(0); address < bankEnd(1); address++) {
+                if(eeprom_read_byte((const uint8_t *)address) != 0xFF){eeprom_write_byte((uint8_t *)address, 0xFF);}
+            }
+            eeprom_write_word((uint16_t *)(bankStart(0) + 2), 0);
+            eeprom_write_byte((uint8_t *)(bankStart(0) + 1), JOURNAL_MAGIC_1);
+            eeprom_write_byte((uint8_t *)bankStart(0), JOURNAL_MAGIC);
+            return;
+        }
+        _activeBank = (valid0 && (!valid1 || (int16_t)(sequence0 - sequence1) > 0)) ? 0 : 1;
+        _sequence = _activeBank == 0 ? sequence0 : sequence1;
+
+        //Walk the records, a bad CRC is a write that was cut off and ends the journal
+        uint16_t address = bankStart(_activeBank) + JOURNAL_HEADER_SIZE;
+        bool torn = false;
+        while(address + JOURNAL_RECORD_OVERHEAD <= bankEnd(_activeBank)) {
+            byte key = eeprom_read_byte((const uint8_t *)address);
+            if(key == 0xFF){break;}
+            byte length = eeprom_read_byte((const uint8_t *)(address + 1));
+            if(key >= JOURNAL_MAX_KEYS || length > JOURNAL_MAX_LENGTH || address + length + JOURNAL_RECORD_OVERHEAD > bankEnd(_activeBank)) {torn = true; break;}
+            byte data[JOURNAL_MAX_LENGTH];
+            eeprom_read_block(data, (const void *)(address + 2), length);
+            if(crc(key, data, length) != eeprom_read_byte((const uint8_t *)(address + 2 + length))) {torn = true; break;}
+            _records[key] = address;
+            address += length + JOURNAL_RECORD_OVERHEAD;
+        }
+        //Anything after a torn record can't be trusted to be blank. Treat the bank as full so it is compacted
+        //into the spare bank as soon as that has been erased
+        _writeAddress = torn ? bankEnd(_activeBank) : address;
+        startErase(1 - _activeBank);
+    }
+
+    //Queue a value to be saved. Returns false if it can't be taken right now (queue full or compacting), try again later
+    bool write(byte key, const void *data, byte length) {
+        if(key >= JOURNAL_MAX_KEYS || length > JOURNAL_MAX_LENGTH){return false;}
+        if(queueFree() < length + JOURNAL_RECORD_OVERHEAD){return false;}
+        if(_writeAddress + length + JOURNAL_RECORD_OVERHEAD > bankEnd(_activeBank)){return false;}
+
+        //Skip writes that would not change anything. If the EEPROM is busy it is just written
+        byte current[JOURNAL_MAX_LENGTH];
+        if(read(key, current, JOURNAL_MAX_LENGTH) == length && memcmp(current, data, length) == 0){return true;}
+
+        appendRecord(key, (const byte *)data, length);
+        if(_state == State::Compacting){_compactDone |= (uint16_t)1 << key;}
+
+        //Start moving to the other bank while there is still room for appends. If the other bank is still being erased this happens once it is done
+        if(_state == State::Idle && freeSpace() < JOURNAL_COMPACT_SPACE){startCompaction();}
+        return true;
+    }
+
+    //Read the latest value of a key. Returns the length read, 0 if it was never written or JOURNAL_BUSY if an EEPROM
+    //write is in progress, try again later
+    byte read(byte key, void *data, byte length) {
+        if(key >= JOURNAL_MAX_KEYS || _records[key] == JOURNAL_NO_ADDRESS){return 0;}
+        uint16_t address = _records[key];
+        byte stored;
+        if(!readByte(address + 1, stored)){return JOURNAL_BUSY;}
+        if(stored < length){length = stored;}
+        for(byte i = 0; i < length; i++) {
+            if(!readByte(address + 2 + i, ((byte *)data)[i])){return JOURNAL_BUSY;}
+        }
+        return length;
+    }
+
+    //Is the EEPROM free to be read or written
+    bool ready() {
+        return !(EECR & _BV(EEPE));
+    }
+
+    //Write the next queued byte if the EEPROM is free. Call every loop, this never waits. The compaction and erase only
+    //move on in a call that didn't start a write, so they never read the EEPROM while it is busy
+    void service() {
+        if(!ready()){return;}
+        if(_queueTail != _queueHead) {
+            PendingWrite &write = _queue[_queueTail];
+            _queueTail = (_queueTail + 1) % JOURNAL_QUEUE_SIZE;
+            if(eeprom_read_byte((const uint8_t *)write.address) != write.value) {
+                eeprom_write_byte((uint8_t *)write.address, write.value);
+                return;
+            }
+        }
+        if(_state != State::Idle){step();}
+    }
+
+    //Are there writes still waiting to go to the EEPROM
+    bool busy() {
+        return _queueTail != _queueHead || _state == State::Compacting;
+    }
+
+    //Bytes left in the active bank
+    uint16_t freeSpace() {
+        return bankEnd(_activeBank) - _writeAddress;
+    }
+};
+
+#endif
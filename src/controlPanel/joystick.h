@@ -9,11 +9,19 @@
 #define JOYSTICK_HANDLER
 
 #include <Arduino.h>
-#include <EEPROMex.h>
 #include "settings.h"
 
 #define DEFAULT_DEADZONE 20
 
+//Response curves are compiled into a table of CURVE_LUT_SIZE points over the deflection (0 - CURVE_INPUT_MAX)
+//giving the output in 1/10 of a percent. Custom curves are CURVE_POINTS outputs (%) at 0, 25, 50, 75 and 100% deflection
+#define CURVE_POINTS 5
+#define CURVE_LUT_SHIFT 5
+#define CURVE_LUT_SIZE 33
+#define CURVE_INPUT_MAX 1024
+#define CURVE_OUTPUT_MAX 1000
+#define DEFAULT_EXPO 50
+
 class JoyStick {
     public:
     enum ValueType {
@@ -28,18 +36,54 @@ class JoyStick {
         Y,
         Z
     };
+    enum Curve {
+        Linear,
+        Expo,
+        Custom,
+        TotalCurves
+    };
+    struct AxisCurve {
+        byte type;
+        byte expo;                  //0 - 100, how much of the cubic is mixed in
+        byte points[CURVE_POINTS];  //Custom curve output (%) at 0, 25, 50, 75, 100% deflection
+    };
+    //Everything that is kept in the settings store
+    struct Settings {
+        uint16_t axis[3][3];        //[axis][min, max, center]
+        AxisCurve curves[3];
+    };
     private:
     uint16_t _axisSettings[3][5] = {{0, 0, 0, 0, 0}, {0, 0, 0, 0, 0}, {0, 0, 0, 0, 0}};
     int16_t _axisDeadzones[3] = {DEFAULT_DEADZONE, DEFAULT_DEADZONE, DEFAULT_DEADZONE};
-    int _memoryStartAddress = 1;
-    int _totalMemoryAllocation = JOY_MEM_ALLOC;
-
+    AxisCurve _curves[3] = {{Curve::Linear, DEFAULT_EXPO, {0, 25, 50, 75, 100}}, {Curve::Linear, DEFAULT_EXPO, {0, 25, 50, 75, 100}}, {Curve::Linear, DEFAULT_EXPO, {0, 25, 50, 75, 100}}};
+
+    //Compiled curves and the scale from a raw value to the curve input, [axis][0] below center, [axis][1] above
+    int16_t _curveTable[3][CURVE_LUT_SIZE];
+    uint32_t _curveScale[3][2];
+    int16_t _curveRange[3][2];
+
+    //Output of a curve (0 - 1.0) for a deflection (0 - 1.0). Only used when compiling
+    static float curveOutput(const AxisCurve &curve, float x) {
+        switch(curve.type) {
+            case Curve::Expo: {
+                float e = curve.expo / 100.0;
+                return (1.0 - e) * x + e * x * x * x;
+            }
+            case Curve::Custom: {
+                float position = x * (CURVE_POINTS - 1);
+                int i = (int)position;
+                if(i >= CURVE_POINTS - 1){return curve.points[CURVE_POINTS - 1] / 100.0;}
+                return (curve.points[i] + (curve.points[i + 1] - curve.points[i]) * (position - i)) / 100.0;
+            }
+            default: {return x;}
+        }
+    }
     public:
-    void setAxisDeadzone(Axis axis, int16_t deadzone){_axisDeadzones[axis] = deadzone;}
+    void setAxisDeadzone(Axis axis, int16_t deadzone){_axisDeadzones[axis] = deadzone; compileCurves();}
 
     //Get a axis position as a raw value
     int16_t getValue(Axis axis) {
-        int16_t val = _axisSettings[axis][ValueType::Center] - analogRead(_axisSettings[axis][ValueType::Pin]);
+        int16_t val = _axisSettings[axis][ValueType::Center] - analogInputs.read(_axisSettings[axis][ValueType::Pin]);
         if(val > _axisDeadzones[axis]) {
             val = val - _axisDeadzones[axis];
         }
@@ -56,16 +100,72 @@ class JoyStick {
         }
     }
 
+    //Build the lookup tables from the curves and calibration. Call after either changes
+    void compileCurves() {
+        for(int axis = Axis::X; axis <= Axis::Z; axis++) {
+            for(int i = 0; i < CURVE_LUT_SIZE; i++) {
+                float output = curveOutput(_curves[axis], (float)i / (CURVE_LUT_SIZE - 1));
+                if(output < 0.0){output = 0.0;}
+                if(output > 1.0){output = 1.0;}
+                _curveTable[axis][i] = (int16_t)(output * CURVE_OUTPUT_MAX + 0.5);
+            }
+
+            _curveRange[axis][0] = (_axisSettings[axis][ValueType::Center] - _axisSettings[axis][ValueType::MinValue]) - _axisDeadzones[axis];
+            _curveRange[axis][1] = (_axisSettings[axis][ValueType::MaxValue] - _axisSettings[axis][ValueType::Center]) - _axisDeadzones[axis];
+            for(int side = 0; side < 2; side++) {
+                _curveScale[axis][side] = _curveRange[axis][side] > 0 ? ((uint32_t)CURVE_INPUT_MAX << 16) / _curveRange[axis][side] : 0;
+            }
+        }
+    }
+
+    //Get the output of a axis through its response curve in 1/10 of a percent (-1000 -> 1000)
+    int16_t getPerMille(Axis axis) {
+        int16_t val = getValue(axis);
+        if(val == 0){return 0;}
+        byte side = val > 0 ? 1 : 0;
+        uint16_t magnitude = abs(val);
+
+        //Scale to the curve input with a multiply instead of a divide
+        uint16_t input = CURVE_INPUT_MAX;
+        if(magnitude < _curveRange[axis][side]) {input = ((uint32_t)magnitude * _curveScale[axis][side]) >> 16;}
+        if(input > CURVE_INPUT_MAX){input = CURVE_INPUT_MAX;}
+
+        //Interpolate between the two nearest table points
+        byte i = input >> CURVE_LUT_SHIFT;
+        int16_t output = _curveTable[axis][i];
+        if(i < CURVE_LUT_SIZE - 1) {
+            byte fraction = input & ((1 << CURVE_LUT_SHIFT) - 1);
+            output += ((int32_t)(_curveTable[axis][i + 1] - output) * fraction) >> CURVE_LUT_SHIFT;
+        }
+        return side ? output : -output;
+    }
+
     //Get the percentage of a axis
     float getPercentage(Axis axis) {
-        int16_t val = getValue(axis);
-        float ret = 0;
-        if(val <  0){ret = ((float)val / (float)((_axisSettings[axis][ValueType::Center] - _axisSettings[axis][ValueType::MinValue]) - _axisDeadzones[axis])) * 100.0;}
-        if(val >  0){ret = ((float)val / (float)((_axisSettings[axis][ValueType::MaxValue] - _axisSettings[axis][ValueType::Center]) - _axisDeadzones[axis])) * 100.0;}
+        return getPerMille(axis) / 10.0;
+    }
 
-        if(ret < -100.0){ret = -100.0;}
-        if(ret > 100.0) {ret = 100.0;}
-        return ret;
+    //Set the response curve of a axis. Custom points may be null to keep the current ones
+    void setCurve(Axis axis, Curve type, byte expo, const byte *points = nullptr) {
+        if(type >= Curve::TotalCurves){type = Curve::Linear;}
+        if(expo > 100){expo = 100;}
+        _curves[axis].type = type;
+        _curves[axis].expo = expo;
+        if(points != nullptr) {
+            for(int i = 0; i < CURVE_POINTS; i++) {_curves[axis].points[i] = points[i] > 100 ? 100 : points[i];}
+        }
+    }
+
+    Curve getCurve(Axis axis) {
+        return (Curve)_curves[axis].type;
+    }
+
+    static const char *curveName(Curve type) {
+        switch(type) {
+            case Curve::Expo: {return "Expo";}
+            case Curve::Custom: {return "Custom";}
+            default: {return "Linear";}
+        }
     }
 
     //Output the joystick values to console
@@ -73,11 +173,11 @@ class JoyStick {
         int value = 0;
         float percentage = 0.0;
         Serial.print("Joystick Raw XYZ:");
-        Serial.print(analogRead(_axisSettings[Axis::X][ValueType::Pin]));
+        Serial.print(analogInputs.read(_axisSettings[Axis::X][ValueType::Pin]));
         Serial.print(", ");
-        Serial.print(analogRead(_axisSettings[Axis::Y][ValueType::Pin]));
+        Serial.print(analogInputs.read(_axisSettings[Axis::Y][ValueType::Pin]));
         Serial.print(", ");
-        Serial.print(analogRead(_axisSettings[Axis::Z][ValueType::Pin]));
+        Serial.print(analogInputs.read(_axisSettings[Axis::Z][ValueType::Pin]));
         Serial.print("; VAL XYZ:");
         value = getValue(Axis::X);
         percentage = getPercentage(Axis::X);
@@ -95,11 +195,11 @@ class JoyStick {
     }
 
     //Get the center value of a axis. Returns the center value
-    uint16_t calibateAxisCenter(Axis axis, String name, LCD lcd) {
+    uint16_t calibateAxisCenter(Axis axis, String name, LCD &lcd) {
         leftLCD.showText(name + " Centre", "Processing..", "Let " + name + " sit");
         uint16_t centerValue = 0;
         for(int i = 1; i <= 100; i++) {
-            centerValue += analogRead(_axisSettings[axis][ValueType::Pin]);
+            centerValue += analogInputs.read(_axisSettings[axis][ValueType::Pin]);
             leftLCD.setTextToShow(name + " Centre", "Processing..", "Let " + name + " sit", (String)(centerValue / i));
             leftLCD.update();
             delay(50);
@@ -108,7 +208,7 @@ class JoyStick {
     }
 
     //Get the min max values of a axis. Returns array [min, max]
-    uint16_t calibateAxisMinMax(Axis axis, String name, LCD lcd, uint16_t &min, uint16_t &max) {
+    uint16_t calibateAxisMinMax(Axis axis, String name, LCD &lcd, uint16_t &min, uint16_t &max) {
         // long timeout = millis() + 5000;
 
         leftLCD.showText(name + " Min-Max", "", "Move to min");
@@ -116,7 +216,7 @@ class JoyStick {
         leftLCD.showText(name + " Min-Max", "Processing..", "Hold at min", "");
         uint16_t read = 0;
         for(int i = 1; i <= 10; i++) {
-            read += analogRead(_axisSettings[axis][ValueType::Pin]);
+            read += analogInputs.read(_axisSettings[axis][ValueType::Pin]);
             leftLCD.setTextToShow(name + " Min-Max", "Processing..", "Hold at min", (String)(read / i));
             leftLCD.update();
             delay(500);
@@ -128,7 +228,7 @@ class JoyStick {
         leftLCD.showText(name + " Min-Max", "Processing..", "Hold at max", "");
         read = 0;
         for(int i = 1; i <= 10; i++) {
-            read += analogRead(_axisSettings[axis][ValueType::Pin]);
+            read += analogInputs.read(_axisSettings[axis][ValueType::Pin]);
             leftLCD.setTextToShow(name + " Min-Max", "Processing..", "Hold at max", (String)(read / i));
             leftLCD.update();
             delay(500);
@@ -138,7 +238,7 @@ class JoyStick {
     }
 
     //Calibrate the joystick
-    void calibrate(LCD leftLCD, LCD rightLCD) {
+    void calibrate(LCD &leftLCD, LCD &rightLCD) {
         leftLCD.showText("Joystick", "", "Get ready");
         rightLCD.showText("Calibration", "Follow left screen");
         delay(5000);
@@ -199,7 +299,7 @@ class JoyStick {
         _axisSettings[Axis::Z][ValueType::Center] = values[Axis::Z][0];
         _axisSettings[Axis::Z][ValueType::MinValue] = values[Axis::Z][1];
         _axisSettings[Axis::Z][ValueType::MaxValue] = values[Axis::Z][2];
-        setSettingsToMemory();
+        compileCurves();
 
         rightLCD.showText("Calibration", "", "Joystick Complete");
         leftLCD.showText("Calibration", "", "Joystick Complete");
@@ -207,67 +307,6 @@ class JoyStick {
         delay(5000);
     }
 
-    //Read the settings from memory XYZ[min, max, center]
-    boolean readSettingsFromMemory() {
-        if(_memoryStartAddress == -1 || _memoryStartAddress + _totalMemoryAllocation > END_OF_MEMORY) {
-            Serial.println("Could not read joystick memory cause the start address was not set or is outside of useable memory");
-            return false;
-        }
-        else {
-            //If all the values are set to 255 then set the defaults
-            int amountOfUnsetData = 0;
-            for(int i = _memoryStartAddress; i < _memoryStartAddress + _totalMemoryAllocation; i++) {if(EEPROM.read(i) == 255){amountOfUnsetData++;}}
-            if(amountOfUnsetData == _totalMemoryAllocation) {
-                //Data is not set default them
-                Serial.println("Joystick settings are not set. Setting defaults");
-                setSettingsToMemory();
-                return true;
-            }
-            else {
-                _axisSettings[Axis::X][ValueType::MinValue] = EEPROM.readInt(_memoryStartAddress);
-                _axisSettings[Axis::X][ValueType::MaxValue] = EEPROM.readInt(_memoryStartAddress + 2);
-                _axisSettings[Axis::X][ValueType::Center] = EEPROM.readInt(_memoryStartAddress + 4);
-
-                _axisSettings[Axis::Y][ValueType::MinValue] = EEPROM.readInt(_memoryStartAddress + 6);
-                _axisSettings[Axis::Y][ValueType::MaxValue] = EEPROM.readInt(_memoryStartAddress + 8);
-                _axisSettings[Axis::Y][ValueType::Center] = EEPROM.readInt(_memoryStartAddress + 10);
-
-                _axisSettings[Axis::Z][ValueType::MinValue] = EEPROM.readInt(_memoryStartAddress + 12);
-                _axisSettings[Axis::Z][ValueType::MaxValue] = EEPROM.readInt(_memoryStartAddress + 14);
-                _axisSettings[Axis::Z][ValueType::Center] = EEPROM.readInt(_memoryStartAddress + 16);
-                return true;
-            }
-        }
-    }
-
-    //Set the settings from memory
-    boolean setSettingsToMemory() {
-        if(_memoryStartAddress == -1 || _memoryStartAddress + _totalMemoryAllocation > END_OF_MEMORY) {
-            Serial.println("Could not set joystick memory cause the start address was not set or is outside of useable memory");
-            return false;
-        }
-        else {
-            Serial.print("Set joystick to memory..");
-
-            Serial.print("X@" + (String)_memoryStartAddress + " , ");
-            EEPROM.writeInt(_memoryStartAddress, _axisSettings[Axis::X][ValueType::MinValue]);
-            EEPROM.writeInt(_memoryStartAddress + 2, _axisSettings[Axis::X][ValueType::MaxValue]);
-            EEPROM.writeInt(_memoryStartAddress + 4, _axisSettings[Axis::X][ValueType::Center]);
-
-            Serial.print("Y@" + (String)(_memoryStartAddress + 6) + " , ");
-            EEPROM.writeInt(_memoryStartAddress + 6, _axisSettings[Axis::Y][ValueType::MinValue]);
-            EEPROM.writeInt(_memoryStartAddress + 8, _axisSettings[Axis::Y][ValueType::MaxValue]);
-            EEPROM.writeInt(_memoryStartAddress + 10, _axisSettings[Axis::Y][ValueType::Center]);
-
-            Serial.print("Z@" + (String)(_memoryStartAddress + 12));
-            EEPROM.writeInt(_memoryStartAddress + 12, _axisSettings[Axis::Z][ValueType::MinValue]);
-            EEPROM.writeInt(_memoryStartAddress + 14, _axisSettings[Axis::Z][ValueType::MaxValue]);
-            EEPROM.writeInt(_memoryStartAddress + 16, _axisSettings[Axis::Z][ValueType::Center]);
-            Serial.println(" Done");
-            return true;
-        }  
-    }
-
     //Check that the settings are valid
     boolean checkSettings() {
         if(_axisSettings[Axis::X][ValueType::MinValue] == 0 && _axisSettings[Axis::X][ValueType::Center] == 0 && _axisSettings[Axis::X][ValueType::MaxValue] == 0){return false;}
@@ -284,6 +323,27 @@ class JoyStick {
         Serial.println("");
     }
 
+    //Copy the calibration and curves out to be saved
+    void getSettings(Settings &settings) {
+        for(int axis = Axis::X; axis <= Axis::Z; axis++) {
+            settings.axis[axis][0] = _axisSettings[axis][ValueType::MinValue];
+            settings.axis[axis][1] = _axisSettings[axis][ValueType::MaxValue];
+            settings.axis[axis][2] = _axisSettings[axis][ValueType::Center];
+            settings.curves[axis] = _curves[axis];
+        }
+    }
+
+    //Use saved calibration and curves. Compiles the curve tables
+    void setSettings(const Settings &settings) {
+        for(int axis = Axis::X; axis <= Axis::Z; axis++) {
+            _axisSettings[axis][ValueType::MinValue] = settings.axis[axis][0];
+            _axisSettings[axis][ValueType::MaxValue] = settings.axis[axis][1];
+            _axisSettings[axis][ValueType::Center] = settings.axis[axis][2];
+            setCurve((Axis)axis, (Curve)settings.curves[axis].type, settings.curves[axis].expo, settings.curves[axis].points);
+        }
+        compileCurves();
+    }
+
     //If one of a axis is not at 0 returns true
     boolean isActive() {
         if(getPercentage(Axis::X) != 0.0){return true;}
@@ -292,8 +352,8 @@ class JoyStick {
         return false;
     }
 
-    //Constructor with default settings to set if EEPROM values were not set
-    JoyStick(int xPin, int yPin, int zPin, bool invertX=false, bool invertY=false, bool invertZ=false, int memoryStartAddress=-1) {
+    //Constructor with default settings used until the saved settings are applied
+    JoyStick(int xPin, int yPin, int zPin, bool invertX=false, bool invertY=false, bool invertZ=false) {
         _axisSettings[Axis::X][ValueType::Pin] = xPin;
         _axisSettings[Axis::Y][ValueType::Pin] = yPin;
         _axisSettings[Axis::Z][ValueType::Pin] = zPin;
@@ -303,9 +363,8 @@ class JoyStick {
         pinMode(xPin, INPUT);
         pinMode(yPin, INPUT);
         pinMode(zPin, INPUT);
-        _memoryStartAddress = memoryStartAddress;
     }
-    JoyStick(int xPin, int yPin, int zPin, int16_t xDeadzone, int16_t yDeadzone, int16_t zDeadzone, bool invertX=false, bool invertY=false, bool invertZ=false, int memoryStartAddress=-1) {
+    JoyStick(int xPin, int yPin, int zPin, int16_t xDeadzone, int16_t yDeadzone, int16_t zDeadzone, bool invertX=false, bool invertY=false, bool invertZ=false) {
         _axisSettings[Axis::X][ValueType::Pin] = xPin;
         _axisSettings[Axis::Y][ValueType::Pin] = yPin;
         _axisSettings[Axis::Z][ValueType::Pin] = zPin;
@@ -315,7 +374,6 @@ class JoyStick {
         pinMode(xPin, INPUT);
         pinMode(yPin, INPUT);
         pinMode(zPin, INPUT);
-        _memoryStartAddress = memoryStartAddress;
         _axisDeadzones[Axis::X] = xDeadzone;
         _axisDeadzones[Axis::Y] = yDeadzone;
         _axisDeadzones[Axis::Z] = zDeadzone;
@@ -8,17 +8,199 @@
 
 #include <Wire.h>
 #include "MicroLCD/MicroLCD.h"
+#include "MicroLCD/LCDBus.h"
 
-#define LCD_WIDTH 64
-#define LCD_HEIGHT 32
+//Longest line of text including the terminator (a full row of the small font)
+#define LCD_LINE_LENGTH 23
+#define LCD_NO_HASH 0
+
+#ifdef LCD_FRAMEBUFFER
+//The framebuffer covers every page of the panel. Each page keeps the characters drawn on it rather than its pixels,
+//at most LCD_FRAMEBUFFER_CELLS small characters fit across
+#define LCD_FRAMEBUFFER_PAGES (SSD1306_LCDHEIGHT / 8)
+#define LCD_FRAMEBUFFER_COLUMNS SSD1306_LCDWIDTH
+#define LCD_FRAMEBUFFER_CELLS ((LCD_FRAMEBUFFER_COLUMNS + 5) / 6)
+#define LCD_CLEAN_PAGE 0xFF
+
+//Approximate I2C cost used to turn a flush budget into bytes. A byte takes ~23us at 400KHz and
+//every burst also sends an address transmission (address, control, 3 commands) and a data header (address, control)
+#define LCD_I2C_BYTE_MICROS 25
+#define LCD_I2C_BURST_OVERHEAD 7
+#define LCD_I2C_MAX_BURST 31
+
+//AsyncTwi queue bytes a page slice takes on top of its data: the address transmission (address, length, control,
+//3 commands) and the data transmission's address, length and control byte
+#define LCD_I2C_QUEUE_OVERHEAD 9
+
+//What is on the panel, kept as text. Only the columns that changed are sent to the lcd, rendered from the fonts as
+//they are sent
+class LCDFrameBuffer {
+    private:
+    //The text on one page. A medium line covers two pages, half says which of them this is
+    struct Page {
+        char text[LCD_FRAMEBUFFER_CELLS];
+        byte x;
+        byte font;
+        byte half;
+        byte extent;    //Columns at or past this are blank
+    };
+    Page _pages[LCD_FRAMEBUFFER_PAGES];
+    byte _dirtyStart[LCD_FRAMEBUFFER_PAGES];
+    byte _dirtyEnd[LCD_FRAMEBUFFER_PAGES];
+
+    //Get a column of a glyph in the same fonts LCD_SSD1306::write() uses. Columns past the glyph are the gap between characters
+    static byte glyphColumn(char c, byte font, byte half, byte column) {
+        if(c <= 0x20 || c >= 0x7f){return 0;}
+        if(font == FONT_SIZE_SMALL) {
+            return column < 5 ? pgm_read_byte(&font5x8[c - 0x21][column]) : 0;
+        }
+        return column < 8 ? pgm_read_byte(&font8x16_terminal[c - 0x21][column * 2 + half]) : 0;
+    }
+
+    //The byte shown in a column of a page
+    static byte columnByte(const Page &page, byte column) {
+        if(column < page.x || column >= page.extent){return 0;}
+        byte offset = column - page.x;
+        byte advance = fontAdvance(page.font);
+        return glyphColumn(page.text[offset / advance], page.font, page.half, offset % advance);
+    }
+
+    void markDirty(byte page, byte start, byte end) {
+        if(_dirtyStart[page] == LCD_CLEAN_PAGE || start < _dirtyStart[page]) {_dirtyStart[page] = start;}
+        if(_dirtyEnd[page] == LCD_CLEAN_PAGE || end > _dirtyEnd[page]) {_dirtyEnd[page] = end;}
+    }
+
+    //Render the next run of dirty columns of a page, at most length. Returns the number of columns filled
+    byte takeDirty(byte page, byte *data, byte length) {
+        byte start = _dirtyStart[page];
+        if(length > _dirtyEnd[page] - start + 1){length = _dirtyEnd[page] - start + 1;}
+        for(byte i = 0; i < length; i++) {data[i] = columnByte(_pages[page], start + i);}
+        if(start + length > _dirtyEnd[page]) {
+            _dirtyStart[page] = LCD_CLEAN_PAGE;
+            _dirtyEnd[page] = LCD_CLEAN_PAGE;
+        }
+        else {_dirtyStart[page] += length;}
+        return length;
+    }
+
+    public:
+    LCDFrameBuffer() {
+        clear();
+    }
+
+    //MicroLCD draws text in every font but the small one with its 8x16 font, large and extra large only change
+    //printed digits. Text here is drawn the same way so both modes show the same thing
+    static byte textFont(byte font) {return font == FONT_SIZE_SMALL ? FONT_SIZE_SMALL : FONT_SIZE_MEDIUM;}
+    static byte fontPages(byte font) {return textFont(font) == FONT_SIZE_SMALL ? 1 : 2;}
+    static byte fontAdvance(byte font) {return textFont(font) == FONT_SIZE_SMALL ? 6 : 9;}
+
+    //Blank the buffer. The caller is expected to clear the panel itself
+    void clear() {
+        memset(_pages, 0, sizeof(_pages));
+        memset(_dirtyStart, LCD_CLEAN_PAGE, sizeof(_dirtyStart));
+        memset(_dirtyEnd, LCD_CLEAN_PAGE, sizeof(_dirtyEnd));
+    }
+
+    //Replace the given pages with a line of text starting at column x. Text past the edge is clipped and stops at a new line.
+    //Pages past the font's height are blanked. Returns false and draws nothing if the pages run off the bottom of the panel
+    bool drawLine(byte page, byte pages, byte x, const char *text, byte font) {
+        if(page + pages > LCD_FRAMEBUFFER_PAGES || x >= LCD_FRAMEBUFFER_COLUMNS){return false;}
+        font = textFont(font);
+        byte length = 0;
+        while(length < LCD_FRAMEBUFFER_CELLS && text[length] != 0 && text[length] != '\n') {length++;}
+        unsigned int textEnd = x + length * fontAdvance(font);
+        if(textEnd > LCD_FRAMEBUFFER_COLUMNS){textEnd = LCD_FRAMEBUFFER_COLUMNS;}
+
+        for(byte p = 0; p < pages; p++) {
+            Page line;
+            memset(&line, 0, sizeof(line));
+            if(p < fontPages(font)) {
+                memcpy(line.text, text, length);
+                line.x = x;
+                line.font = font;
+                line.half = p;
+                line.extent = textEnd;
+            }
+
+            //Only the columns that come out different need sending, and only as far as the old or the new text reaches
+            Page &old = _pages[page + p];
+            byte end = max(old.extent, line.extent);
+            for(byte column = 0; column < end; column++) {
+                if(columnByte(old, column) != columnByte(line, column)){markDirty(page + p, column, column);}
+            }
+            old = line;
+        }
+        return true;
+    }
+
+    //Is there anything waiting to be sent?
+    bool isDirty() {
+        for(byte page = 0; page < LCD_FRAMEBUFFER_PAGES; page++) {
+            if(_dirtyStart[page] != LCD_CLEAN_PAGE){return true;}
+        }
+        return false;
+    }
+
+    //Send every change
+    void flush(LCD_SSD1306 &lcd) {
+        byte data[LCD_I2C_MAX_BURST];
+        for(byte page = 0; page < LCD_FRAMEBUFFER_PAGES; page++) {
+            while(_dirtyStart[page] != LCD_CLEAN_PAGE) {
+                byte start = _dirtyStart[page];
+                lcd.writePage(page, start, data, takeDirty(page, data, LCD_I2C_MAX_BURST));
+            }
+        }
+    }
+
+    //Send as much of the changes as fits in the time budget, continuing from where the last call stopped.
+    //At least one byte is sent so the flush makes progress, unless the AsyncTwi queue can't take it without waiting.
+    //Returns true while changes are still waiting
+    bool flush(LCD_SSD1306 &lcd, unsigned int budgetMicros) {
+        int bytesLeft = budgetMicros / LCD_I2C_BYTE_MICROS;
+#ifdef MICROLCD_ASYNC_TWI
+        //Both LCDs share the queue so what is free is read each call. Queueing past it would wait for the bus
+        int queueLeft = AsyncTwi.queueFree();
+#endif
+        bool first = true;
+        byte data[LCD_I2C_MAX_BURST];
+        for(byte page = 0; page < LCD_FRAMEBUFFER_PAGES; page++) {
+            while(_dirtyStart[page] != LCD_CLEAN_PAGE) {
+                int length = min(bytesLeft - LCD_I2C_BURST_OVERHEAD, LCD_I2C_MAX_BURST);
+                if(length < 1) {
+                    if(!first){return true;}
+                    length = 1;
+                }
+#ifdef MICROLCD_ASYNC_TWI
+                if(length > queueLeft - LCD_I2C_QUEUE_OVERHEAD){length = queueLeft - LCD_I2C_QUEUE_OVERHEAD;}
+                if(length < 1){return true;}
+#endif
+
+                byte start = _dirtyStart[page];
+                length = takeDirty(page, data, length);
+                lcd.writePage(page, start, data, length);
+                bytesLeft -= length + LCD_I2C_BURST_OVERHEAD;
+#ifdef MICROLCD_ASYNC_TWI
+                queueLeft -= length + LCD_I2C_QUEUE_OVERHEAD;
+#endif
+                first = false;
+            }
+        }
+        return false;
+    }
+};
+#endif
 
 class LCD {
     private:
     int _addr;
     LCD_SSD1306 _LCD;
-    String _lines[4] = {"**$$", "**$$", "**$$", "**$$"};
+#ifdef LCD_FRAMEBUFFER
+    LCDFrameBuffer _frameBuffer;
+#endif
+    char _lines[4][LCD_LINE_LENGTH] = {"", "", "", ""};
     int _fonts[4] = {FONT_SIZE_MEDIUM, FONT_SIZE_MEDIUM, FONT_SIZE_MEDIUM, FONT_SIZE_MEDIUM};
-    String _displayedLinesText[4] = {"", "", "", ""};
+    uint32_t _linesHash[4] = {LCD_NO_HASH, LCD_NO_HASH, LCD_NO_HASH, LCD_NO_HASH};
+    uint32_t _displayedLinesHash[4] = {LCD_NO_HASH, LCD_NO_HASH, LCD_NO_HASH, LCD_NO_HASH};
     int _displayedLinesFont[4] = {FONT_SIZE_MEDIUM, FONT_SIZE_MEDIUM, FONT_SIZE_MEDIUM, FONT_SIZE_MEDIUM};
     int _yPos = 0;
     int _currentLine = 0;
@@ -30,9 +212,10 @@ class LCD {
             case FONT_SIZE_LARGE: {return 2;}
             case FONT_SIZE_XLARGE: {return 2;}
         }
+        return 2;
     }
 
-    String getBlankingString(int font) {
+    const char *getBlankingString(int font) {
         switch(font) {
             case FONT_SIZE_SMALL: {return "                      ";}
             case FONT_SIZE_MEDIUM: {return "               ";}
@@ -41,6 +224,18 @@ class LCD {
         } 
     }
 
+    //FNV-1a hash of a line and its font, used to tell if a line needs redrawing without keeping a copy of the displayed text
+    static uint32_t hashLine(const char *text, int font) {
+        uint32_t hash = 2166136261UL;
+        hash = (hash ^ (byte)font) * 16777619UL;
+        while(*text != 0) {hash = (hash ^ (byte)*text++) * 16777619UL;}
+        return hash == LCD_NO_HASH ? 1 : hash;
+    }
+
+    bool lineChanged(int line) {
+        return _linesHash[line] != _displayedLinesHash[line];
+    }
+
     public:
     LCD(int address) {
         _addr = address;
@@ -64,16 +259,19 @@ class LCD {
     }
 
     void clear() {
-        _displayedLinesText[0] = "**$$";
-        _displayedLinesText[1] = "**$$";
-        _displayedLinesText[2] = "**$$";
-        _displayedLinesText[3] = "**$$";
+        _displayedLinesHash[0] = LCD_NO_HASH;
+        _displayedLinesHash[1] = LCD_NO_HASH;
+        _displayedLinesHash[2] = LCD_NO_HASH;
+        _displayedLinesHash[3] = LCD_NO_HASH;
         _displayedLinesFont[0] = 0;
         _displayedLinesFont[1] = 0;
         _displayedLinesFont[2] = 0;
         _displayedLinesFont[3] = 0;
         _currentLine = 0;
         _yPos = 0;
+#ifdef LCD_FRAMEBUFFER
+        _frameBuffer.clear();
+#endif
         _LCD.clear();
     }
 
@@ -86,8 +284,55 @@ class LCD {
         clear();
     }
 
+#ifdef LCD_BENCHMARK
+    //Print the I2C bytes and time taken to draw a line a character at a time and as a run
+    void benchmark() {
+        const char *text = "X: -12345 Y: 6789";
+        int fonts[2] = {FONT_SIZE_SMALL, FONT_SIZE_MEDIUM};
+        for(int i = 0; i < 2; i++) {
+            for(int run = 0; run < 2; run++) {
+                _LCD.clear();
+                _LCD.setFontSize(fonts[i]);
+#ifdef MICROLCD_ASYNC_TWI
+                AsyncTwi.flush();
+                uint32_t bytes = AsyncTwi.bytesSent();
+#endif
+                unsigned long start = micros();
+                _LCD.setCursor(0, 0);
+                if(run) {_LCD.print(text);}
+                else {for(const char *c = text; *c != 0; c++) {_LCD.write((uint8_t)*c);}}
+#ifdef MICROLCD_ASYNC_TWI
+                AsyncTwi.flush();
+#endif
+                unsigned long took = micros() - start;
+                Serial.print(i == 0 ? "LCD benchmark small " : "LCD benchmark medium ");
+                Serial.print(run ? "run: " : "per char: ");
+                Serial.print(took);
+                Serial.print("us");
+#ifdef MICROLCD_ASYNC_TWI
+                Serial.print(", ");
+                Serial.print(AsyncTwi.bytesSent() - bytes);
+                Serial.print(" bytes");
+#endif
+                Serial.println();
+            }
+        }
+        clear();
+    }
+#endif
+
     //Show the startup screen
     void showStartup(String version = "") {
+#ifdef LCD_FRAMEBUFFER
+        clear();
+        int split = version.indexOf('\n');
+        _frameBuffer.drawLine(0, 2, 0, "Booting", FONT_SIZE_LARGE);
+        _frameBuffer.drawLine(2, 2, 0, "Please Wait", FONT_SIZE_MEDIUM);
+        _frameBuffer.drawLine(4, 1, 0, version.c_str(), FONT_SIZE_SMALL);
+        if(split >= 0){_frameBuffer.drawLine(5, 1, 0, version.c_str() + split + 1, FONT_SIZE_SMALL);}
+        _frameBuffer.flush(_LCD);
+        return;
+#endif
         _LCD.clear();
         _LCD.setFontSize(FONT_SIZE_LARGE);
         _LCD.println("Booting");
@@ -97,28 +342,39 @@ class LCD {
         _LCD.println(version);
     }
 
+    //Set a line that will be shown on the next update(). Text longer than the line is cut off
+    void setLine(int line, const char *text, int fontSize) {
+        strncpy(_lines[line], text, LCD_LINE_LENGTH - 1);
+        _lines[line][LCD_LINE_LENGTH - 1] = 0;
+        _fonts[line] = fontSize;
+        _linesHash[line] = hashLine(_lines[line], fontSize);
+    }
+
+    //Set a line using printf style formatting straight into the line buffer
+    void setLineFormat(int line, int fontSize, const char *format, ...) {
+        va_list args;
+        va_start(args, format);
+        vsnprintf(_lines[line], LCD_LINE_LENGTH, format, args);
+        va_end(args);
+        _fonts[line] = fontSize;
+        _linesHash[line] = hashLine(_lines[line], fontSize);
+    }
+
     //Set the text that will be shown on the next update()
-    void setTextToShow(String line1="", String line2="", String line3="", String line4=""){
-        _lines[0] = line1;
-        _lines[1] = line2;
-        _lines[2] = line3;
-        _lines[3] = line4;
+    void setTextToShow(const String &line1="", const String &line2="", const String &line3="", const String &line4=""){
+        setTextToShow(line1, line2, line3, line4, _fonts[0], _fonts[1], _fonts[2], _fonts[3]);
     }
 
     //Set the text that will be shown on the next update()
-    void setTextToShow(String line1, String line2, String line3, String line4, int fontSize1, int fontSize2, int fontSize3, int fontSize4){
-        _lines[0] = line1;
-        _lines[1] = line2;
-        _lines[2] = line3;
-        _lines[3] = line4;
-        _fonts[0] = fontSize1;
-        _fonts[1] = fontSize2;
-        _fonts[2] = fontSize3;
-        _fonts[3] = fontSize4;
+    void setTextToShow(const String &line1, const String &line2, const String &line3, const String &line4, int fontSize1, int fontSize2, int fontSize3, int fontSize4){
+        setLine(0, line1.c_str(), fontSize1);
+        setLine(1, line2.c_str(), fontSize2);
+        setLine(2, line3.c_str(), fontSize3);
+        setLine(3, line4.c_str(), fontSize4);
     }
 
     //Show text
-    void showText(String line1="", String line2="", String line3="", String line4="") {
+    void showText(const String &line1="", const String &line2="", const String &line3="", const String &line4="") {
         clear();
         _currentLine = 0;
         _yPos = 0;
@@ -127,7 +383,7 @@ class LCD {
     }
 
     //Show text
-    void showText(String line1, String line2, String line3, String line4, int fontSize1, int fontSize2, int fontSize3, int fontSize4) {
+    void showText(const String &line1, const String &line2, const String &line3, const String &line4, int fontSize1, int fontSize2, int fontSize3, int fontSize4) {
         clear();
         _currentLine = 0;
         _yPos = 0;
@@ -136,7 +392,7 @@ class LCD {
     }
 
     //Show an error
-    void showError(String errorLine1="Unknown", String errorLine2="", String errorLine3="") {
+    void showError(const String &errorLine1="Unknown", const String &errorLine2="", const String &errorLine3="") {
         clear();
         _currentLine = 0;
         _yPos = 0;
@@ -144,16 +400,54 @@ class LCD {
         while(update());
     }
     
+#ifdef LCD_FRAMEBUFFER
+    //Render the current line into the framebuffer if it changed and move on to the next. Returns true if it was redrawn
+    bool renderLine() {
+        bool changed = lineChanged(_currentLine);
+        if(changed) {
+            //Redraw over the footprint of both the old and new font, only the changed columns are marked to send
+            byte pages = max(LCDFrameBuffer::fontPages(_displayedLinesFont[_currentLine]), LCDFrameBuffer::fontPages(_fonts[_currentLine]));
+            _displayedLinesFont[_currentLine] = _fonts[_currentLine];
+            _displayedLinesHash[_currentLine] = _linesHash[_currentLine];
+            _frameBuffer.drawLine(_yPos, pages, 10, _lines[_currentLine], _fonts[_currentLine]);
+        }
+
+        _yPos += getFontHeight(_fonts[_currentLine]);
+        _currentLine++;
+        if(_currentLine >= 4){_currentLine = 0; _yPos = 0;}
+        return changed;
+    }
+#endif
+
+    //Update the display in small slices so it can be called every loop, even while moving.
+    //Sends at most budgetMicros worth of I2C traffic and resumes on the next call. Returns true while changes are waiting
+    bool refresh(unsigned int budgetMicros) {
+#ifdef LCD_FRAMEBUFFER
+        //Only render new text once the previous changes are on the panel
+        for(int i = 0; i < 4 && !_frameBuffer.isDirty(); i++) {
+            renderLine();
+        }
+        return _frameBuffer.flush(_LCD, budgetMicros);
+#else
+        return update();
+#endif
+    }
+
     //Update the display
     bool update() {
-        if(_lines[_currentLine] != _displayedLinesText[_currentLine] || _fonts[_currentLine] != _displayedLinesFont[_currentLine]) {
+#ifdef LCD_FRAMEBUFFER
+        renderLine();
+        _frameBuffer.flush(_LCD);
+        return _currentLine != 0;
+#else
+        if(lineChanged(_currentLine)) {
             //Clear the line first
             _LCD.setFontSize(_displayedLinesFont[_currentLine]);
             _LCD.setCursor(0, _yPos);
             _LCD.print(getBlankingString(_displayedLinesFont[_currentLine]));
 
-            if(_fonts[_currentLine] != _displayedLinesFont[_currentLine]) { _displayedLinesFont[_currentLine] = _fonts[_currentLine];}
-            if(_lines[_currentLine] != _displayedLinesText[_currentLine]) { _displayedLinesText[_currentLine] = _lines[_currentLine];}
+            _displayedLinesFont[_currentLine] = _fonts[_currentLine];
+            _displayedLinesHash[_currentLine] = _linesHash[_currentLine];
             _LCD.setFontSize(_fonts[_currentLine]);
             _LCD.setCursor(10, _yPos);
             _LCD.println(_lines[_currentLine]);
@@ -163,6 +457,7 @@ class LCD {
         _currentLine++;
         if(_currentLine >= 4){_currentLine = 0; _yPos = 0;}
         return _currentLine != 0;
+#endif
     }
 };
 
@@ -14,34 +14,42 @@
 
 //#define IGNORE_CAL
 
-String errorMessages[2] = {"", ""};
+char errorMessages[2][ERROR_MESSAGE_LENGTH] = {"", ""};
 bool networkMovingSpeed = false;
 bool showDebugLcd = false;
+unsigned long lcdTextTimer = 0;
 
 //Send a command out to the serial
 bool waitingResponseFromLanc = false;
+bool lancResponding = false;
+unsigned long lancPingSent = 0;
+unsigned long lancRoundTrip = 0;
 void sendDataToSerial(CommandType type, int command, int value, int dataSize = 0, int *data = nullptr) {
   Serial1.write(type);
   Serial1.write(command);
   Serial1.write(value);
   Serial1.write(dataSize);
-  for(int i = 0; i < networkHandler.dataSize(); i++) {
+  for(int i = 0; i < dataSize; i++) {
     Serial1.write(data[i]);
   }
   Serial1.println();
 }
 
 
-void addErrorMessage(String error) {
+void addErrorMessage(const char *error) {
   for(int i = 0; i < 2; i++) {
-    if(errorMessages[i] == error){break;}
-    else if(errorMessages[i] == "") {errorMessages[i] = error; break;}
+    if(strncmp(errorMessages[i], error, ERROR_MESSAGE_LENGTH - 1) == 0){break;}
+    else if(errorMessages[i][0] == 0) {
+      strncpy(errorMessages[i], error, ERROR_MESSAGE_LENGTH - 1);
+      errorMessages[i][ERROR_MESSAGE_LENGTH - 1] = 0;
+      break;
+    }
   }
 }
 
-void removeErrorMessage(String error) {
+void removeErrorMessage(const char *error) {
   for(int i = 0; i < 2; i++) {
-    if(errorMessages[i] == error){errorMessages[i] = ""; break;}
+    if(strncmp(errorMessages[i], error, ERROR_MESSAGE_LENGTH - 1) == 0){errorMessages[i][0] = 0; break;}
   }
 }
 
@@ -57,11 +65,13 @@ void blinkDebugLed() {
     if(digitalRead(DEBUG_LED)) {
       if(!waitingResponseFromLanc) {
         waitingResponseFromLanc = true;
+        lancPingSent = millis();
         sendDataToSerial(CommandType::Control, ControlCommand::Ping, 0, 0);
         removeErrorMessage("Lanc Error");
       }
       else {
         //Cannot communicate
+        lancResponding = false;
         Serial.println("Lanc did not respond");
         addErrorMessage("Lanc Error");
       }
@@ -96,35 +106,77 @@ void showDebugLCD() {
     rightLCD.update();
 }
 
-//Reset the memory pool to defaults
-void resetMemory() {
-  for(int i = 0; i < END_OF_MEMORY; i++) {
-    EEPROM.write(i, 255);
+//Read the settings record and hand the settings to the objects that use them
+void loadSettings() {
+  switch(settingsStore.load()) {
+    case SettingsStore::LoadResult::Loaded: {Serial.println(" Valid"); break;}
+    case SettingsStore::LoadResult::Migrated: {Serial.println(" Upgraded from older firmware"); break;}
+    case SettingsStore::LoadResult::Defaults: {
+      Serial.println(" Not set. Using defaults");
+      rightLCD.showError("No settings", "Calibration", "required");
+      leftLCD.showError("No settings", "Calibration", "required");
+      break;
+    }
   }
+  rightJoyStick.setSettings(settingsStore.settings().rightJoyStick);
+  controlPanel.setSettings(settingsStore.settings().controlPanel);
+  networkHandler.setSettings(settingsStore.settings().network);
+}
 
-  //Write the lead and end of memory for check
-  EEPROM.write(0, MEMORY_LEAD_0);
-  EEPROM.write(1, MEMORY_LEAD_1);
-  EEPROM.write(2, MEMORY_LEAD_2);
-  EEPROM.write(3, MEMORY_LEAD_3);
-  EEPROM.write(END_OF_MEMORY, MEMORY_END_0);
-  EEPROM.write(END_OF_MEMORY + 1, MEMORY_END_1);
+//Collect the settings from the objects and save them, only changed bytes are written
+void saveSettings() {
+  rightJoyStick.getSettings(settingsStore.settings().rightJoyStick);
+  controlPanel.getSettings(settingsStore.settings().controlPanel);
+  networkHandler.getSettings(settingsStore.settings().network);
+  settingsStore.save();
 }
 
-//Print the memory to the serial monitor for debug
-void printMemory() {
-  for(int i = 0; i < END_OF_MEMORY + 2; i++) {
-    Serial.print(EEPROM.read(i));
-    if((i % 10 == 0 && i != 0) || i == END_OF_MEMORY - 1){Serial.println("");}else{Serial.print(",");}
+//Keep the packet replay counters over a reboot. Our send counter is saved ahead of use so a reboot never reuses one,
+//the counters from other senders can only be saved after they are seen so up to NETWORK_COUNTER_SAVE_EVERY could be replayed
+struct ReplayCounters {
+  uint32_t txReserved;
+  NetworkHandler::ReceiveCounter rx[NETWORK_SENDERS];
+};
+ReplayCounters savedCounters = {};
+bool saveNetworkCounters() {
+  ReplayCounters counters;
+  counters.txReserved = networkHandler.txCounter() + NETWORK_COUNTER_SAVE_EVERY;
+  networkHandler.getCounters(counters.rx);
+  if(!journal.write(JournalKey::NetworkCounters, &counters, sizeof(counters))){return false;}
+  savedCounters = counters;
+  return true;
+}
+
+void loadNetworkCounters() {
+  byte length;
+  while((length = journal.read(JournalKey::NetworkCounters, &savedCounters, sizeof(savedCounters))) == JOURNAL_BUSY) {}
+  //Before counters were kept per sender the record was {rx, txReserved}, the rx can't be given to a sender
+  if(length == 2 * sizeof(uint32_t)) {
+    uint32_t old[2];
+    memcpy(old, &savedCounters, sizeof(old));
+    savedCounters = {};
+    savedCounters.txReserved = old[1];
+  }
+  networkHandler.setCounters(savedCounters.rx, savedCounters.txReserved);
+  saveNetworkCounters();
+}
+
+//Called every loop and before a send of our own. A new reservation is saved while half of the last is still left
+//so the packets sent in one loop never run past it
+void processNetworkCounters() {
+  if(networkHandler.receivedSinceSave() >= NETWORK_COUNTER_SAVE_EVERY || networkHandler.txCounter() + NETWORK_COUNTER_SAVE_EVERY / 2 >= savedCounters.txReserved) {
+    saveNetworkCounters();
   }
 }
 
 void(* resetFunc) (void) = 0; 
+void configureButtons();
 
 //Begin setup
 void setup() {
+    ramMonitor.paint();
     Serial.begin(115200);
-    Serial1.begin(9600);
+    Serial1.begin(LANC_LINK_BAUD);
     Serial.println("Kardinia Jib Controller 2019");
     Serial.println(String("Version:") + SOFTWARE_VERSION_MAJOR + String(".") + SOFTWARE_VERSION_MINOR);
     Serial.println(String("Last Compile Date: ") + __DATE__);
@@ -133,6 +185,18 @@ void setup() {
     Serial.println("");
     leftLCD.initalize();
     rightLCD.initalize();
+    analogInputs.begin(analogPins, sizeof(analogPins));
+    controlPanel.begin();
+    configureButtons();
+#ifdef LCD_BENCHMARK
+    leftLCD.benchmark();
+#endif
+#ifdef AUTH_BENCHMARK
+    networkHandler.benchmark();
+#endif
+#ifdef OSC_BENCHMARK
+    osc.benchmark();
+#endif
     leftLCD.showStartup(String("Version: ") + SOFTWARE_VERSION_MAJOR + String(".") + SOFTWARE_VERSION_MINOR + String("\n(") + __DATE__ + String(")"));
     rightLCD.showText("Press for:", "", "", "< Cal , Test >", FONT_SIZE_MEDIUM, FONT_SIZE_SMALL, FONT_SIZE_SMALL, FONT_SIZE_SMALL);
     long timeout = millis();
@@ -152,38 +216,21 @@ void setup() {
         break;
       }
     }
-    // if(calibrate){resetMemory ();}
+    // if(calibrate){settingsStore.reset();}
     rightLCD.clear();
 
     pinMode(DEBUG_LED, OUTPUT);
     digitalWrite(13, HIGH);
 
-    //Check if the EEPROM has a valid start of memory if not clear it
-    Serial.print("Check memory... ");
-    if(EEPROM.readByte(0) != MEMORY_LEAD_0 || EEPROM.readByte(1) != MEMORY_LEAD_1 || EEPROM.readByte(2) != MEMORY_LEAD_2 || EEPROM.readByte(3) != MEMORY_LEAD_3 ||
-        EEPROM.readByte(END_OF_MEMORY) != MEMORY_END_0 || EEPROM.readByte(END_OF_MEMORY + 1) != MEMORY_END_1) {
-          //Memory is not valid we need to reset it
-          Serial.println(" Not Valid.");
-          rightLCD.showError("Invalid memory", "Please reset", "and cal");
-          leftLCD.showError("Invalid memory", "Please reset", "and cal");
-          resetMemory();    
-     }
-     else {Serial.println(" Valid");}
-
-    //Read the parameters in memory and set them
-    Serial.println("Read settings from memory");
-
-    if(!rightJoyStick.readSettingsFromMemory() || !controlPanel.readSettingsFromMemory()) {
-      Serial.println("Critical error: failed to read memory from one or more objects");
-      Serial.println("Process cannot continue.\n\nEEPROM has been reset please disconnect power and recalibate the system");
-      resetMemory();
-      leftLCD.showError("Invalid MEM", "Please reset and", "recalibate");
-      while(true){
-        digitalWrite(DEBUG_LED, HIGH);
-        delay(100);
-        digitalWrite(DEBUG_LED, LOW);
-        delay(100);
-      }
+    //Read the settings record, upgrading it if it came from older firmware
+    Serial.print("Read settings from memory... ");
+    loadSettings();
+    journal.begin();
+    presets.begin();
+    loadNetworkCounters();
+    int32_t lastPosition[2];
+    if(journal.read(JournalKey::HeadPosition, lastPosition, sizeof(lastPosition)) == sizeof(lastPosition)) {
+      Serial.print("Last head position X: "); Serial.print(lastPosition[0]); Serial.print(" Y: "); Serial.println(lastPosition[1]);
     }
 
     #ifndef IGNORE_CAL
@@ -205,6 +252,7 @@ void setup() {
       if(!rightJoyStick.checkSettings() || calibrate) {
         Serial.println("\nThe right joystick has invalid settings and will need to be recalibrated. Starting calibration utility...");
         rightJoyStick.calibrate(leftLCD, rightLCD);
+        saveSettings();
       }
     }
 
@@ -225,6 +273,7 @@ void setup() {
       if(!controlPanel.checkSettings() || calibrate) {
         Serial.println("\nControl panel has invalid settings and will need to be recalibrated. Starting calibration utility...");
         controlPanel.calibrate(leftLCD, rightLCD);
+        saveSettings();
       }
     }
     #endif
@@ -232,7 +281,13 @@ void setup() {
     rightLCD.clear();
     rightLCD.showText("Network", "Connecting", "", "", FONT_SIZE_MEDIUM, FONT_SIZE_SMALL, FONT_SIZE_SMALL, FONT_SIZE_SMALL);
     Serial.print("Attempting connection to network...");
+    networkHandler.setMulticast(multicastIP);
     if(networkHandler.begin()) {
+      if(networkHandler.multicastFailed()) {
+        Serial.print(" No socket for multicast.");
+        addErrorMessage("Multicast failed");
+      }
+      processNetworkCounters();
       if(networkHandler.serverConnected()) {
         rightLCD.clear();
         rightLCD.showText("Network", "Connected!", networkHandler.localIPString(), "Port:" + (String)networkHandler.incomingPort() + "," + (String)networkHandler.outgoingPort(), FONT_SIZE_MEDIUM, FONT_SIZE_SMALL, FONT_SIZE_SMALL, FONT_SIZE_SMALL);
@@ -250,6 +305,18 @@ void setup() {
         Serial.println((String)networkHandler.incomingPort() + "," + (String)networkHandler.outgoingPort());
         addErrorMessage("Server error");
       }
+#ifdef VISCA
+      if(visca.begin()) {Serial.print("VISCA on port "); Serial.println(visca.port());}
+      else {Serial.println("VISCA failed, no socket free"); addErrorMessage("VISCA failed");}
+#endif
+#ifdef OSC
+      if(osc.begin()) {Serial.print("OSC on port "); Serial.println(osc.port());}
+      else {Serial.println("OSC failed, no socket free"); addErrorMessage("OSC failed");}
+#endif
+#ifdef DMX
+      if(dmx.begin()) {Serial.print("DMX universe "); Serial.print(DMX_UNIVERSE); Serial.print(" from address "); Serial.println(DMX_START_ADDRESS);}
+      else {Serial.println("DMX failed, no socket free"); addErrorMessage("DMX failed");}
+#endif
     }
     else {
       rightLCD.showText("Network", "Failed.", "Check connection.", "", FONT_SIZE_MEDIUM, FONT_SIZE_SMALL, FONT_SIZE_SMALL, FONT_SIZE_SMALL);
@@ -264,6 +331,7 @@ void setup() {
     }
 
     Serial.println("Setup Complete");
+    controlPanel.clearEvents();
 
     leftLCD.clear();
     rightLCD.clear();
@@ -273,6 +341,7 @@ void setup() {
 void sendZoom(int speed) {
   if(speed < -8){speed = -8;}
   if(speed > 8){speed = 8;}
+  zoomTracker.setSpeed(speed);
   sendDataToSerial(CommandType::Lanc, LancCommand::Zoom, speed);
 }
 
@@ -290,8 +359,18 @@ void sendAutoFocus() {
 
 int prevZoom = 0;
 unsigned long zoomTimeout = 0;
+long presetZoomTarget = -1;
+
+//A move loaded ahead of a GO. The joystick is locked out while armed so the prepared speeds are not changed
+bool armed = false;
+bool armedRecording = false;
+long armedX = 0;
+long armedY = 0;
+long armedZoom = -1;
+bool goPending = false;
+uint32_t goAt = 0;
 void processJoyStick() {
-  if(networkMovingSpeed == true){return;}
+  if(networkMovingSpeed == true || recorder.playing() || armed){return;}
   float acceleration = 100.0;
   float globalSpeed = controlPanel.getPotPercentage(ControlPanel::Pot::Right);
   float xSpeed = (rightJoyStick.getPercentage(JoyStick::Axis::X) / 100.0) * (globalSpeed / 100.0);
@@ -302,6 +381,7 @@ void processJoyStick() {
   head.moveXY(xSpeed * 100, ySpeed * 100, 100.0);
   if(zoom != prevZoom) {
     prevZoom = zoom;
+    presetZoomTarget = -1;
     sendZoom(zoom);
     //zoomTimeout = millis() + 500;
   }
@@ -330,84 +410,338 @@ int32_t getInt32(int *buffer, int index) {
   return conv.integer;
 }
 
-//Check the buttons for speicific moves
-void checkButtons() {
-    if(controlPanel.isButtonsPressed().buttonStates[0][0]) {
-      //Centre head
-      head.goHome(100.0, 500.0);
-    }
-    if(controlPanel.isButtonsPressed().buttonStates[0][1]) {
-      //Reboot
-      leftLCD.clear();
-      leftLCD.showText("To reboot", "Keep holding", "", "", FONT_SIZE_MEDIUM, FONT_SIZE_SMALL, FONT_SIZE_SMALL, FONT_SIZE_SMALL);
-      rightLCD.clear();
-      rightLCD.showText("Info", String("Ver:") + SOFTWARE_VERSION_MAJOR + String(".") + SOFTWARE_VERSION_MINOR, String("Date: ") + __DATE__, String("IP: ") + networkHandler.localIPString() + ":" + networkHandler.incomingPort() + "," + networkHandler.outgoingPort(), FONT_SIZE_MEDIUM, FONT_SIZE_SMALL, FONT_SIZE_SMALL, FONT_SIZE_SMALL);
-      delay(5000);
-      if(controlPanel.isButtonsPressed().buttonStates[0][1]) {
-        resetFunc();
-      }
+void putInt32(int *buffer, int index, int32_t value) {
+  for(int i = 0; i < 4; i++) {buffer[index + i] = (value >> (i * 8)) & 0xFF;}
+}
 
-      leftLCD.clear();
-      rightLCD.clear();
-    }
-    if(controlPanel.isButtonsPressed().buttonStates[2][0]) {
-      head.moveRelative(1000000, 0, controlPanel.getPotPercentage(ControlPanel::Pot::Right), 20000.0);
-    }
-    if(controlPanel.isButtonsPressed().buttonStates[1][0]) {
-      head.moveRelative(-1000000, 0, controlPanel.getPotPercentage(ControlPanel::Pot::Right), 20000.0);
-    }
-    if(controlPanel.isButtonsPressed().buttonStates[1][1]) {
-      head.moveRelative(0, 10000000, controlPanel.getPotPercentage(ControlPanel::Pot::Right), 20000.0);
-    }
-    if(controlPanel.isButtonsPressed().buttonStates[2][1]) {
-      head.moveRelative(0, -1000000, controlPanel.getPotPercentage(ControlPanel::Pot::Right), 20000.0);
+//Ask the show controller for its time every so often, the replies are handled in processNetwork(). See clockSync.h
+unsigned long clockSyncTimer = 0;
+void processClockSync() {
+  if(millis() - clockSyncTimer < CLOCK_SYNC_INTERVAL){return;}
+  clockSyncTimer = millis();
+  if(clockSync.synced() && clockSync.stale(CLOCK_SYNC_TIMEOUT)) {
+    Serial.println("Clock sync lost");
+    clockSync.reset();
+  }
+  int data[4];
+  putInt32(data, 0, clockSync.request());
+  networkHandler.sendCommand(CommandType::Control, ControlCommand::TimeSync, 0, 4, data);
+}
+
+//Go to a stored preset. Pan and tilt arrive together while the zoom is driven to its estimated position
+bool recallPreset(byte number) {
+  Presets::Preset preset;
+  if(!presets.get(number, preset)) {
+    Serial.print("Preset "); Serial.print(number + 1); Serial.println(" is not stored");
+    return false;
+  }
+  Serial.print("Recalling preset "); Serial.print(number + 1); Serial.print(" X: "); Serial.print(preset.x); Serial.print(" Y: "); Serial.print(preset.y); Serial.print(" Zoom: "); Serial.println(preset.zoom);
+  networkMovingSpeed = false;
+  head.moveToXYTogether(preset.x, preset.y, preset.speed, preset.acceleration);
+  presetZoomTarget = preset.zoom;
+  return true;
+}
+
+//Store the current shot as a preset, recalled at the given speed and acceleration (%)
+bool storePreset(byte number, float speed, float acceleration) {
+  Presets::Preset preset;
+  preset.x = head.currentPosition(Head::StepperAxis::X);
+  preset.y = head.currentPosition(Head::StepperAxis::Y);
+  preset.zoom = zoomTracker.position();
+  preset.speed = constrain(speed, 1, 100);
+  preset.acceleration = constrain(acceleration, 1, 100);
+  bool stored = presets.set(number, preset);
+  Serial.print("Preset "); Serial.print(number + 1); Serial.println(stored ? " stored" : " could not be stored");
+  return stored;
+}
+
+//Drive the zoom toward the recalled preset until the estimate gets there
+void processPresetZoom() {
+  if(presetZoomTarget < 0){return;}
+  long error = presetZoomTarget - zoomTracker.position();
+  if(abs(error) <= PRESET_ZOOM_TOLERANCE) {
+    sendZoom(0);
+    presetZoomTarget = -1;
+    return;
+  }
+  int speed = error > 0 ? PRESET_ZOOM_SPEED : -PRESET_ZOOM_SPEED;
+  if(zoomTracker.speed() != speed){sendZoom(speed);}
+}
+
+//Recorded moves. Recording samples the head every tick, playing moves to the start then drives the head along the samples
+unsigned long recorderTick = 0;
+bool recorderSending = false;
+uint16_t recorderSendOffset = 0;
+IPAddress recorderSendTo;
+
+void startRecording() {
+  if(recorder.playing()){return;}
+  recorder.startRecording(head.currentPosition(Head::StepperAxis::X), head.currentPosition(Head::StepperAxis::Y), zoomTracker.position());
+  recorderTick = millis();
+  Serial.println("Recording");
+}
+
+void playRecording() {
+  if(!recorder.startPositioning()) {
+    Serial.println("Nothing recorded to play");
+    return;
+  }
+  Serial.println("Moving to the start of the recording");
+  networkMovingSpeed = false;
+  head.moveToXYTogether(recorder.startX(), recorder.startY());
+  presetZoomTarget = recorder.startZoom();
+}
+
+void stopRecorder() {
+  if(recorder.state() == Recorder::State::Recording) {
+    Serial.print("Recorded "); Serial.print(recorder.length()); Serial.println(" bytes");
+  }
+  else if(recorder.playing()) {
+    Serial.println("Playback stopped");
+    head.moveXY(0, 0);
+    presetZoomTarget = -1;
+    if(zoomTracker.speed() != 0){sendZoom(0);}
+  }
+  recorder.stop();
+}
+
+//Send the next part of the recording to whoever asked for it. Only while still so the packets don't hold up the steppers
+void sendRecordingChunk() {
+  if(!recorderSending || head.isMoving()){return;}
+  if(recorderSendOffset < recorder.length()) {
+    int chunk[2 + RECORDER_CHUNK_SIZE];
+    byte count = min(RECORDER_CHUNK_SIZE, recorder.length() - recorderSendOffset);
+    chunk[0] = recorderSendOffset >> 8;
+    chunk[1] = recorderSendOffset & 0xFF;
+    for(byte i = 0; i < count; i++) {chunk[2 + i] = recorder.data()[recorderSendOffset + i];}
+    networkHandler.sendCommand(recorderSendTo, CommandType::Control, ControlCommand::Recording, RecordingAction::RecordingChunk, 2 + count, chunk);
+    recorderSendOffset += count;
+  }
+  else {
+    uint16_t crc = recorder.crc();
+    int end[4] = {recorder.length() >> 8, recorder.length() & 0xFF, crc >> 8, crc & 0xFF};
+    networkHandler.sendCommand(recorderSendTo, CommandType::Control, ControlCommand::Recording, RecordingAction::RecordingEnd, 4, end);
+    recorderSending = false;
+  }
+}
+
+void processRecorder() {
+  switch(recorder.state()) {
+    case Recorder::State::Recording: {
+      if(millis() - recorderTick < RECORDER_TICK){break;}
+      recorderTick += RECORDER_TICK;
+      if(!recorder.addSample(head.currentPosition(Head::StepperAxis::X), head.currentPosition(Head::StepperAxis::Y), zoomTracker.speed())) {
+        Serial.println("Recording full");
+        stopRecorder();
+      }
+      break;
     }
-    if(controlPanel.isButtonsPressed().buttonStates[1][2]) {
-      //Move both tilt and pan
-      head.moveRelative(10000000, 10000000, controlPanel.getPotPercentage(ControlPanel::Pot::Right), 20000.0);
+    case Recorder::State::Positioning: {
+      //Start as soon as the head and zoom are at the start (and a GO has come if it is armed), the first sample goes straight away
+      if(!head.isMoving() && presetZoomTarget < 0 && !armedRecording) {
+        recorder.startPlaying();
+        recorderTick = millis() - recorder.tick();
+        Serial.println("Playing recording");
+      }
+      break;
     }
-    if(controlPanel.isButtonsPressed().buttonStates[2][2]) {
-      //Move both tilt and pan
-      head.moveRelative(-1000000, -1000000, controlPanel.getPotPercentage(ControlPanel::Pot::Right), 20000.0);
+    case Recorder::State::Playing: {
+      if(millis() - recorderTick < recorder.tick()){break;}
+      recorderTick += recorder.tick();
+      int32_t x, y;
+      int8_t zoom;
+      if(!recorder.nextSample(x, y, zoom)) {
+        Serial.println("Playback finished");
+        head.moveXY(0, 0);
+        if(zoomTracker.speed() != 0){sendZoom(0);}
+        break;
+      }
+      //Aim to be at the sample by the next tick. Working from where the head actually is takes out any error from the last one
+      float speedX = ((x - head.currentPosition(Head::StepperAxis::X)) * 100000.0) / ((float)recorder.tick() * head.maxSpeed(Head::StepperAxis::X));
+      float speedY = ((y - head.currentPosition(Head::StepperAxis::Y)) * 100000.0) / ((float)recorder.tick() * head.maxSpeed(Head::StepperAxis::Y));
+      head.moveXY(constrain(speedX, -100.0, 100.0), constrain(speedY, -100.0, 100.0));
+      if(zoom != zoomTracker.speed()){sendZoom(zoom);}
+      break;
     }
+    default: {break;}
+  }
+  sendRecordingChunk();
+}
 
-    // 0 0   0 1
-    // 0 0   0 0
-    // 0 0   0 0
-    // Focus In
-    if(controlPanel.isButtonsPressed().buttonStates[3][0]) {
-      sendFocus(0);
-      delay(200);
-    }
+//Load a move to start on the next GO. The speeds and accelerations are worked out and set now so GO only sets the targets
+bool armMove(long x, long y, float speed, float acceleration, long zoom = -1) {
+  if(head.isMoving() || recorder.playing()) {
+    Serial.println("Can't arm a move while moving");
+    return false;
+  }
+  networkMovingSpeed = false;
+  head.prepareXYTogether(x, y, speed, acceleration);
+  armedX = x;
+  armedY = y;
+  armedZoom = zoom;
+  armedRecording = false;
+  armed = true;
+  goPending = false;
+  Serial.print("Armed move to X: "); Serial.print(x); Serial.print(" Y: "); Serial.println(y);
+  return true;
+}
 
-    // 0 0   0 0
-    // 0 0   0 1
-    // 0 0   0 0
-    // Focus Out
-    if(controlPanel.isButtonsPressed().buttonStates[3][1]) {
-      sendFocus(1);
-      delay(200);
-    }
+//Arm the recording. The head goes to the start of it now and playing waits for the GO
+bool armRecording() {
+  if(head.isMoving() || recorder.playing()) {
+    Serial.println("Can't arm a move while moving");
+    return false;
+  }
+  armedRecording = true;
+  playRecording();
+  if(!recorder.playing()) {
+    armedRecording = false;
+    return false;
+  }
+  armed = true;
+  goPending = false;
+  Serial.println("Armed recording");
+  return true;
+}
 
-    // 0 0   0 0
-    // 0 0   0 0
-    // 0 0   0 1
-    // Focus Auto
-    if(controlPanel.isButtonsPressed().buttonStates[3][2]) {
-      sendAutoFocus();
-      delay(200);
-    }
+void disarm() {
+  if(!armed){return;}
+  if(armedRecording){stopRecorder();}
+  armed = false;
+  armedRecording = false;
+  goPending = false;
+  Serial.println("Disarmed");
+}
+
+//Start the armed move
+void go() {
+  goPending = false;
+  if(!armed){return;}
+  armed = false;
+  if(armedRecording) {
+    armedRecording = false;
+    if(recorder.state() != Recorder::State::Positioning || head.isMoving()){Serial.println("GO before the recording was at its start, it will play once there");}
+    processRecorder();
+    return;
+  }
+  head.startXY(armedX, armedY);
+  if(armedZoom >= 0){presetZoomTarget = armedZoom;}
+}
+
+//Start the armed move once the server clock reaches the time of a timed GO. Called every loop,
+//the last GO_SPIN_WINDOW is spent waiting here so the start isn't a loop late. The head keeps stepping while it waits
+void processGo() {
+  if(!goPending){return;}
+  if((int32_t)(goAt - micros()) > GO_SPIN_WINDOW){return;}
+  while((int32_t)(goAt - micros()) > 0) {head.run();}
+  go();
+}
+
+//Button actions. Moves start on the press and carry on until the stop button or a limit, as before
+void centreHead() {head.goHome(100.0, 500.0);}
+void panForward() {head.moveRelative(1000000, 0, controlPanel.getPotPercentage(ControlPanel::Pot::Right), 20000.0);}
+void panBackward() {head.moveRelative(-1000000, 0, controlPanel.getPotPercentage(ControlPanel::Pot::Right), 20000.0);}
+void tiltForward() {head.moveRelative(0, 10000000, controlPanel.getPotPercentage(ControlPanel::Pot::Right), 20000.0);}
+void tiltBackward() {head.moveRelative(0, -1000000, controlPanel.getPotPercentage(ControlPanel::Pot::Right), 20000.0);}
+void panTiltForward() {head.moveRelative(10000000, 10000000, controlPanel.getPotPercentage(ControlPanel::Pot::Right), 20000.0);}
+void panTiltBackward() {head.moveRelative(-1000000, -1000000, controlPanel.getPotPercentage(ControlPanel::Pot::Right), 20000.0);}
+void focusIn() {sendFocus(0);}
+
+//Step every axis of the joystick on to the next response curve and keep it
+void nextJoystickCurve() {
+  JoyStick::Curve curve = (JoyStick::Curve)((rightJoyStick.getCurve(JoyStick::Axis::X) + 1) % JoyStick::Curve::TotalCurves);
+  for(int i = JoyStick::Axis::X; i <= JoyStick::Axis::Z; i++) {
+    rightJoyStick.setCurve((JoyStick::Axis)i, curve, DEFAULT_EXPO);
+  }
+  rightJoyStick.compileCurves();
+  saveSettings();
+}
+void focusOut() {sendFocus(1);}
+
+//Holding the info button shows the info screens, keep holding to reboot
+bool showingInfo = false;
+void showInfo() {
+  showingInfo = true;
+  leftLCD.clear();
+  leftLCD.showText("To reboot", "Keep holding", "", "", FONT_SIZE_MEDIUM, FONT_SIZE_SMALL, FONT_SIZE_SMALL, FONT_SIZE_SMALL);
+  rightLCD.clear();
+  rightLCD.showText("Info", String("Ver:") + SOFTWARE_VERSION_MAJOR + String(".") + SOFTWARE_VERSION_MINOR, String("Date: ") + __DATE__, String("IP: ") + networkHandler.localIPString() + ":" + networkHandler.incomingPort() + "," + networkHandler.outgoingPort(), FONT_SIZE_MEDIUM, FONT_SIZE_SMALL, FONT_SIZE_SMALL, FONT_SIZE_SMALL);
+}
+void hideInfo() {
+  showingInfo = false;
+  leftLCD.clear();
+  rightLCD.clear();
+}
+void reboot() {resetFunc();}
+
+//The stop button does nothing while the head is still so it pages through the dashboard
+void nextDashboardPage() {
+  dashboard.nextPage();
+  lcdTextTimer = millis() - LCD_TEXT_INTERVAL;
+}
+
+//Holding the stop button puts the pan/tilt buttons over to presets, see processPresetButton()
+bool presetMode = false;
+void enterPresetMode() {
+  presetMode = true;
+  dashboard.setPage(Dashboard::Page::Main);
+  lcdTextTimer = millis() - LCD_TEXT_INTERVAL;
+  Serial.println("Preset mode");
+}
+
+//What each button does. Indexed by button id (row * TOTAL_COLS + col, then the stop button)
+//   [0][0] [0][1] [0][2]
+//   [1][0] [1][1] [1][2]
+//   [2][0] [2][1] [2][2]
+//   [3][0] [3][1] [3][2]
+struct ButtonAction {
+  void (*pressed)();
+  void (*released)();
+  void (*longPressed)();
+  void (*repeated)();
+  unsigned int longPressTime;   //ms
+  unsigned int repeatInterval;  //ms, 0 to not repeat
+  bool whileMoving;             //Act on the button while the head is moving
+  bool moves;                   //Drives the head, so it is ignored while a move is armed
+};
+const ButtonAction buttonActions[TOTAL_BUTTONS] = {
+  {centreHead, nullptr, nullptr, nullptr, BUTTON_LONG_PRESS, 0, false, true},
+  {showInfo, hideInfo, reboot, nullptr, 5000, 0, false, false},
+  {nextJoystickCurve, nullptr, nullptr, nullptr, BUTTON_LONG_PRESS, 0, false, false},
+  {panBackward, nullptr, nullptr, nullptr, BUTTON_LONG_PRESS, 0, false, true},
+  {tiltForward, nullptr, nullptr, nullptr, BUTTON_LONG_PRESS, 0, false, true},
+  {panTiltForward, nullptr, nullptr, nullptr, BUTTON_LONG_PRESS, 0, false, true},
+  {panForward, nullptr, nullptr, nullptr, BUTTON_LONG_PRESS, 0, false, true},
+  {tiltBackward, nullptr, nullptr, nullptr, BUTTON_LONG_PRESS, 0, false, true},
+  {panTiltBackward, nullptr, nullptr, nullptr, BUTTON_LONG_PRESS, 0, false, true},
+  {focusIn, nullptr, nullptr, focusIn, BUTTON_LONG_PRESS, FOCUS_REPEAT_INTERVAL, true, false},
+  {focusOut, nullptr, nullptr, focusOut, BUTTON_LONG_PRESS, FOCUS_REPEAT_INTERVAL, true, false},
+  {sendAutoFocus, nullptr, nullptr, nullptr, BUTTON_LONG_PRESS, 0, true, false},
+  {nextDashboardPage, nullptr, enterPresetMode, nullptr, BUTTON_LONG_PRESS, 0, false, false}
+};
+
+//Give the scanner the hold times from the action table
+void configureButtons() {
+  for(byte i = 0; i < TOTAL_BUTTONS; i++) {
+    controlPanel.configureButton(i, buttonActions[i].longPressTime, buttonActions[i].repeatInterval);
+  }
 }
 
 //Process the network
+//What happened to the command being run, sent back as the ACK/NACK when it was sent reliably
+CommandResult commandResult = CommandResult::CommandOk;
 void processNetwork() {
   //Process the incoming network command if there is one
     if(networkHandler.process()) {
+      commandResult = CommandResult::CommandOk;
+      //Moves are refused while a move is armed or a recording is playing, like VISCA and OSC. Stop disarms
+      bool canMove = !armed && !recorder.playing();
       switch(networkHandler.type()) {
         case CommandType::Movement: {
           switch(networkHandler.command()) {
             case MovementCommand::RelMove: {
-              if(networkHandler.dataSize() != 0) {
+              if(!canMove){commandResult = CommandResult::CommandRefused; break;}
+              if(networkHandler.dataSize() >= 12) {
                 int32_t x = getInt32(networkHandler.data(), 0);
                 int32_t y = getInt32(networkHandler.data(), 4);
                 float speed = (float)getInt16(networkHandler.data(), 8) / 327.0;
@@ -416,11 +750,13 @@ void processNetwork() {
                 networkMovingSpeed = false;
                 head.moveRelative(x, y, speed, acceleration);
               }
+              else {commandResult = CommandResult::CommandBadData;}
 
               break;
             }
             case MovementCommand::AbsMove: {
-              if(networkHandler.dataSize() != 0) {
+              if(!canMove){commandResult = CommandResult::CommandRefused; break;}
+              if(networkHandler.dataSize() >= 12) {
                 int32_t x = getInt32(networkHandler.data(), 0);
                 int32_t y = getInt32(networkHandler.data(), 4);
                 float speed = (float)getInt16(networkHandler.data(), 8) / 327.0;
@@ -429,10 +765,12 @@ void processNetwork() {
                 networkMovingSpeed = false;
                 head.moveToXY(x, y, speed, acceleration);
               }
+              else {commandResult = CommandResult::CommandBadData;}
               break;
             }
             case MovementCommand::MoveSpeed: {
-              if(networkHandler.dataSize() != 0) {
+              if(!canMove){commandResult = CommandResult::CommandRefused; break;}
+              if(networkHandler.dataSize() >= 6) {
                 float speedX = (float)getInt16(networkHandler.data(), 0) / 327.0;
                 float speedY = (float)getInt16(networkHandler.data(), 2) / 327.0;
                 float acceleration = (float)getInt16(networkHandler.data(), 4) / 327.0;
@@ -440,21 +778,106 @@ void processNetwork() {
                 networkMovingSpeed = speedX + speedY != 0;
                 head.moveXY(speedX, speedY, acceleration);
               }
+              else {commandResult = CommandResult::CommandBadData;}
               break;
             }
             case MovementCommand::Stop: {
               float acceleration = (float)getInt16(networkHandler.data(), 0) / 327.0;
               Serial.print("Stopping head at Accel:");Serial.print(acceleration); Serial.println("%");
+              disarm();
               networkMovingSpeed = false;
               head.stop(acceleration);
               break;
             }
+            //VALUE is the preset number (0 based). DATA[0] is the action: 0 (or no data) recall, 1 store the current shot, 2 clear
+            //Storing takes the recall speed and acceleration from DATA[1 - 2] and DATA[3 - 4] like the other moves, 100% if not given
+            case MovementCommand::Preset: {
+              int action = networkHandler.dataSize() >= 1 ? networkHandler.data()[0] : 0;
+              switch(action) {
+                case 0: {
+                  if(!canMove){commandResult = CommandResult::CommandRefused;}
+                  else if(!recallPreset(networkHandler.value())){commandResult = CommandResult::CommandNotFound;}
+                  break;
+                }
+                case 1: {
+                  float speed = networkHandler.dataSize() >= 3 ? (float)getInt16(networkHandler.data(), 1) / 327.0 : 100.0;
+                  float acceleration = networkHandler.dataSize() >= 5 ? (float)getInt16(networkHandler.data(), 3) / 327.0 : 100.0;
+                  if(networkHandler.value() >= PRESET_COUNT){commandResult = CommandResult::CommandNotFound;}
+                  else if(!storePreset(networkHandler.value(), speed, acceleration)){commandResult = CommandResult::CommandRefused;}
+                  break;
+                }
+                case 2: {
+                  if(!presets.clear(networkHandler.value())){commandResult = networkHandler.value() >= PRESET_COUNT ? CommandResult::CommandNotFound : CommandResult::CommandRefused;}
+                  break;
+                }
+                default: {commandResult = CommandResult::CommandBadData; break;}
+              }
+              break;
+            }
+            //Load a move without starting it, a Go starts it. VALUE is the ArmedMove:
+            //ArmAbsolute / ArmRelative DATA is the same as AbsMove / RelMove, ArmPreset DATA[0] is the preset number,
+            //ArmRecording moves to the start of the recording now. Disarm forgets the armed move
+            case MovementCommand::Arm: {
+              int *data = networkHandler.data();
+              switch(networkHandler.value()) {
+                case ArmedMove::ArmAbsolute:
+                case ArmedMove::ArmRelative: {
+                  if(networkHandler.dataSize() < 12){commandResult = CommandResult::CommandBadData; break;}
+                  int32_t x = getInt32(data, 0);
+                  int32_t y = getInt32(data, 4);
+                  if(networkHandler.value() == ArmedMove::ArmRelative) {
+                    x += head.currentPosition(Head::StepperAxis::X);
+                    y += head.currentPosition(Head::StepperAxis::Y);
+                  }
+                  if(!armMove(x, y, (float)getInt16(data, 8) / 327.0, (float)getInt16(data, 10) / 327.0)){commandResult = CommandResult::CommandRefused;}
+                  break;
+                }
+                case ArmedMove::ArmPreset: {
+                  Presets::Preset preset;
+                  if(networkHandler.dataSize() >= 1 && presets.get(data[0], preset)) {
+                    if(!armMove(preset.x, preset.y, preset.speed, preset.acceleration, preset.zoom)){commandResult = CommandResult::CommandRefused;}
+                  }
+                  else {
+                    Serial.println("Can't arm a preset that is not stored");
+                    commandResult = CommandResult::CommandNotFound;
+                  }
+                  break;
+                }
+                case ArmedMove::ArmRecording: {
+                  if(!armRecording()){commandResult = recorder.hasRecording() ? CommandResult::CommandRefused : CommandResult::CommandNotFound;}
+                  break;
+                }
+                case ArmedMove::Disarm: {disarm(); break;}
+                default: {commandResult = CommandResult::CommandBadData; break;}
+              }
+              break;
+            }
+            //Start the armed move, usually sent to 255 so every armed head starts together.
+            //DATA (optional) is the server clock time to start at [time (4)] in us, see clockSync.h
+            case MovementCommand::Go: {
+              if(!armed){commandResult = CommandResult::CommandRefused; break;}
+              if(networkHandler.dataSize() < 4){go(); break;}
+              if(!clockSync.synced()) {
+                Serial.println("Timed GO without clock sync, starting now");
+                go();
+                break;
+              }
+              goAt = clockSync.toLocal(getInt32(networkHandler.data(), 0));
+              int32_t late = micros() - goAt;
+              if(late > 0){Serial.print("Timed GO arrived "); Serial.print(late); Serial.println("us late");}
+              goPending = true;
+              processGo();
+              break;
+            }
+            default: {commandResult = CommandResult::CommandUnknown; break;}
           }
           break;
         }
         case CommandType::Lanc: {
           switch(networkHandler.command()) {
             case LancCommand::Zoom: {
+              presetZoomTarget = -1;
+              zoomTracker.setSpeed((int8_t)networkHandler.value());
               passNetworkDataToSerial();
               break;
             }
@@ -467,6 +890,7 @@ void processNetwork() {
 
               break;
             }
+            default: {commandResult = CommandResult::CommandUnknown; break;}
           }
           break;
         }
@@ -476,25 +900,529 @@ void processNetwork() {
               Serial.println("Network request to reboot. Will reboot in 5 seconds");
               leftLCD.showText("Reboot", "", "Will reboot in 5 seconds", "Requested from network");
               rightLCD.showText("Reboot", "", "Will reboot in 5 seconds", "Requested from network");
+              networkHandler.acknowledge(CommandResult::CommandOk);
               networkHandler.sendCommand(CommandType::Control, ControlCommand::Reboot, 0);
               passNetworkDataToSerial();
               delay(5000);
               resetFunc();
               break;
             }
+            //Set the joystick response curve. VALUE is the curve (0 linear, 1 expo, 2 custom)
+            //DATA (optional) is [axis (0 X, 1 Y, 2 Z, 255 all), expo (0 - 100), 5 custom points (0 - 100%)]
+            case ControlCommand::JoystickCurve: {
+              int *data = networkHandler.data();
+              int axis = networkHandler.dataSize() >= 1 ? data[0] : 255;
+              byte points[CURVE_POINTS];
+              bool hasPoints = networkHandler.dataSize() >= 2 + CURVE_POINTS;
+              if(hasPoints) {for(int i = 0; i < CURVE_POINTS; i++) {points[i] = data[2 + i];}}
+              for(int i = JoyStick::Axis::X; i <= JoyStick::Axis::Z; i++) {
+                if(axis != 255 && axis != i){continue;}
+                byte expo = networkHandler.dataSize() >= 2 ? data[1] : DEFAULT_EXPO;
+                rightJoyStick.setCurve((JoyStick::Axis)i, (JoyStick::Curve)networkHandler.value(), expo, hasPoints ? points : nullptr);
+              }
+              Serial.print("Joystick curve set to "); Serial.println(JoyStick::curveName((JoyStick::Curve)networkHandler.value()));
+              rightJoyStick.compileCurves();
+              saveSettings();
+              break;
+            }
+            //Reply to our clock sync request: VALUE 1, DATA [T1 (4), T2 (4), T3 (4)]
+            case ControlCommand::TimeSync: {
+              int *data = networkHandler.data();
+              if(networkHandler.value() != 1 || networkHandler.dataSize() < 12){break;}
+              bool wasSynced = clockSync.synced();
+              if(clockSync.response(getInt32(data, 0), getInt32(data, 4), getInt32(data, 8), networkHandler.receivedAt()) && !wasSynced) {
+                Serial.print("Clock synced to +-"); Serial.print(clockSync.accuracy()); Serial.println("us");
+              }
+              break;
+            }
+            //Set which groups this device is in. DATA (optional) is the group bitmask [groups (2)], the groups are always sent back
+            case ControlCommand::Groups: {
+              if(networkHandler.dataSize() >= 2) {
+                networkHandler.setGroups(getInt16(networkHandler.data(), 0));
+                saveSettings();
+                Serial.print("Groups set to 0x"); Serial.println(networkHandler.groups(), HEX);
+              }
+              int groups[2] = {networkHandler.groups() >> 8, networkHandler.groups() & 0xFF};
+              networkHandler.sendCommand(networkHandler.remoteIP(), CommandType::Control, ControlCommand::Groups, 0, 2, groups);
+              break;
+            }
+            //Record, play and transfer recorded moves. VALUE is the RecordingAction
+            //RecordingChunk DATA is [offset (2), recording bytes], RecordingEnd DATA is [length (2), CRC-16/CCITT (2)].
+            //An upload is chunks then the end, a Download is answered with the same packets
+            case ControlCommand::Recording: {
+              int *data = networkHandler.data();
+              switch(networkHandler.value()) {
+                case RecordingAction::StopRecorder: {stopRecorder(); break;}
+                case RecordingAction::Record: {startRecording(); break;}
+                case RecordingAction::Play: {
+                  if(armed){commandResult = CommandResult::CommandRefused;}
+                  else {playRecording();}
+                  break;
+                }
+                case RecordingAction::Download: {
+                  if(recorder.hasRecording()) {
+                    recorderSending = true;
+                    recorderSendOffset = 0;
+                    recorderSendTo = networkHandler.remoteIP();
+                  }
+                  else {commandResult = CommandResult::CommandNotFound;}
+                  break;
+                }
+                case RecordingAction::RecordingChunk: {
+                  recorderSending = false;
+                  if(networkHandler.dataSize() <= 2){commandResult = CommandResult::CommandBadData;}
+                  else if(!recorder.writeChunk((uint16_t)getInt16(data, 0), data + 2, networkHandler.dataSize() - 2)){commandResult = CommandResult::CommandRefused;}
+                  break;
+                }
+                case RecordingAction::RecordingEnd: {
+                  if(networkHandler.dataSize() >= 4) {
+                    bool uploaded = recorder.finishUpload((uint16_t)getInt16(data, 0), (uint16_t)getInt16(data, 2));
+                    Serial.println(uploaded ? "Recording uploaded" : "Recording upload failed");
+                    if(!uploaded){commandResult = CommandResult::CommandBadData;}
+                  }
+                  else {commandResult = CommandResult::CommandBadData;}
+                  break;
+                }
+                default: {commandResult = CommandResult::CommandUnknown; break;}
+              }
+              break;
+            }
+            default: {commandResult = CommandResult::CommandUnknown; break;}
           }
           break;
         }
+        default: {commandResult = CommandResult::CommandUnknown; break;}
+      }
+
+      //Tell the sender how it went if it asked, a retry of this command gets the same answer without running it again
+      if(networkHandler.reliable()){networkHandler.acknowledge(commandResult);}
+    }
+}
+
+#ifdef VISCA
+//VISCA positions to steps and back. 0 is the middle of the axis' travel and +-range its ends
+long viscaToSteps(Head::StepperAxis axis, int16_t position, int16_t range) {
+  long half = head.maxPosition(axis) / 2;
+  return constrain(half + (long)position * half / range, 0, head.maxPosition(axis));
+}
+
+int16_t stepsToVisca(Head::StepperAxis axis, long steps, int16_t range) {
+  long half = head.maxPosition(axis) / 2;
+  return ((steps - half) * range) / half;
+}
+
+//Run a command from a VISCA controller. Moves are refused while a move is armed or a recording is playing
+void processVisca() {
+  if(!visca.process()){return;}
+  bool canMove = !armed && !recorder.playing();
+  switch(visca.command()) {
+    case ViscaHandler::Command::PanTiltDrive: {
+      if(!canMove){visca.notExecutable(); return;}
+      float speedX = visca.panDirection() * visca.panSpeed();
+      float speedY = visca.tiltDirection() * visca.tiltSpeed();
+      networkMovingSpeed = speedX != 0 || speedY != 0;
+      head.moveXY(speedX, speedY);
+      break;
+    }
+    case ViscaHandler::Command::PanTiltAbsolute: {
+      if(!canMove){visca.notExecutable(); return;}
+      networkMovingSpeed = false;
+      head.moveToXYTogether(viscaToSteps(Head::StepperAxis::X, visca.pan(), VISCA_PAN_RANGE), viscaToSteps(Head::StepperAxis::Y, visca.tilt(), VISCA_TILT_RANGE), max(visca.panSpeed(), visca.tiltSpeed()));
+      break;
+    }
+    //Relative moves go to the target like absolute ones so the VISCA speed is kept
+    case ViscaHandler::Command::PanTiltRelative: {
+      if(!canMove){visca.notExecutable(); return;}
+      long x = head.currentPosition(Head::StepperAxis::X) + ((long)visca.pan() * (head.maxPosition(Head::StepperAxis::X) / 2)) / VISCA_PAN_RANGE;
+      long y = head.currentPosition(Head::StepperAxis::Y) + ((long)visca.tilt() * (head.maxPosition(Head::StepperAxis::Y) / 2)) / VISCA_TILT_RANGE;
+      networkMovingSpeed = false;
+      head.moveToXYTogether(constrain(x, 0, head.maxPosition(Head::StepperAxis::X)), constrain(y, 0, head.maxPosition(Head::StepperAxis::Y)), max(visca.panSpeed(), visca.tiltSpeed()));
+      break;
+    }
+    case ViscaHandler::Command::PanTiltHome: {
+      if(!canMove){visca.notExecutable(); return;}
+      networkMovingSpeed = false;
+      head.moveToXYTogether(head.maxPosition(Head::StepperAxis::X) / 2, head.maxPosition(Head::StepperAxis::Y) / 2);
+      break;
+    }
+    case ViscaHandler::Command::Zoom: {
+      presetZoomTarget = -1;
+      sendZoom(visca.zoomSpeed());
+      break;
+    }
+    //Drive the zoom to where the tracker thinks that position is, like a preset recall
+    case ViscaHandler::Command::ZoomDirect: {
+      presetZoomTarget = min(((long)visca.zoomPosition() * PRESET_ZOOM_TRAVEL_TIME) / VISCA_ZOOM_RANGE, (long)PRESET_ZOOM_TRAVEL_TIME);
+      break;
+    }
+    case ViscaHandler::Command::Preset: {
+      bool done = false;
+      switch(visca.presetAction()) {
+        case 0: {done = presets.clear(visca.presetNumber()); break;}
+        case 1: {done = storePreset(visca.presetNumber(), VISCA_PRESET_SPEED, 100.0); break;}
+        case 2: {done = canMove && recallPreset(visca.presetNumber()); break;}
+      }
+      if(!done){visca.notExecutable(); return;}
+      break;
+    }
+    case ViscaHandler::Command::PanTiltInquiry: {
+      visca.replyPanTilt(stepsToVisca(Head::StepperAxis::X, head.currentPosition(Head::StepperAxis::X), VISCA_PAN_RANGE), stepsToVisca(Head::StepperAxis::Y, head.currentPosition(Head::StepperAxis::Y), VISCA_TILT_RANGE));
+      return;
+    }
+    case ViscaHandler::Command::ZoomInquiry: {
+      visca.replyZoom((zoomTracker.position() * VISCA_ZOOM_RANGE) / PRESET_ZOOM_TRAVEL_TIME);
+      return;
+    }
+  }
+  visca.complete();
+}
+#endif
+
+#ifdef OSC
+//Pan and tilt speeds can come in separate OSC messages, the last of each is kept
+float oscPanSpeed = 0;
+float oscTiltSpeed = 0;
+
+//Run a matched OSC message, one a loop. Moves are ignored while a move is armed or a recording is playing
+void processOsc() {
+  if(!osc.process()){return;}
+  bool canMove = !armed && !recorder.playing();
+  switch(osc.address()) {
+    case OscHandler::Address::PanSpeed:
+    case OscHandler::Address::TiltSpeed:
+    case OscHandler::Address::PanTiltSpeed: {
+      if(!canMove || osc.argumentCount() == 0){break;}
+      if(osc.address() == OscHandler::Address::TiltSpeed){oscTiltSpeed = osc.percent(0);}
+      else {oscPanSpeed = osc.percent(0);}
+      if(osc.address() == OscHandler::Address::PanTiltSpeed){oscTiltSpeed = osc.percent(1);}
+      networkMovingSpeed = oscPanSpeed != 0 || oscTiltSpeed != 0;
+      head.moveXY(oscPanSpeed, oscTiltSpeed);
+      break;
+    }
+    case OscHandler::Address::ZoomSpeed: {
+      if(osc.argumentCount() == 0){break;}
+      presetZoomTarget = -1;
+      sendZoom(round(osc.percent(0) * 8.0 / 100.0));
+      break;
+    }
+    //Floats are a fraction of the travel, ints are steps
+    case OscHandler::Address::Position: {
+      if(!canMove || osc.argumentCount() < 2){break;}
+      long target[2];
+      for(byte i = 0; i < 2; i++) {
+        long travel = head.maxPosition((Head::StepperAxis)i);
+        target[i] = osc.isFloat(i) ? osc.argument(i) * travel : osc.intArgument(i);
+        target[i] = constrain(target[i], 0, travel);
       }
+      float speed = osc.argumentCount() >= 3 ? abs(osc.percent(2)) : 100.0;
+      networkMovingSpeed = false;
+      oscPanSpeed = oscTiltSpeed = 0;
+      head.moveToXYTogether(target[0], target[1], max(speed, 1.0));
+      break;
+    }
+    case OscHandler::Address::Stop: {
+      if(!osc.triggered()){break;}
+      if(recorder.playing()){stopRecorder();}
+      networkMovingSpeed = false;
+      oscPanSpeed = oscTiltSpeed = 0;
+      head.stop();
+      break;
+    }
+    case OscHandler::Address::PresetRecall: {
+      if(canMove && osc.argumentCount() >= 1){recallPreset(osc.intArgument(0));}
+      break;
+    }
+    case OscHandler::Address::PresetStore: {
+      if(osc.argumentCount() >= 1){storePreset(osc.intArgument(0), 100.0, 100.0);}
+      break;
+    }
+    case OscHandler::Address::Go: {
+      if(osc.triggered()){go();}
+      break;
     }
+    case OscHandler::Address::AutoFocus: {
+      if(osc.triggered()){sendAutoFocus();}
+      break;
+    }
+    default: {break;}
+  }
+}
+#endif
+
+#ifdef DMX
+//DMX takes the head when the console moves pan or tilt and gives it back once they are still, so the joystick and
+//the other inputs still work while the console sends a static look
+bool dmxControlling = false;
+bool dmxSeen = false;
+uint16_t dmxPan = 0;
+uint16_t dmxTilt = 0;
+byte dmxZoom = 0;
+byte dmxFocusBand = 0;
+bool dmxFocusHeld = false;
+unsigned long dmxChanged = 0;
+unsigned long dmxFocusTimer = 0;
+
+void releaseDmx() {
+  if(!dmxControlling){return;}
+  dmxControlling = false;
+  networkMovingSpeed = false;
+  head.moveXY(0, 0);
+  Serial.println("DMX released the head");
 }
 
-//Check every so often if we're still connected to the server. 0 if no check, 1 if success, 2 if fail
+void processDmx() {
+  bool frame = dmx.process();
+  if(!dmx.receiving(DMX_TIMEOUT)) {
+    releaseDmx();
+    dmxSeen = false;
+    dmxFocusHeld = false;
+    return;
+  }
+
+  if(frame) {
+    //The first frame only tells us where the console is, changes after it are acted on
+    bool moved = dmx.pan() != dmxPan || dmx.tilt() != dmxTilt;
+    byte focusBand = dmx.channel(DmxHandler::Channel::Focus) / 64;
+    if(dmxSeen) {
+      if(moved && !armed && !recorder.playing()) {
+        if(!dmxControlling){Serial.println("DMX took the head");}
+        dmxControlling = true;
+        dmxChanged = millis();
+      }
+      if(dmx.channel(DmxHandler::Channel::Zoom) != dmxZoom){presetZoomTarget = ((long)dmx.channel(DmxHandler::Channel::Zoom) * PRESET_ZOOM_TRAVEL_TIME) / 255;}
+      if(focusBand != dmxFocusBand) {
+        if(focusBand == 3){sendAutoFocus();}
+        dmxFocusHeld = focusBand == 1 || focusBand == 2;
+        dmxFocusTimer = millis() - FOCUS_REPEAT_INTERVAL;
+      }
+    }
+    dmxPan = dmx.pan();
+    dmxTilt = dmx.tilt();
+    dmxZoom = dmx.channel(DmxHandler::Channel::Zoom);
+    dmxFocusBand = focusBand;
+    dmxSeen = true;
+
+    if(dmxControlling) {
+      if(armed || recorder.playing() || millis() - dmxChanged >= DMX_RELEASE_TIME){releaseDmx();}
+      else {
+        //Aim to be at this frame's position when the next frame comes, like recorded playback. Working from where the
+        //head actually is keeps the motion continuous between frames and takes out any error from the last one
+        long x = ((uint32_t)dmxPan * head.maxPosition(Head::StepperAxis::X)) / 65535;
+        long y = ((uint32_t)dmxTilt * head.maxPosition(Head::StepperAxis::Y)) / 65535;
+        float speedX = ((x - head.currentPosition(Head::StepperAxis::X)) * 100000.0) / ((float)dmx.interval() * head.maxSpeed(Head::StepperAxis::X));
+        float speedY = ((y - head.currentPosition(Head::StepperAxis::Y)) * 100000.0) / ((float)dmx.interval() * head.maxSpeed(Head::StepperAxis::Y));
+        float limit = dmx.speed();
+        networkMovingSpeed = true;
+        head.moveXY(constrain(speedX, -limit, limit), constrain(speedY, -limit, limit));
+      }
+    }
+  }
+
+  //Near and far repeat while held like the focus buttons
+  if(dmxFocusHeld && millis() - dmxFocusTimer >= FOCUS_REPEAT_INTERVAL) {
+    dmxFocusTimer = millis();
+    sendFocus(dmxFocusBand == 1 ? 0 : 1);
+  }
+}
+#endif
+
+#ifdef FREED_OUTPUT
+//Degrees of an axis from its step position
+float stepsToDegrees(Head::StepperAxis axis, long zero, float stepsPerDegree) {
+  if(zero < 0){zero = head.maxPosition(axis) / 2;}
+  return (head.currentPosition(axis) - zero) / stepsPerDegree;
+}
+
+//Send the camera tracking packet when it is due and there is time before the next step. LANC has no focus readback so focus is 0
+void processFreeD() {
+  if(!freeD.due() || !head.stepClear(FREED_SEND_TIME)){return;}
+  byte packet[FREED_PACKET_SIZE];
+  freeD.build(packet, stepsToDegrees(Head::StepperAxis::X, FREED_PAN_ZERO, FREED_PAN_STEPS_PER_DEGREE), stepsToDegrees(Head::StepperAxis::Y, FREED_TILT_ZERO, FREED_TILT_STEPS_PER_DEGREE), zoomTracker.position(), 0);
+  networkHandler.sendPacket(freeDIP, FREED_PORT, packet, FREED_PACKET_SIZE);
+  freeD.sent();
+}
+#endif
+
+//Show an axis of the head: position, target and step rate
+void showAxisPage(LCD &lcd, const char *title, Head::StepperAxis axis) {
+  lcd.setLine(0, title, FONT_SIZE_MEDIUM);
+  lcd.setLineFormat(1, FONT_SIZE_MEDIUM, "%ld", head.currentPosition(axis));
+  lcd.setLineFormat(2, FONT_SIZE_SMALL, "To: %ld", head.targetPosition(axis));
+  lcd.setLineFormat(3, FONT_SIZE_SMALL, "Rate: %d st/s", (int)head.speed(axis));
+}
+
+//Fill the LCD lines for the selected dashboard page. Formatted straight into the lcd line buffers, nothing is allocated here
+void showDashboard() {
+  switch(dashboard.page()) {
+    case Dashboard::Page::Main: {
+      leftLCD.setLine(0, "Zoom Speed", FONT_SIZE_MEDIUM);
+      leftLCD.setLineFormat(1, FONT_SIZE_MEDIUM, "%d", (int)(((controlPanel.getPotPercentage(ControlPanel::Pot::Left) / 100.0) * 7) + 1));
+      leftLCD.setLineFormat(2, FONT_SIZE_SMALL, "X: %ld", head.currentPosition(Head::StepperAxis::X));
+      leftLCD.setLineFormat(3, FONT_SIZE_SMALL, "Y: %ld", head.currentPosition(Head::StepperAxis::Y));
+      rightLCD.setLine(0, "XY Speed", FONT_SIZE_MEDIUM);
+      rightLCD.setLineFormat(1, FONT_SIZE_MEDIUM, "%d%%", (int)controlPanel.getPotPercentage(ControlPanel::Pot::Right));
+      rightLCD.setLine(2, errorMessages[1], FONT_SIZE_SMALL);
+      //The joystick curve shows when there is no error to show
+      if(errorMessages[0][0] != 0){rightLCD.setLine(3, errorMessages[0], FONT_SIZE_SMALL);}
+      else if(goPending){rightLCD.setLineFormat(3, FONT_SIZE_SMALL, "GO in %ld ms", (long)(goAt - micros()) / 1000);}
+      else if(armed){rightLCD.setLine(3, "Armed", FONT_SIZE_SMALL);}
+      else if(recorder.state() == Recorder::State::Recording){rightLCD.setLineFormat(3, FONT_SIZE_SMALL, "Recording %u%%", recorder.used());}
+      else if(recorder.playing()){rightLCD.setLine(3, "Playing", FONT_SIZE_SMALL);}
+      else if(presetMode){rightLCD.setLine(3, "Presets: tap/hold", FONT_SIZE_SMALL);}
+      else {rightLCD.setLineFormat(3, FONT_SIZE_SMALL, "Curve: %s", JoyStick::curveName(rightJoyStick.getCurve(JoyStick::Axis::X)));}
+      break;
+    }
+    case Dashboard::Page::Position: {
+      showAxisPage(leftLCD, "Pan", Head::StepperAxis::X);
+      showAxisPage(rightLCD, "Tilt", Head::StepperAxis::Y);
+      break;
+    }
+    case Dashboard::Page::Timing: {
+      leftLCD.setLine(0, "Loop", FONT_SIZE_MEDIUM);
+      leftLCD.setLineFormat(1, FONT_SIZE_MEDIUM, "%u us", loopTimer.average());
+      leftLCD.setLineFormat(2, FONT_SIZE_SMALL, "Min: %u us", loopTimer.minimum());
+      leftLCD.setLineFormat(3, FONT_SIZE_SMALL, "Max: %u us", loopTimer.maximum());
+      rightLCD.setLine(0, "RAM Free", FONT_SIZE_MEDIUM);
+      rightLCD.setLineFormat(1, FONT_SIZE_MEDIUM, "%d", ramMonitor.freeMemory());
+      //As of the last RAM report, scanning for it here would hold up the steps during a move
+      rightLCD.setLineFormat(2, FONT_SIZE_SMALL, "Lowest: %d", ramMonitor.lastMinimumFreeMemory());
+      rightLCD.setLine(3, "", FONT_SIZE_SMALL);
+      break;
+    }
+    case Dashboard::Page::Network: {
+      leftLCD.setLine(0, "Network", FONT_SIZE_MEDIUM);
+      leftLCD.setLineFormat(1, FONT_SIZE_MEDIUM, "%lu ms", networkHandler.serverRoundTrip());
+      leftLCD.setLineFormat(2, FONT_SIZE_SMALL, "Rx: %lu Tx: %lu", networkHandler.packetsReceived(), networkHandler.packetsSent());
+      leftLCD.setLineFormat(3, FONT_SIZE_SMALL, "Bad: %lu Auth: %lu", networkHandler.packetsRejected(), networkHandler.authFailures());
+      rightLCD.setLine(0, "Lanc", FONT_SIZE_MEDIUM);
+      rightLCD.setLine(1, lancResponding ? "OK" : "No reply", FONT_SIZE_MEDIUM);
+      rightLCD.setLineFormat(2, FONT_SIZE_SMALL, "Ping: %lu ms", lancRoundTrip);
+      if(clockSync.synced()){rightLCD.setLineFormat(3, FONT_SIZE_SMALL, "Sync: +-%lu us", clockSync.accuracy());}
+      else {rightLCD.setLine(3, "Sync: none", FONT_SIZE_SMALL);}
+      break;
+    }
+  }
+}
+
+//Regenerate the LCD text every so often and send a slice of the changes to each LCD
+void updateLCDs(unsigned int budgetMicros) {
+  if(millis() - lcdTextTimer >= LCD_TEXT_INTERVAL && !showingInfo) {
+    lcdTextTimer = millis();
+    showDashboard();
+  }
+
+  leftLCD.refresh(budgetMicros);
+  rightLCD.refresh(budgetMicros);
+}
+
+//In preset mode the pan/tilt buttons are presets 1 - PRESET_BUTTONS: tap to recall, hold to store the current shot.
+//RECORDER_BUTTON plays and records moves.
+//The stop button leaves preset mode once the head is still. While a move is armed presets aren't recalled and the
+//recorder button does nothing, the stop button disarms first. Returns true if the event was used
+bool presetButtonHeld = false;
+bool processPresetButton(const ControlPanel::ButtonEvent &event) {
+  //Recorder: tap to play or stop, hold to record
+  if(event.button == RECORDER_BUTTON) {
+    if(armed){return true;}
+    switch(event.type) {
+      case ControlPanel::ButtonEventType::Press: {presetButtonHeld = false; break;}
+      case ControlPanel::ButtonEventType::LongPress: {
+        if(recorder.state() == Recorder::State::Idle && !head.isMoving()){startRecording(); presetButtonHeld = true;}
+        break;
+      }
+      case ControlPanel::ButtonEventType::Release: {
+        if(presetButtonHeld){break;}
+        if(recorder.state() == Recorder::State::Idle){playRecording();}
+        else {stopRecorder();}
+        break;
+      }
+      default: {break;}
+    }
+    return true;
+  }
+
+  if(event.button == STOP_BUTTON_ID) {
+    if(event.type == ControlPanel::ButtonEventType::Press && !head.isMoving()) {
+      presetMode = false;
+      lcdTextTimer = millis() - LCD_TEXT_INTERVAL;
+      Serial.println("Left preset mode");
+    }
+    return true;
+  }
+  if(event.button < PRESET_FIRST_BUTTON || event.button >= PRESET_FIRST_BUTTON + PRESET_BUTTONS){return false;}
+
+  byte number = event.button - PRESET_FIRST_BUTTON;
+  switch(event.type) {
+    case ControlPanel::ButtonEventType::Press: {presetButtonHeld = false; break;}
+    case ControlPanel::ButtonEventType::LongPress: {
+      if(!head.isMoving()){presetButtonHeld = storePreset(number, controlPanel.getPotPercentage(ControlPanel::Pot::Right), 100.0);}
+      break;
+    }
+    case ControlPanel::ButtonEventType::Release: {
+      if(!presetButtonHeld && !armed){recallPreset(number);}
+      break;
+    }
+    default: {break;}
+  }
+  return true;
+}
+
+//Run the actions for the button events queued by the scanner. Called every loop so the queue never backs up
+void processButtonEvents() {
+  ControlPanel::ButtonEvent event;
+  while(controlPanel.nextEvent(event)) {
+    //The stop button disarms an armed move
+    if(armed && event.button == STOP_BUTTON_ID && event.type == ControlPanel::ButtonEventType::Press){disarm(); continue;}
+    if(presetMode && processPresetButton(event)){continue;}
+    const ButtonAction &action = buttonActions[event.button];
+    //Presses that would start something new are ignored while moving, releases always go through
+    if(head.isMoving() && !action.whileMoving && event.type != ControlPanel::ButtonEventType::Release){continue;}
+    if(armed && action.moves){continue;}
+
+    void (*run)() = nullptr;
+    switch(event.type) {
+      case ControlPanel::ButtonEventType::Press: {run = action.pressed; break;}
+      case ControlPanel::ButtonEventType::Release: {run = action.released; break;}
+      case ControlPanel::ButtonEventType::LongPress: {run = action.longPressed; break;}
+      case ControlPanel::ButtonEventType::Repeat: {run = action.repeated; break;}
+    }
+    if(run != nullptr){run();}
+  }
+}
+
+//Save where the head came to rest. Retried each loop until the journal takes it
+bool headPositionSaved = true;
+void saveHeadPosition() {
+  if(head.isMoving()){headPositionSaved = false; return;}
+  if(headPositionSaved){return;}
+  int32_t position[2] = {head.currentPosition(Head::StepperAxis::X), head.currentPosition(Head::StepperAxis::Y)};
+  headPositionSaved = journal.write(JournalKey::HeadPosition, position, sizeof(position));
+}
+
+//Report the RAM usage every so often so leaks or stack growth show up on the serial
+unsigned long ramReportTimer = 0;
+void reportRam() {
+  if(millis() - ramReportTimer >= RAM_REPORT_INTERVAL) {
+    ramReportTimer = millis();
+    ramMonitor.report();
+  }
+}
+
+//Ping the server every so often to check we're still connected to it. The reply comes in through processNetwork()
+//so nothing waits on it. 0 if there is no result yet, 1 if the server replied, 2 if it didn't in time
 unsigned long nextCheck = 0;
+bool checkingNetwork = false;
 int checkNetwork() {
+  if(checkingNetwork) {
+    if(networkHandler.serverReplied()){checkingNetwork = false; return 1;}
+    if(networkHandler.pingTimedOut(1000)){checkingNetwork = false; return 2;}
+    return 0;
+  }
   if(nextCheck < millis()) {
     nextCheck = millis() + 30000;
-    return networkHandler.serverConnected() ? 1 : 2;
+    processNetworkCounters();
+    networkHandler.pingServer();
+    checkingNetwork = true;
   }
 
   return 0;
@@ -508,18 +1436,43 @@ void loop() {
       }
     }
 
+    loopTimer.tick();
+    processGo();
+
     //When the lanc responds remove the error if it has one
-    if(Serial1.available() && Serial1.read() == '\n'){waitingResponseFromLanc = false;}
+    if(Serial1.available() && Serial1.read() == '\n'){
+      if(waitingResponseFromLanc){lancRoundTrip = millis() - lancPingSent;}
+      waitingResponseFromLanc = false;
+      lancResponding = true;
+    }
 
     blinkDebugLed();
+    processButtonEvents();
+    journal.service();
+    processNetworkCounters();
+    processPresetZoom();
+    processRecorder();
 
     if(head.isMoving()) {
         if(controlPanel.isStopButtonPressed()) {
           //Stop
+          if(recorder.playing()){stopRecorder();}
+#ifdef DMX
+          releaseDmx();
+#endif
           head.stop(20000.0);
         }
 
         processNetwork();
+#ifdef VISCA
+        processVisca();
+#endif
+#ifdef OSC
+        processOsc();
+#endif
+#ifdef DMX
+        processDmx();
+#endif
 
         if(!head.movingToPosition()) {
           processJoyStick();
@@ -529,24 +1482,44 @@ void loop() {
           head.setMaxSpeed(controlPanel.getPotPercentage(ControlPanel::Pot::Right));
         }
 
+        head.run();
+#ifdef FREED_OUTPUT
+        //Straight after stepping is when there is most time before the next step
+        processFreeD();
+        head.run();
+#endif
+
+        //Keep the LCDs live with a small I2C slice, stepping again straight after
+        updateLCDs(LCD_MOVING_FLUSH_BUDGET);
         head.run();
     }
     else {
       //If there is no movement
 
-      //Check for network errors
-      int networkState = checkNetwork();
+      //Check for network errors, not while a move is armed so nothing gets between it and its GO
+      int networkState = armed || goPending ? 0 : checkNetwork();
       if(networkState == 2) {Serial.println("Server did not respond"); addErrorMessage("Server error");}else if(networkState != 0){Serial.println("Server responded"); removeErrorMessage("Server error");}
 
       //Update the LCDs
-      leftLCD.setTextToShow("Zoom Speed", (String)(int)(((controlPanel.getPotPercentage(ControlPanel::Pot::Left) / 100.0) * 7) + 1), "", "", FONT_SIZE_MEDIUM, FONT_SIZE_MEDIUM, FONT_SIZE_SMALL, FONT_SIZE_SMALL);
-      rightLCD.setTextToShow("XY Speed", (String)(int)controlPanel.getPotPercentage(ControlPanel::Pot::Right) + "%", errorMessages[1], errorMessages[0], FONT_SIZE_MEDIUM, FONT_SIZE_MEDIUM, FONT_SIZE_SMALL, FONT_SIZE_SMALL);
-      leftLCD.update();
-      rightLCD.update();
+      updateLCDs(LCD_IDLE_FLUSH_BUDGET);
+      reportRam();
+      saveHeadPosition();
 
       processNetwork();
+#ifdef VISCA
+      processVisca();
+#endif
+#ifdef OSC
+      processOsc();
+#endif
+#ifdef DMX
+      processDmx();
+#endif
+      processClockSync();
       processJoyStick();
-      checkButtons();
       head.run();
+#ifdef FREED_OUTPUT
+      processFreeD();
+#endif
     }
 }
\ No newline at end of file
@@ -14,8 +14,34 @@ This device will send updates to the broadcast address (x.x.x.255)
 This device will respond to requests over broadcast if the id is correct (id=255 is a broadcast)
 This device will respond to requests by sending directly to the clients ip
 
-TODO:
-Add encription to the packet using the specficied password
+Groups: ids NETWORK_GROUP_BASE to NETWORK_GROUP_BASE + 15 address groups 0 - 15, so device ids must be below
+NETWORK_GROUP_BASE. Each device keeps a bitmask of the groups it is in. Packets are also taken from the multicast
+address set with setMulticast() on the incoming port, so one packet reaches a group without a broadcast
+
+Authentication (NETWORK_AUTHENTICATION): every packet sent and every command received ends with
+SENDER  COUNTER (4, little endian)  TAG (8)
+TAG is SipHash-2-4 of everything before it, keyed from the password (see sipHash.h). SENDER is the id of whoever signed
+the packet, ours is our KJIB id, the server and any other controller each need an id of their own. COUNTER must go up
+with every packet a sender sends, commands with a counter at or below the last one accepted from that sender are
+dropped as replays. The counters of up to NETWORK_SENDERS senders are kept, packets from any more are refused. The 4 and
+5 byte "where are you" requests are still taken without a tag, they can't change anything. The counters are saved every
+NETWORK_COUNTER_SAVE_EVERY packets, so after a reboot at most that many old packets could be replayed
+
+Reliable commands: setting the top bit of TYPE (NETWORK_RELIABLE) adds a sequence number before the data
+"KJIB"  ID      TYPE|0x80   COMMAND     VALUE   DATASIZE    SEQ (2, big endian)     DATA
+Every reliable command is answered to the sender with Control Acknowledge, VALUE the CommandResult,
+DATA [SEQ (2), TYPE, COMMAND]. CommandOk is an ACK, anything else is a NACK saying why it was not done.
+The last NETWORK_DUPLICATE_WINDOW reliable commands are remembered by sender and sequence number, a repeat of one is not
+run again, the reply it got the first time is sent again instead. The window is shared by every sender, not kept for
+each one.
+Sender retry rules:
+- Use a new SEQ for every new command and the same SEQ for every retry of it
+- Retry if there is no reply within ~100ms, give up after a few tries (the head may be unreachable)
+- A NACK is final, retrying the same SEQ only gets the same NACK. Fix the cause and send it with a new SEQ
+- Don't have more than NETWORK_DUPLICATE_WINDOW commands waiting for a reply or a late retry may run twice. That is
+  between all the senders together, when several send reliable commands each should keep well under it
+- The window is lost on a reboot, Reboot is ACKed before restarting so stop retrying it once ACKed
+- With authentication each retry is a new packet with a new COUNTER, only SEQ stays the same
 */
 
 #ifndef NETWORK_HANDLER
@@ -26,8 +52,37 @@ Add encription to the packet using the specficied password
 #include <Ethernet.h>
 #include <EthernetUdp.h>
 #include "../globals.h"
+#include "sipHash.h"
+
+#define NETWORK_GROUP_BASE 224
+#define NETWORK_GROUPS 16
+
+#define NETWORK_RELIABLE 0x80
+#define NETWORK_DUPLICATE_WINDOW 16
+
+//Signers whose replay counters are kept
+#define NETWORK_SENDERS 4
+
+//Largest packet taken in. The data of a command is at most 64 bytes
+#define NETWORK_PACKET_SIZE 96
+
+#ifdef NETWORK_AUTHENTICATION
+#define NETWORK_AUTH_SENDER_SIZE 1
+#define NETWORK_AUTH_COUNTER_SIZE 4
+#define NETWORK_AUTH_TAG_SIZE 8
+#define NETWORK_AUTH_SIZE (NETWORK_AUTH_SENDER_SIZE + NETWORK_AUTH_COUNTER_SIZE + NETWORK_AUTH_TAG_SIZE)
+#else
+#define NETWORK_AUTH_SIZE 0
+#endif
 
 class NetworkHandler {
+    public:
+    //The last counter accepted from a sender, a counter of 0 is an unused entry
+    struct ReceiveCounter {
+        byte sender;
+        uint32_t counter;
+    };
+
     private:
     bool _dhcpMode = false;
     byte *_mac;
@@ -37,8 +92,34 @@ class NetworkHandler {
     int _incomingPort;
     int _outgoingPort;
     EthernetUDP _udp;
-    char _packetBuffer[UDP_TX_PACKET_MAX_SIZE];
+    EthernetUDP _multicastUdp;
+    IPAddress _multicastIP;
+    bool _multicast = false;
+    bool _multicastFailed = false;
+    uint16_t _groups = 0;
+    char _packetBuffer[NETWORK_PACKET_SIZE];
     String _password;
+    SipHash _sipHash;
+    uint32_t _txCounter = 0;
+    unsigned long _authFailures = 0;
+    ReceiveCounter _rxCounters[NETWORK_SENDERS] = {};
+    uint16_t _receivedSinceSave = 0;
+
+    //Reliable commands recently run and what they were answered with, one ring for all senders
+    struct Delivered {
+        IPAddress from;
+        uint16_t sequence;
+        byte type;
+        byte command;
+        byte result;
+    };
+    Delivered _delivered[NETWORK_DUPLICATE_WINDOW];
+    byte _deliveredCount = 0;
+    byte _nextDelivered = 0;
+    bool _reliable = false;
+    bool _awaitingResult = false;
+    Delivered *_current = nullptr;
+    unsigned long _duplicates = 0;
     int _id;
 
     CommandType _type;
@@ -46,8 +127,175 @@ class NetworkHandler {
     int _value;
     int _dataSize;
     int _data[64];
+    IPAddress _remoteIP;
+    uint32_t _receivedAt = 0;
+
+    //Statistics shown on the dashboard
+    unsigned long _packetsReceived = 0;
+    unsigned long _packetsRejected = 0;
+    unsigned long _packetsSent = 0;
+    unsigned long _serverRoundTrip = 0;
+
+    //Server ping waiting for its reply
+    bool _pingPending = false;
+    bool _serverReplied = false;
+    unsigned long _pingSent = 0;
+
+    //Is a packet with this id for us
+    bool addressedToUs(byte id) {
+        if(id == _id || id == 255){return true;}
+        if(id >= NETWORK_GROUP_BASE && id < NETWORK_GROUP_BASE + NETWORK_GROUPS) {return _groups & ((uint16_t)1 << (id - NETWORK_GROUP_BASE));}
+        return false;
+    }
+
+    //Read and check a packet from a socket
+    bool processSocket(EthernetUDP &udp) {
+        uint8_t packetSize = udp.parsePacket();
+        if(packetSize) {
+            _receivedAt = micros();
+            IPAddress remote = udp.remoteIP();
+            _remoteIP = remote;
+            udp.read(_packetBuffer, NETWORK_PACKET_SIZE);
+            _packetsReceived++;
+            if(packetSize > NETWORK_PACKET_SIZE){_packetsRejected++; return false;}
+
+            //Check KJIB flag
+            if(_packetBuffer[0] != 0x4B || _packetBuffer[1] != 0x4A || _packetBuffer[2] != 0x49 || _packetBuffer[3] != 0x42){_packetsRejected++; return false;}
+
+#ifdef NETWORK_AUTHENTICATION
+            //Commands must carry a good tag and a new counter, the tag is left off for the rest of the checks
+            if(packetSize > 5) {
+                if(!authentic(packetSize)){_packetsRejected++; _authFailures++; return false;}
+                packetSize -= NETWORK_AUTH_SIZE;
+            }
+#endif
+
+            //If the incoming length is 4 the server is asking where we are. Nothing for the caller to run
+            if(packetSize == 4 || (packetSize == 5 && _packetBuffer[4] == _id)) {
+                sendMessage(remote, 0);
+                return false;
+            }
+
+            //Check if the ID is for us
+            if(!addressedToUs(_packetBuffer[4])) {return false;}
+
+            //Read the data, reliable commands have the sequence number first
+            byte type = _packetBuffer[5 + 0];
+            bool reliable = type & NETWORK_RELIABLE;
+            byte dataStart = reliable ? 5 + 4 + 2 : 5 + 4;
+            if(packetSize == dataStart + (byte)_packetBuffer[5 + 3] && _packetBuffer[5 + 3] <= 64) {
+                _type = (CommandType)(type & ~NETWORK_RELIABLE);
+                _command = _packetBuffer[5 + 1];
+                _value = _packetBuffer[5 + 2];
+                _dataSize = _packetBuffer[5 + 3];
+                _reliable = reliable;
+                _awaitingResult = false;
+
+                for(int i = 0; i < _dataSize; i++) {
+                    _data[i] = (byte)_packetBuffer[dataStart + i];
+                }
+
+                //The server answering our ping, nothing for the caller to run
+                if(_pingPending && _type == CommandType::Control && _command == ControlCommand::Ping && (byte)_packetBuffer[4] == _id && _value == 0 && _dataSize == 0) {
+                    _serverRoundTrip = millis() - _pingSent;
+                    _pingPending = false;
+                    _serverReplied = true;
+                    return false;
+                }
+
+                if(reliable) {
+                    uint16_t sequence = (byte)_packetBuffer[5 + 4] << 8 | (byte)_packetBuffer[5 + 5];
+                    //Already run, answer it the same way again
+                    Delivered *previous = findDelivered(remote, sequence);
+                    if(previous != nullptr) {
+                        _duplicates++;
+                        sendResult(*previous);
+                        return false;
+                    }
+                    _current = &_delivered[_nextDelivered];
+                    _nextDelivered = (_nextDelivered + 1) % NETWORK_DUPLICATE_WINDOW;
+                    if(_deliveredCount < NETWORK_DUPLICATE_WINDOW){_deliveredCount++;}
+                    _current->from = remote;
+                    _current->sequence = sequence;
+                    _current->type = _type;
+                    _current->command = _command;
+                    _current->result = CommandResult::CommandOk;
+                    _awaitingResult = true;
+                }
+
+                return true;
+            }
+
+            _packetsRejected++;
+        }
+        
+        return false;
+    }
+
+    Delivered *findDelivered(IPAddress from, uint16_t sequence) {
+        for(byte i = 0; i < _deliveredCount; i++) {
+            if(_delivered[i].sequence == sequence && _delivered[i].from == from){return &_delivered[i];}
+        }
+        return nullptr;
+    }
+
+    void sendResult(const Delivered &delivered) {
+        int data[4] = {delivered.sequence >> 8, delivered.sequence & 0xFF, delivered.type, delivered.command};
+        sendCommand(delivered.from, CommandType::Control, ControlCommand::Acknowledge, delivered.result, 4, data);
+    }
+
+#ifdef NETWORK_AUTHENTICATION
+    //Check the tag and counter on the end of the packet in the buffer
+    bool authentic(uint8_t packetSize) {
+        if(packetSize < 9 + NETWORK_AUTH_SIZE){return false;}
+        uint8_t signedLength = packetSize - NETWORK_AUTH_TAG_SIZE;
+        uint64_t tag = _sipHash.hash((const uint8_t *)_packetBuffer, signedLength);
+
+        //Compare every byte so the time taken doesn't show how much matched
+        byte difference = 0;
+        for(uint8_t i = 0; i < NETWORK_AUTH_TAG_SIZE; i++) {difference |= ((uint8_t *)&tag)[i] ^ (uint8_t)_packetBuffer[signedLength + i];}
+        if(difference != 0){return false;}
+
+        byte sender = _packetBuffer[signedLength - NETWORK_AUTH_COUNTER_SIZE - NETWORK_AUTH_SENDER_SIZE];
+        uint32_t counter;
+        memcpy(&counter, _packetBuffer + signedLength - NETWORK_AUTH_COUNTER_SIZE, NETWORK_AUTH_COUNTER_SIZE);
+        ReceiveCounter *entry = findSender(sender);
+        if(entry == nullptr || counter <= entry->counter){return false;}
+        entry->sender = sender;
+        entry->counter = counter;
+        _receivedSinceSave++;
+        return true;
+    }
+
+    //The counter entry of a sender, a free one for a new sender or nullptr if the table is full
+    ReceiveCounter *findSender(byte sender) {
+        ReceiveCounter *free = nullptr;
+        for(byte i = 0; i < NETWORK_SENDERS; i++) {
+            if(_rxCounters[i].counter == 0) {
+                if(free == nullptr){free = &_rxCounters[i];}
+            }
+            else if(_rxCounters[i].sender == sender){return &_rxCounters[i];}
+        }
+        return free;
+    }
+
+    //Add the counter and tag to the end of a packet. Returns the new length
+    uint8_t sign(uint8_t *packet, uint8_t length) {
+        packet[length++] = _id;
+        _txCounter++;
+        memcpy(packet + length, &_txCounter, NETWORK_AUTH_COUNTER_SIZE);
+        length += NETWORK_AUTH_COUNTER_SIZE;
+        uint64_t tag = _sipHash.hash(packet, length);
+        memcpy(packet + length, &tag, NETWORK_AUTH_TAG_SIZE);
+        return length + NETWORK_AUTH_TAG_SIZE;
+    }
+#endif
 
     public:
+    struct Settings {
+        uint16_t groups;    //Bit per group this device is in
+    };
+
     NetworkHandler(int id, int incomingPort, int outgoingPort, String password, byte *mac) {
         _id = id;
         _dhcpMode = true;
@@ -77,31 +325,116 @@ class NetworkHandler {
     int value() {return _value;}
     int dataSize() {return _dataSize;}
     int *data() {return _data;}
+    IPAddress remoteIP() {return _remoteIP;}
+    uint32_t receivedAt() {return _receivedAt;}
+    unsigned long packetsReceived() {return _packetsReceived;}
+    unsigned long packetsRejected() {return _packetsRejected;}
+    unsigned long packetsSent() {return _packetsSent;}
+    unsigned long serverRoundTrip() {return _serverRoundTrip;}
+    uint16_t groups() {return _groups;}
+    unsigned long authFailures() {return _authFailures;}
+    unsigned long duplicates() {return _duplicates;}
+    int id() {return _id;}
+
+    //Was the last command sent reliably (it needs acknowledge() once it has been run)
+    bool reliable() {return _reliable;}
+
+    //ACK or NACK the last reliable command. Only the first call for a command sends anything
+    void acknowledge(CommandResult result) {
+        if(!_awaitingResult){return;}
+        _awaitingResult = false;
+        _current->result = result;
+        sendResult(*_current);
+    }
+
+    //Replay counters: the last counter accepted from each sender and the last one we sent. Kept over a reboot by the caller
+    uint32_t txCounter() {return _txCounter;}
+    //Packets accepted since the counters were last handed out by getCounters()
+    uint16_t receivedSinceSave() {return _receivedSinceSave;}
+    void getCounters(ReceiveCounter rx[NETWORK_SENDERS]) {
+        memcpy(rx, _rxCounters, sizeof(_rxCounters));
+        _receivedSinceSave = 0;
+    }
+    void setCounters(const ReceiveCounter rx[NETWORK_SENDERS], uint32_t tx) {
+        memcpy(_rxCounters, rx, sizeof(_rxCounters));
+        _txCounter = tx;
+    }
+    void setGroups(uint16_t groups) {_groups = groups;}
+    void getSettings(Settings &settings) {settings.groups = _groups;}
+    void setSettings(const Settings &settings) {_groups = settings.groups;}
+
+    //Did begin() fail to open the multicast socket
+    bool multicastFailed() {return _multicastFailed;}
+
+    //Also listen on a multicast address. Call before begin()
+    void setMulticast(IPAddress ip) {
+        _multicastIP = ip;
+        _multicast = true;
+    }
 
     //Attempt to connect to ethernet. Returns true if successful
     bool begin() {
+        _sipHash.setKey(_password.c_str());
         if(_dhcpMode) {
             if(Ethernet.begin(_mac) == 0){return false;}
         }
         else {
             Ethernet.begin(_mac, _ip);
         } 
-        _udp.begin(_incomingPort);
+        if(!_udp.begin(_incomingPort)){return false;}
+        //Without the multicast socket only packets sent to the group address are missed, carry on without it
+        if(_multicast && !_multicastUdp.beginMulticast(_multicastIP, _incomingPort)) {
+            _multicast = false;
+            _multicastFailed = true;
+        }
 
         return true;
     }
 
-    //Send a message  TODO ADD ENCRIPTION USING PASSOWRD
+    //Send a message, signed if NETWORK_AUTHENTICATION is on
     void sendMessage(IPAddress goingAddress, int dataSize = 0, int *data = nullptr) {
-        String lead = "KJIB";
+        uint8_t packet[5 + dataSize + NETWORK_AUTH_SIZE];
+        uint8_t length = 0;
+        packet[length++] = 'K';
+        packet[length++] = 'J';
+        packet[length++] = 'I';
+        packet[length++] = 'B';
+        packet[length++] = _id;
+        for(int i = 0; i < dataSize; i++) {
+            packet[length++] = data[i];
+        }
+#ifdef NETWORK_AUTHENTICATION
+        length = sign(packet, length);
+#endif
 
         _udp.beginPacket(goingAddress, _outgoingPort);
+        _udp.write(packet, length);
+        _udp.endPacket();
+        _packetsSent++;
+    }
 
-        _udp.print(lead);
-        _udp.write(_id);
-        for(int i = 0; i < dataSize; i++) {
-            _udp.write(data[i]);
+#ifdef AUTH_BENCHMARK
+    //Print the time taken to tag a command carrying 12 bytes of data (a move)
+    void benchmark() {
+        _sipHash.setKey(_password.c_str());
+        uint8_t packet[21 + NETWORK_AUTH_SENDER_SIZE + NETWORK_AUTH_COUNTER_SIZE];
+        memset(packet, 0x5A, sizeof(packet));
+        unsigned long start = micros();
+        uint64_t tag = 0;
+        for(int i = 0; i < 100; i++) {
+            packet[0] = i;
+            tag ^= _sipHash.hash(packet, sizeof(packet));
         }
+        unsigned long took = micros() - start;
+        Serial.print("SipHash-2-4 of a "); Serial.print(sizeof(packet)); Serial.print(" byte packet: ");
+        Serial.print(took / 100); Serial.print("us ("); Serial.print((uint8_t)tag); Serial.println(")");
+    }
+#endif
+
+    //Send a packet that isn't KJIB from our socket, for outputs other systems read
+    void sendPacket(IPAddress ip, uint16_t port, const uint8_t *packet, uint8_t length) {
+        _udp.beginPacket(ip, port);
+        _udp.write(packet, length);
         _udp.endPacket();
     }
 
@@ -115,32 +448,33 @@ class NetworkHandler {
         return Ethernet.linkStatus() != LinkOFF && Ethernet.localIP() != IPAddress(0,0,0,0);
     }
 
-    //Ping the server to check for connection. This is blocking!
-    bool serverConnected() {
-        unsigned long timeout = millis() + 1000;
-        while(timeout > millis()) {
-            sendCommand(CommandType::Control, ControlCommand::Ping, 0);
-
-            uint8_t packetSize = _udp.parsePacket();
-            if(packetSize) {
-                _udp.read(_packetBuffer, UDP_TX_PACKET_MAX_SIZE);
+    //Send the server one ping. The reply is picked up by process(), see serverReplied()
+    void pingServer() {
+        _pingPending = true;
+        _serverReplied = false;
+        _pingSent = millis();
+        sendCommand(CommandType::Control, ControlCommand::Ping, 0);
+    }
 
-                //Check KJIB flag
-                if(_packetBuffer[0] != 0x4B){return false;}
-                if(_packetBuffer[1] != 0x4A){return false;}
-                if(_packetBuffer[2] != 0x49){return false;}
-                if(_packetBuffer[3] != 0x42){return false;}
-                if(_packetBuffer[4] != _id){return false;}
+    //Has the server answered the last ping
+    bool serverReplied() {return _serverReplied;}
 
-                //Check command
-                if(_packetBuffer[5] != CommandType::Control){return false;}
-                if(_packetBuffer[6] != ControlCommand::Ping){return false;}
-                if(_packetBuffer[7] != 0){return false;}
-                if(_packetBuffer[8] != 0){return false;}
+    //Is the last ping still waiting for a reply after timeout (ms)
+    bool pingTimedOut(unsigned long timeout) {
+        if(_pingPending && millis() - _pingSent >= timeout){_pingPending = false;}
+        return !_pingPending && !_serverReplied;
+    }
 
-                return true;
-            }
+    //Ping the server and wait up to timeout (ms) for the reply. This is blocking, only for setup!
+    //Other packets are read through the normal checks while waiting but commands in them are not run, reliable ones
+    //are NACKed as refused so a retry isn't told they were done
+    bool serverConnected(unsigned long timeout = 1000) {
+        pingServer();
+        while(!_serverReplied && millis() - _pingSent < timeout) {
+            if(process()){acknowledge(CommandResult::CommandRefused);}
         }
+        _pingPending = false;
+        return _serverReplied;
     }
 
     //Send a command
@@ -159,44 +493,10 @@ class NetworkHandler {
         sendCommand(getBroadcastAddress(), type, command, value, dataSize, data);
     }
 
-    //Process the incoming data
+    //Process the incoming data from the unicast/broadcast socket then the multicast one
     bool process() {
-        uint8_t packetSize = _udp.parsePacket();
-        if(packetSize) {
-            IPAddress remote = _udp.remoteIP();
-            _udp.read(_packetBuffer, UDP_TX_PACKET_MAX_SIZE);
-
-            //Check KJIB flag
-            if(_packetBuffer[0] != 0x4B){return false;}
-            if(_packetBuffer[1] != 0x4A){return false;}
-            if(_packetBuffer[2] != 0x49){return false;}
-            if(_packetBuffer[3] != 0x42){return false;}
-
-            //If the incoming length is 4 the server is asking where we are
-            if(packetSize == 4 || (packetSize == 5 && _packetBuffer[4] == _id)) {
-                sendMessage(remote, 0);
-                return true;
-            }
-
-            //Check if the ID is correct
-            if(_packetBuffer[4] != _id && _packetBuffer[4] != 255) {return false;}
-
-            //Read the data
-            if(packetSize == (9 + _packetBuffer[5 + 3])) {
-                _type = _packetBuffer[5 + 0];
-                _command = _packetBuffer[5 + 1];
-                _value = _packetBuffer[5 + 2];
-                _dataSize = _packetBuffer[5 + 3];
-
-                for(int i = 0; i < _dataSize; i++) {
-                    _data[i] = (byte)_packetBuffer[5 + 4 + i];
-                }
-
-                return true;
-            }
-        }
-        
-        return false;
+        if(processSocket(_udp)){return true;}
+        return _multicast && processSocket(_multicastUdp);
     }
 };
 
@@ -0,0 +1,412 @@
+/**
+    OSC handler
+    Responsible for taking Open Sound Control messages from lighting desks and show software on their own UDP port
+
+    A message is an address pattern, a type tag string and the arguments, each padded to 4 bytes:
+    "/jib/0/pan/speed\0\0\0\0"  ",f\0\0"    ARGUMENTS (4 each, big endian)
+    Arguments i (int32) and f (float32) are taken, T and F read as 1 and 0. Other types are skipped over.
+    Bundles ("#bundle") are taken a message at a time, bundles inside bundles are skipped.
+
+    The address pattern may use the OSC wildcards ? * [abc] [a-z] [!abc] {pan,tilt}, so /jib/{0,1}/stop reaches
+    jibs 0 and 1 and a * for the id reaches every jib. Patterns are matched in a single pass, whatever the wildcards, and
+    a part between /s of OSC_PATTERN_PART_SIZE or more characters matches nothing. Each of our addresses a pattern
+    matches is returned by process() in turn. Our addresses, <id> being the KJIB id:
+    /jib/<id>/pan/speed         speed               Speeds are -1.0 to 1.0 as floats or -100 to 100 (%) as ints
+    /jib/<id>/tilt/speed        speed
+    /jib/<id>/pantilt/speed     pan tilt
+    /jib/<id>/zoom/speed        speed
+    /jib/<id>/position          x y [speed]         0.0 - 1.0 of the travel as floats or steps as ints
+    /jib/<id>/stop
+    /jib/<id>/preset/recall     number
+    /jib/<id>/preset/store      number
+    /jib/<id>/go                                    Start the armed move
+    /jib/<id>/autofocus
+    Stop, go and autofocus also come from buttons, which send 1 when pressed and 0 when released. Only a non zero
+    (or no) argument triggers them.
+
+    Everything is parsed in place in the packet buffer, nothing is allocated
+**/
+
+#ifndef OSC_HANDLER
+#define OSC_HANDLER
+
+#include <Arduino.h>
+#include <Ethernet.h>
+#include <EthernetUdp.h>
+
+#define OSC_PACKET_SIZE 128
+#define OSC_MAX_ARGUMENTS 4
+#define OSC_ADDRESS_SIZE 32
+//Longest / separated part of an address pattern plus one, a pattern position is a bit of a uint32_t when matching
+#define OSC_PATTERN_PART_SIZE 32
+#define OSC_BUNDLE_HEADER_SIZE 16
+
+class OscHandler {
+    public:
+    enum Address {
+        PanSpeed,
+        TiltSpeed,
+        PanTiltSpeed,
+        ZoomSpeed,
+        Position,
+        Stop,
+        PresetRecall,
+        PresetStore,
+        Go,
+        AutoFocus,
+        AddressCount
+    };
+
+    private:
+    //Our addresses after the /jib/<id>/ prefix, in the order of Address
+    const char *_addresses[Address::AddressCount] = {
+        "pan/speed",
+        "tilt/speed",
+        "pantilt/speed",
+        "zoom/speed",
+        "position",
+        "stop",
+        "preset/recall",
+        "preset/store",
+        "go",
+        "autofocus"
+    };
+
+    EthernetUDP _udp;
+    int _port;
+    char _prefix[12];
+    byte _prefixLength;
+
+    byte _packet[OSC_PACKET_SIZE];
+    int _end = 0;               //Bytes in the packet
+    int _next = 0;              //Where the next message or bundle element starts
+    bool _bundle = false;
+
+    //The message being matched against our addresses
+    bool _haveMessage = false;
+    const char *_pattern;
+    byte _nextAddress = 0;
+    Address _address;
+    byte _argumentCount = 0;
+    char _types[OSC_MAX_ARGUMENTS];
+    union Argument {
+        int32_t integer;
+        float real;
+        uint32_t bits;
+    };
+    Argument _arguments[OSC_MAX_ARGUMENTS];
+    unsigned long _dropped = 0;
+
+    uint32_t get32(int offset) {
+        return (uint32_t)_packet[offset] << 24 | (uint32_t)_packet[offset + 1] << 16 | (uint16_t)_packet[offset + 2] << 8 | _packet[offset + 3];
+    }
+
+    //Offset after the padded string at offset, or -1 if it isn't ended before end
+    int skipString(int offset, int end) {
+        for(int i = offset; i < end; i++) {
+            if(_packet[i] == 0){return ((i - offset) / 4 + 1) * 4 + offset;}
+        }
+        return -1;
+    }
+
+    //Read the message in the packet from offset, length bytes long. Returns false if it is malformed
+    bool parseMessage(int offset, int length) {
+        int end = offset + length;
+        if(_packet[offset] != '/'){return false;}
+        int types = skipString(offset, end);
+        if(types < 0 || types > end){return false;}
+        _pattern = (const char *)_packet + offset;
+        _argumentCount = 0;
+
+        //Very old senders leave out the type tags, that is a message without arguments
+        if(types < end && _packet[types] == ',') {
+            int data = skipString(types, end);
+            if(data < 0 || data > end){return false;}
+            for(int i = types + 1; _packet[i] != 0; i++) {
+                char type = _packet[i];
+                Argument argument;
+                argument.bits = 0;
+                switch(type) {
+                    case 'i':
+                    case 'f': {
+                        if(data + 4 > end){return false;}
+                        argument.bits = get32(data);
+                        data += 4;
+                        break;
+                    }
+                    case 'T': {argument.integer = 1; type = 'i'; break;}
+                    case 'F': {argument.integer = 0; type = 'i'; break;}
+                    case 'h':
+                    case 'd':
+                    case 't': {
+                        if(data + 8 > end){return false;}
+                        data += 8;
+                        break;
+                    }
+                    case 's':
+                    case 'S': {data = skipString(data, end); if(data < 0){return false;} break;}
+                    //The blob size is checked before it is added so a huge one can't wrap data back into the packet
+                    case 'b': {
+                        if(data + 4 > end){return false;}
+                        uint32_t size = get32(data);
+                        if(size > (uint32_t)(end - data - 4)){return false;}
+                        data += 4 + ((size + 3) & ~3UL);
+                        break;
+                    }
+                    case 'c':
+                    case 'r':
+                    case 'm': {data += 4; break;}
+                }
+                if(data > end){return false;}
+                if(_argumentCount < OSC_MAX_ARGUMENTS) {
+                    _types[_argumentCount] = type;
+                    _arguments[_argumentCount] = argument;
+                    _argumentCount++;
+                }
+            }
+        }
+        _nextAddress = 0;
+        _haveMessage = true;
+        return true;
+    }
+
+    //Move on to the next message in the packet. Returns false when there are no more
+    bool nextMessage() {
+        if(!_bundle) {
+            if(_next >= _end){return false;}
+            int length = _end - _next;
+            _next = _end;
+            return parseMessage(0, length);
+        }
+        while(_next + 4 <= _end) {
+            uint32_t size = get32(_next);
+            int start = _next + 4;
+            if(size == 0 || size > (uint32_t)(_end - start)) {
+                _next = _end;
+                return false;
+            }
+            _next = start + size;
+            if(parseMessage(start, size)){return true;}
+        }
+        return false;
+    }
+
+    //Take a new packet, length bytes in the buffer
+    void load(int length) {
+        _end = length;
+        _haveMessage = false;
+        _bundle = length >= OSC_BUNDLE_HEADER_SIZE && memcmp(_packet, "#bundle", 8) == 0;
+        _next = _bundle ? OSC_BUNDLE_HEADER_SIZE : 0;
+    }
+
+    //Find the next of our addresses the current message matches, or the next message that matches one
+    bool findMatch() {
+        char address[OSC_ADDRESS_SIZE];
+        memcpy(address, _prefix, _prefixLength);
+        while(true) {
+            while(_haveMessage && _nextAddress < Address::AddressCount) {
+                byte index = _nextAddress++;
+                strncpy(address + _prefixLength, _addresses[index], OSC_ADDRESS_SIZE - _prefixLength);
+                address[OSC_ADDRESS_SIZE - 1] = 0;
+                if(match(_pattern, address)) {
+                    _address = (Address)index;
+                    return true;
+                }
+            }
+            _haveMessage = false;
+            if(!nextMessage()){return false;}
+        }
+    }
+
+    static uint32_t state(byte position) {return (uint32_t)1 << position;}
+
+    //Position after the ] of the [] class at pattern, 0 if it isn't closed
+    static byte classEnd(const char *pattern, byte position, byte length) {
+        for(byte i = position + 1; i < length; i++) {
+            if(pattern[i] == ']'){return i + 1;}
+        }
+        return 0;
+    }
+
+    //Is c in the [] class from position up to end
+    static bool inClass(const char *pattern, byte position, byte end, char c) {
+        const char *p = pattern + position + 1;
+        const char *last = pattern + end - 1;
+        bool negate = *p == '!';
+        if(negate){p++;}
+        bool found = false;
+        while(p < last) {
+            if(p + 2 < last && p[1] == '-') {
+                if(c >= p[0] && c <= p[2]){found = true;}
+                p += 3;
+            }
+            else {
+                if(*p == c){found = true;}
+                p++;
+            }
+        }
+        return found != negate;
+    }
+
+    //Add the positions that are reached without taking a character: past a *, into each option of a {} and out of
+    //the {} at the end of an option. They all lead forward so one pass covers them
+    static uint32_t follow(const char *pattern, byte length, uint32_t states) {
+        for(byte i = 0; i < length; i++) {
+            if(!(states & state(i))){continue;}
+            switch(pattern[i]) {
+                case '*': {states |= state(i + 1); break;}
+                case '{': {
+                    states |= state(i + 1);
+                    for(byte j = i + 1; j < length && pattern[j] != '}'; j++) {
+                        if(pattern[j] == ','){states |= state(j + 1);}
+                    }
+                    break;
+                }
+                case ',':
+                case '}': {
+                    byte j = i;
+                    while(j < length && pattern[j] != '}'){j++;}
+                    if(j < length){states |= state(j + 1);}
+                    break;
+                }
+            }
+        }
+        return states;
+    }
+
+    //Match one part of a pattern without any backtracking: every position the pattern could be at is kept as a bit
+    //and they are all moved on together a character of the address at a time. length is below OSC_PATTERN_PART_SIZE
+    static bool matchPart(const char *pattern, byte length, const char *address, byte addressLength) {
+        uint32_t states = follow(pattern, length, state(0));
+        for(byte a = 0; a < addressLength && states != 0; a++) {
+            uint32_t next = 0;
+            for(byte i = 0; i < length; i++) {
+                if(!(states & state(i))){continue;}
+                switch(pattern[i]) {
+                    case '*': {next |= state(i); break;}
+                    case '?': {next |= state(i + 1); break;}
+                    case '[': {
+                        byte end = classEnd(pattern, i, length);
+                        if(end != 0 && inClass(pattern, i, end, address[a])){next |= state(end);}
+                        break;
+                    }
+                    case '{':
+                    case ',':
+                    case '}': {break;}
+                    default: {
+                        if(pattern[i] == address[a]){next |= state(i + 1);}
+                    }
+                }
+            }
+            states = follow(pattern, length, next);
+        }
+        return states & state(length);
+    }
+
+    public:
+    OscHandler(int port, int id) {
+        _port = port;
+        _prefixLength = snprintf(_prefix, sizeof(_prefix), "/jib/%d/", id);
+    }
+
+    //Start listening. Ethernet must already be up (NetworkHandler::begin()). Returns false if there was no socket free
+    bool begin() {
+        return _udp.begin(_port);
+    }
+
+    int port() {return _port;}
+
+    //Does an OSC address pattern match an address. Matched a / separated part at a time, so * and ? never match
+    //across a / and nothing is retried across one
+    static bool match(const char *pattern, const char *address) {
+        while(true) {
+            const char *patternEnd = pattern;
+            while(*patternEnd != 0 && *patternEnd != '/'){patternEnd++;}
+            const char *addressEnd = address;
+            while(*addressEnd != 0 && *addressEnd != '/'){addressEnd++;}
+            if(patternEnd - pattern >= OSC_PATTERN_PART_SIZE || addressEnd - address >= OSC_ADDRESS_SIZE){return false;}
+            if(!matchPart(pattern, patternEnd - pattern, address, addressEnd - address)){return false;}
+            if(*patternEnd == 0 || *addressEnd == 0){return *patternEnd == *addressEnd;}
+            pattern = patternEnd + 1;
+            address = addressEnd + 1;
+        }
+    }
+
+    //Read incoming messages. Returns true each time one of our addresses is matched, call until it returns false
+    bool process() {
+        if(findMatch()){return true;}
+        int packetSize = _udp.parsePacket();
+        if(packetSize <= 0){return false;}
+        if(packetSize > OSC_PACKET_SIZE) {
+            _udp.flush();
+            _dropped++;
+            return false;
+        }
+        _udp.read(_packet, packetSize);
+        load(packetSize);
+        return findMatch();
+    }
+
+    Address address() {return _address;}
+    byte argumentCount() {return _argumentCount;}
+    unsigned long dropped() {return _dropped;}
+
+    bool isFloat(byte index) {return index < _argumentCount && _types[index] == 'f';}
+
+    //An argument as a number, 0 if it is missing or not a number
+    float argument(byte index) {
+        if(index >= _argumentCount){return 0;}
+        if(_types[index] == 'f'){return _arguments[index].real;}
+        if(_types[index] == 'i'){return _arguments[index].integer;}
+        return 0;
+    }
+
+    long intArgument(byte index) {
+        if(isFloat(index)){return (long)_arguments[index].real;}
+        return argument(index);
+    }
+
+    //An argument as -100 to 100 %: floats are -1.0 to 1.0, ints are already %
+    float percent(byte index) {
+        float value = isFloat(index) ? argument(index) * 100.0 : argument(index);
+        return constrain(value, -100.0, 100.0);
+    }
+
+    //A button style message: no argument or a non zero one
+    bool triggered() {
+        return _argumentCount == 0 || argument(0) != 0;
+    }
+
+#ifdef OSC_BENCHMARK
+    //Print how long a message takes to parse and match, with a plain address and a wildcard one
+    void benchmark() {
+        char plain[OSC_ADDRESS_SIZE];
+        snprintf(plain, sizeof(plain), "%szoom/speed", _prefix);
+        const char *patterns[] = {plain, "/jib/*/{pan,tilt}/spee?"};
+        for(byte p = 0; p < 2; p++) {
+            byte length = 0;
+            memset(_packet, 0, OSC_PACKET_SIZE);
+            strcpy((char *)_packet, patterns[p]);
+            length = (strlen(patterns[p]) / 4 + 1) * 4;
+            _packet[length] = ',';
+            _packet[length + 1] = 'f';
+            length += 4;
+            _packet[length] = 0x3F;  //0.5
+            length += 4;
+
+            unsigned long start = micros();
+            byte matches = 0;
+            for(int i = 0; i < 100; i++) {
+                load(length);
+                while(findMatch()){matches++;}
+            }
+            unsigned long took = micros() - start;
+            Serial.print("OSC parse of "); Serial.print(patterns[p]); Serial.print(": ");
+            Serial.print(took / 100); Serial.print("us ("); Serial.print(matches / 100); Serial.println(" matched)");
+        }
+        load(0);
+    }
+#endif
+};
+
+#endif
@@ -0,0 +1,104 @@
+/**
+    Presets
+    Responsible for the numbered shots (pan, tilt, zoom, speed and acceleration) kept in the journal, one key per preset
+
+    LANC gives no zoom position back so the zoom is estimated from the zoom speeds sent to the camera and how long
+    each was held. Driving fully wide or tele pins the estimate against that end, which takes out any drift
+**/
+
+#ifndef PRESETS
+#define PRESETS
+
+#include <Arduino.h>
+#include "journal.h"
+
+//Estimates the zoom position from the speeds sent to the lanc. 0 is fully wide, PRESET_ZOOM_TRAVEL_TIME fully tele
+class ZoomTracker {
+    private:
+    int _speed = 0;
+    long _position = 0;         //In 1/8s so the slow speeds aren't lost to rounding between frequent updates
+    unsigned long _lastUpdate = 0;
+
+    void update() {
+        unsigned long now = millis();
+        //Full speed (8) moves the estimate 1 per ms
+        _position += (long)(now - _lastUpdate) * _speed;
+        if(_position < 0){_position = 0;}
+        if(_position > PRESET_ZOOM_TRAVEL_TIME * 8L){_position = PRESET_ZOOM_TRAVEL_TIME * 8L;}
+        _lastUpdate = now;
+    }
+
+    public:
+    //Call with every zoom speed sent to the lanc (-8 to 8, positive is tele)
+    void setSpeed(int speed) {
+        update();
+        _speed = speed;
+    }
+
+    int speed() {return _speed;}
+
+    long position() {
+        update();
+        return _position / 8;
+    }
+};
+
+class Presets {
+    public:
+    struct Preset {
+        int32_t x;
+        int32_t y;
+        int16_t zoom;           //ZoomTracker position
+        uint8_t speed;          //%
+        uint8_t acceleration;   //%
+    };
+
+    private:
+    Journal *_journal;
+    byte _firstKey;
+
+    //Copy of the stored presets so a recall never has to wait for the EEPROM
+    Preset _presets[PRESET_COUNT];
+    uint16_t _stored = 0;           //Bit per preset
+
+    public:
+    //Presets are kept in the journal under PRESET_COUNT keys from firstKey
+    Presets(Journal &journal, byte firstKey) {
+        _journal = &journal;
+        _firstKey = firstKey;
+    }
+
+    //Read the presets out of the journal, call once after Journal::begin()
+    void begin() {
+        _stored = 0;
+        for(byte i = 0; i < PRESET_COUNT; i++) {
+            if(_journal->read(_firstKey + i, &_presets[i], sizeof(Preset)) == sizeof(Preset)){_stored |= (uint16_t)1 << i;}
+        }
+    }
+
+    //Read a preset. Returns false if it has not been stored
+    bool get(byte number, Preset &preset) {
+        if(number >= PRESET_COUNT || !(_stored & ((uint16_t)1 << number))){return false;}
+        preset = _presets[number];
+        return true;
+    }
+
+    //Store a preset. Returns false if the journal can't take it right now
+    bool set(byte number, const Preset &preset) {
+        if(number >= PRESET_COUNT){return false;}
+        if(!_journal->write(_firstKey + number, &preset, sizeof(Preset))){return false;}
+        _presets[number] = preset;
+        _stored |= (uint16_t)1 << number;
+        return true;
+    }
+
+    //Forget a preset, an empty record reads back as not stored
+    bool clear(byte number) {
+        if(number >= PRESET_COUNT){return false;}
+        if(!_journal->write(_firstKey + number, nullptr, 0)){return false;}
+        _stored &= ~((uint16_t)1 << number);
+        return true;
+    }
+};
+
+#endif
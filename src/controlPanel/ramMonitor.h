@@ -0,0 +1,64 @@
+/**
+    Ram monitor class
+    Responsible for reporting the free RAM and the lowest it has been since startup
+**/
+
+#ifndef RAM_MONITOR
+#define RAM_MONITOR
+
+#include <Arduino.h>
+
+//Byte painted into unused RAM, the stack and heap overwrite it as they grow
+#define RAM_PAINT_BYTE 0xA5
+
+//Leave this much below the current stack pointer alone while painting
+#define RAM_PAINT_MARGIN 32
+
+extern char __heap_start;
+extern char *__brkval;
+
+class RamMonitor {
+    private:
+    int _minimum = 0;
+
+    //Bottom of the free RAM (top of the heap)
+    static char *heapEnd() {
+        return __brkval == 0 ? &__heap_start : __brkval;
+    }
+
+    public:
+    //Paint the free RAM so the low water mark can be found later. Call first thing in setup()
+    void paint() {
+        char stackTop;
+        for(char *p = heapEnd(); p < &stackTop - RAM_PAINT_MARGIN; p++) {*p = RAM_PAINT_BYTE;}
+        _minimum = freeMemory();
+    }
+
+    //Bytes currently free between the heap and the stack
+    int freeMemory() {
+        char stackTop;
+        return &stackTop - heapEnd();
+    }
+
+    //Smallest gap there has been between the heap and the stack since paint(). This checks the painted bytes one at a
+    //time, which takes around a millisecond, so only call it while the head is still
+    int minimumFreeMemory() {
+        char *p = heapEnd();
+        int count = 0;
+        while(*p == RAM_PAINT_BYTE && p < (char *)SP) {p++; count++;}
+        _minimum = count;
+        return count;
+    }
+
+    //What minimumFreeMemory() last found, quick enough to call while stepping
+    int lastMinimumFreeMemory() {return _minimum;}
+
+    void report() {
+        Serial.print("RAM free: ");
+        Serial.print(freeMemory());
+        Serial.print(" lowest: ");
+        Serial.println(minimumFreeMemory());
+    }
+};
+
+#endif
@@ -0,0 +1,206 @@
+/**
+    Recorder
+    Responsible for keeping a recorded head move in RAM so it can be played back and sent to or from the server
+
+    The recording is one buffer, the same bytes go over the network:
+    Header: TICK (ms)   START X (4)     START Y (4)     START ZOOM (2)
+    Then one sample per tick, the change in position since the last tick:
+    DX DY                               both within +-127 steps
+    ESCAPE 0 DX (2) DY (2)              larger changes
+    ESCAPE 1 ZOOM                       the zoom speed changed, comes before that tick's sample
+
+    Multi byte values are big endian
+**/
+
+#ifndef RECORDER
+#define RECORDER
+
+#include <Arduino.h>
+#include <util/crc16.h>
+
+#define RECORDER_HEADER_SIZE 11
+#define RECORDER_ESCAPE -128
+#define RECORDER_LARGE_SAMPLE 0
+#define RECORDER_ZOOM_SAMPLE 1
+
+//Most bytes one tick can take: a zoom change and a large sample
+#define RECORDER_MAX_SAMPLE_SIZE 9
+
+class Recorder {
+    public:
+    enum State {
+        Idle,
+        Recording,
+        Positioning,    //Moving to the start of the recording before playing it
+        Playing
+    };
+
+    private:
+    byte _buffer[RECORDER_BUFFER_SIZE];
+    uint16_t _length = 0;       //0 when there is no recording
+    uint16_t _index = 0;
+    State _state = State::Idle;
+    int32_t _x = 0;
+    int32_t _y = 0;
+    int8_t _zoom = 0;
+
+    void put16(uint16_t index, int16_t value) {
+        _buffer[index] = (uint16_t)value >> 8;
+        _buffer[index + 1] = value & 0xFF;
+    }
+    void put32(uint16_t index, int32_t value) {
+        put16(index, (uint32_t)value >> 16);
+        put16(index + 2, value & 0xFFFF);
+    }
+    int16_t get16(uint16_t index) {
+        return (int16_t)((uint16_t)_buffer[index] << 8 | _buffer[index + 1]);
+    }
+    int32_t get32(uint16_t index) {
+        return (int32_t)((uint32_t)(uint16_t)get16(index) << 16 | (uint16_t)get16(index + 2));
+    }
+
+    public:
+    State state() {return _state;}
+    bool playing() {return _state == State::Positioning || _state == State::Playing;}
+    bool hasRecording() {return _length >= RECORDER_HEADER_SIZE;}
+    byte tick() {return _buffer[0];}
+    int32_t startX() {return get32(1);}
+    int32_t startY() {return get32(5);}
+    int16_t startZoom() {return get16(9);}
+    uint16_t length() {return _length;}
+    const byte *data() {return _buffer;}
+
+    //Percentage of the buffer used
+    byte used() {
+        return ((uint32_t)_length * 100) / RECORDER_BUFFER_SIZE;
+    }
+
+    //Start a new recording from where the head and zoom are now. Throws away the last recording
+    void startRecording(int32_t x, int32_t y, int16_t zoomPosition) {
+        _buffer[0] = RECORDER_TICK;
+        put32(1, x);
+        put32(5, y);
+        put16(9, zoomPosition);
+        _length = RECORDER_HEADER_SIZE;
+        _x = x;
+        _y = y;
+        _zoom = 0;
+        _state = State::Recording;
+    }
+
+    //Add where the head is at this tick. Returns false and stops recording when the buffer is full
+    bool addSample(int32_t x, int32_t y, int8_t zoomSpeed) {
+        if(_state != State::Recording){return false;}
+        if(_length + RECORDER_MAX_SAMPLE_SIZE > RECORDER_BUFFER_SIZE) {
+            _state = State::Idle;
+            return false;
+        }
+
+        if(zoomSpeed != _zoom) {
+            _buffer[_length++] = (byte)RECORDER_ESCAPE;
+            _buffer[_length++] = RECORDER_ZOOM_SAMPLE;
+            _buffer[_length++] = zoomSpeed;
+            _zoom = zoomSpeed;
+        }
+
+        int32_t dx = x - _x;
+        int32_t dy = y - _y;
+        if(dx > RECORDER_ESCAPE && dx <= 127 && dy > RECORDER_ESCAPE && dy <= 127) {
+            _buffer[_length++] = (int8_t)dx;
+            _buffer[_length++] = (int8_t)dy;
+        }
+        else {
+            dx = constrain(dx, -32768, 32767);
+            dy = constrain(dy, -32768, 32767);
+            _buffer[_length++] = (byte)RECORDER_ESCAPE;
+            _buffer[_length++] = RECORDER_LARGE_SAMPLE;
+            put16(_length, dx);
+            put16(_length + 2, dy);
+            _length += 4;
+        }
+        _x += dx;
+        _y += dy;
+        return true;
+    }
+
+    //Go back to the start of the recording ready to play it. Returns false if there is nothing to play
+    bool startPositioning() {
+        if(!hasRecording() || _state == State::Recording){return false;}
+        _state = State::Positioning;
+        return true;
+    }
+
+    //The head is at the start, play the samples from the beginning
+    void startPlaying() {
+        _index = RECORDER_HEADER_SIZE;
+        _x = startX();
+        _y = startY();
+        _zoom = 0;
+        _state = State::Playing;
+    }
+
+    //Get the position and zoom speed for the next tick. Returns false at the end of the recording
+    bool nextSample(int32_t &x, int32_t &y, int8_t &zoomSpeed) {
+        if(_state != State::Playing){return false;}
+        while(_index < _length) {
+            if((int8_t)_buffer[_index] != RECORDER_ESCAPE) {
+                if(_index + 2 > _length){break;}
+                _x += (int8_t)_buffer[_index];
+                _y += (int8_t)_buffer[_index + 1];
+                _index += 2;
+                x = _x; y = _y; zoomSpeed = _zoom;
+                return true;
+            }
+            if(_index + 2 > _length){break;}
+            byte type = _buffer[_index + 1];
+            if(type == RECORDER_ZOOM_SAMPLE) {
+                if(_index + 3 > _length){break;}
+                _zoom = (int8_t)_buffer[_index + 2];
+                _index += 3;
+            }
+            else if(type == RECORDER_LARGE_SAMPLE) {
+                if(_index + 6 > _length){break;}
+                _x += get16(_index + 2);
+                _y += get16(_index + 4);
+                _index += 6;
+                x = _x; y = _y; zoomSpeed = _zoom;
+                return true;
+            }
+            else {break;}
+        }
+        _state = State::Idle;
+        return false;
+    }
+
+    void stop() {
+        _state = State::Idle;
+    }
+
+    //CRC-16/CCITT of the recording, sent with it so a transfer can be checked
+    uint16_t crc() {
+        uint16_t crc = 0xFFFF;
+        for(uint16_t i = 0; i < _length; i++) {crc = _crc_ccitt_update(crc, _buffer[i]);}
+        return crc;
+    }
+
+    //Put part of a recording coming from the server into the buffer. The recording is unusable until finishUpload()
+    bool writeChunk(uint16_t offset, const int *data, byte count) {
+        if(_state != State::Idle || offset + count > RECORDER_BUFFER_SIZE){return false;}
+        _length = 0;
+        for(byte i = 0; i < count; i++) {_buffer[offset + i] = data[i];}
+        return true;
+    }
+
+    //All the chunks have been sent, keep the recording if the length and CRC match
+    bool finishUpload(uint16_t length, uint16_t expectedCrc) {
+        if(_state != State::Idle || length < RECORDER_HEADER_SIZE || length > RECORDER_BUFFER_SIZE){return false;}
+        _length = length;
+        if(crc() != expectedCrc || tick() == 0) {
+            _length = 0;
+            return false;
+        }
+        return true;
+    }
+};
+
+#endif
@@ -8,42 +8,183 @@
 
 #define DEBUG_LED 13
 
-//Memory address allocations
-#define MEMORY_LEAD_0 0x59
-#define MEMORY_LEAD_1 0x45
-#define MEMORY_LEAD_2 0x45
-#define MEMORY_LEAD_3 0x54
-#define MEMORY_END_0 0x48
-#define MEMORY_END_1 0x49
+//Memory address allocations. The settings are one versioned record (see settingsStore.h)
+#define SETTINGS_STORE_ADDR 64
+#define SETTINGS_STORE_ALLOC 128
 
-#define JOY_MEM_ALLOC 18
-#define RIGHTJOY_MEM_ADDR 4
+//Everything from here to the end of the EEPROM is the journal for state that changes often (see journal.h)
+#define JOURNAL_ADDR (SETTINGS_STORE_ADDR + SETTINGS_STORE_ALLOC)
+#define JOURNAL_END (E2END + 1)
 
-#define CONTROLPANEL_MEM_ALLOC 8
-#define CONTROLPANEL_MEM_ADDR RIGHTJOY_MEM_ADDR + JOY_MEM_ALLOC
+//Field by field layout used by older firmware, only read to migrate it into the settings record
+#define LEGACY_MEMORY_LEAD_0 0x59
+#define LEGACY_MEMORY_LEAD_1 0x45
+#define LEGACY_MEMORY_LEAD_2 0x45
+#define LEGACY_MEMORY_LEAD_3 0x54
+#define LEGACY_MEMORY_END_0 0x48
+#define LEGACY_MEMORY_END_1 0x49
+#define LEGACY_RIGHTJOY_MEM_ADDR 4
+#define LEGACY_CONTROLPANEL_MEM_ADDR 22
+#define LEGACY_END_OF_MEMORY 30
+#define LEGACY_CURVE_MEM_ADDR 32
 
-// #define STEPPER_MEM_ALLOC 8
-// #define HEAD_MEM_ALLOC STEPPER_MEM_ALLOC*2
-// #define HEAD_MEM_ADDR CONTROLPANEL_MEM_ADDR + CONTROLPANEL_MEM_ALLOC
-#define END_OF_MEMORY CONTROLPANEL_MEM_ADDR + CONTROLPANEL_MEM_ALLOC
+//Render LCD text into a RAM framebuffer and only send the changed columns (comment out to draw directly, MicroLCD then
+//draws each line as page row runs)
+#define LCD_FRAMEBUFFER
+
+//How often the LCD text is regenerated (ms) and how long each LCD may spend on I2C per loop (us)
+#define LCD_TEXT_INTERVAL 100
+#define LCD_IDLE_FLUSH_BUDGET 4000
+#define LCD_MOVING_FLUSH_BUDGET 250
+
+//Print the I2C cost of drawing a line in each font over serial at startup
+//#define LCD_BENCHMARK
+
+//Longest error message shown on the lcd and how often the RAM usage is reported over serial (ms)
+#define ERROR_MESSAGE_LENGTH LCD_LINE_LENGTH
+#define RAM_REPORT_INTERVAL 30000
+
+//How often a held focus button sends another focus step to the lanc (ms)
+#define FOCUS_REPEAT_INTERVAL 200
+
+//Sign and check every KJIB packet with SipHash-2-4 keyed from the network password (see networkHandler.cpp).
+//The server must sign its packets the same way with a sender id of its own. Replay counters are saved every
+//NETWORK_COUNTER_SAVE_EVERY packets
+#define NETWORK_AUTHENTICATION
+#define NETWORK_COUNTER_SAVE_EVERY 64
+
+//Print how long signing a packet takes over serial at startup
+//#define AUTH_BENCHMARK
+
+//Number of presets kept, the first PRESET_BUTTONS are on the buttons from PRESET_FIRST_BUTTON in preset mode
+#define PRESET_COUNT 8
+#define PRESET_BUTTONS 6
+#define PRESET_FIRST_BUTTON 3
+
+//Time the camera takes to zoom fully wide to fully tele at full zoom speed (ms). Preset zoom is estimated from this
+#define PRESET_ZOOM_TRAVEL_TIME 4000
+#define PRESET_ZOOM_SPEED 8
+#define PRESET_ZOOM_TOLERANCE 40
+
+//Recorded moves: sample period (ms), RAM kept for the recording (bytes, ~2 per sample) and the recording bytes per packet.
+//A chunk is 2 offset bytes and RECORDER_CHUNK_SIZE of recording, within the 64 bytes of data a command can carry
+#define RECORDER_TICK 40
+#define RECORDER_BUFFER_SIZE 1536
+#define RECORDER_CHUNK_SIZE 48
+
+//The recorder button in preset mode. Tap to play or stop, hold to record
+#define RECORDER_BUTTON 2
+
+//How often the clock is synced with the show controller (ms) and how long without a reply before it is not trusted (ms)
+#define CLOCK_SYNC_INTERVAL 1000
+#define CLOCK_SYNC_TIMEOUT 30000
+
+//A GO for a set time busy waits through the last part (us) so the start isn't held up by the rest of the loop
+#define GO_SPIN_WINDOW 10000
+
+//Sockets on the Ethernet chip, 4 on a W5100 and 8 on a W5500. KJIB takes 2 (its port and the multicast group),
+//VISCA, OSC and DMX one each and one is left for DHCP. With a W5100 only one of VISCA, OSC and DMX fits
+#define NETWORK_SOCKETS 4
+
+//Take VISCA from PTZ controllers on its own port (see viscaHandler.h)
+#define VISCA
+#define VISCA_PORT 52381
+
+//VISCA positions of +-VISCA_PAN_RANGE / +-VISCA_TILT_RANGE are the ends of each axis' travel, 0 is the middle.
+//Zoom direct 0 - VISCA_ZOOM_RANGE is fully wide to fully tele. Standard zoom is a lanc speed, presets set over VISCA recall at VISCA_PRESET_SPEED %
+#define VISCA_PAN_RANGE 0x0990
+#define VISCA_TILT_RANGE 0x0510
+#define VISCA_ZOOM_RANGE 0x4000
+#define VISCA_ZOOM_STANDARD_SPEED 4
+#define VISCA_PRESET_SPEED 100
+
+//Take OSC from lighting desks and show software on its own port (see oscHandler.h)
+//#define OSC
+#define OSC_PORT 8000
+
+//Print how long an OSC message takes to parse and match over serial at startup
+//#define OSC_BENCHMARK
+
+//Drive the head from a lighting console over Art-Net, or sACN with DMX_SACN (see dmxHandler.h)
+//#define DMX
+//#define DMX_SACN
+#define DMX_UNIVERSE 0
+#define DMX_START_ADDRESS 1
+
+//DMX gives the head back when no frames come for DMX_TIMEOUT (ms) or pan and tilt have been still for DMX_RELEASE_TIME (ms)
+#define DMX_TIMEOUT 2000
+#define DMX_RELEASE_TIME 3000
+
+#if 2 + defined(VISCA) + defined(OSC) + defined(DMX) > NETWORK_SOCKETS - 1
+#error "Not enough Ethernet sockets for VISCA, OSC and DMX, turn some off or raise NETWORK_SOCKETS on a W5500"
+#endif
+
+//Send FreeD D1 camera tracking to freeDIP (see freeD.h), FREED_RATE packets a second. Sent from the KJIB socket.
+//A packet is only sent when no step is due within FREED_SEND_TIME (us), the time the SPI transfer takes
+#define FREED_OUTPUT
+#define FREED_PORT 40000
+#define FREED_RATE 50
+#define FREED_SEND_TIME 400
+
+//Steps per degree of each axis and the step position that is 0 degrees (-1 for the middle of the travel)
+#define FREED_PAN_STEPS_PER_DEGREE 72.2
+#define FREED_TILT_STEPS_PER_DEGREE 72.2
+#define FREED_PAN_ZERO -1
+#define FREED_TILT_ZERO -1
+
+//Window the loop time min/avg/max shown on the dashboard is taken over (us)
+#define LOOP_STATS_WINDOW 1000000UL
 
 #include "../globals.h"
 #include "lcd.h"
+#include "ramMonitor.h"
+#include "dashboard.h"
+#include "analogInputs.h"
 
 //LCD Settings
 LCD leftLCD(0x3C);
 LCD rightLCD(0x3D);
 
+RamMonitor ramMonitor;
+LoopTimer loopTimer;
+Dashboard dashboard;
+
 #include "joystick.h"
 #include "controlPanel.h"
 #include "head.h"
 #include "networkHandler.cpp"
+#include "settingsStore.h"
+#include "journal.h"
+#include "presets.h"
+#include "recorder.h"
+#include "clockSync.h"
+#include "viscaHandler.h"
+#include "oscHandler.h"
+#include "dmxHandler.h"
+#include "freeD.h"
+
+SettingsStore settingsStore(SETTINGS_STORE_ADDR);
+
+//Keys of the values kept in the journal. They are kept in the EEPROM so never renumber them, only add to the end
+enum JournalKey {
+    HeadPosition,
+    FirstPreset,    //Presets take PRESET_COUNT keys from here
+    NetworkCounters = FirstPreset + PRESET_COUNT
+};
+Journal journal(JOURNAL_ADDR, JOURNAL_END);
+Presets presets(journal, JournalKey::FirstPreset);
+ZoomTracker zoomTracker;
+Recorder recorder;
+ClockSync clockSync;
+
+//Analog pins sampled in the background: pots then joystick X, Y, Z
+const uint8_t analogPins[] = {A0, A1, A5, A6, A7};
 
 //JoyStick Settings
-JoyStick rightJoyStick(A5, A6, A7, 20, 20, 10, true, true, true, RIGHTJOY_MEM_ADDR);
+JoyStick rightJoyStick(A5, A6, A7, 20, 20, 10, true, true, true);
 
 //Control panel settings
-ControlPanel controlPanel(22, A0, A1, CONTROLPANEL_MEM_ADDR);
+ControlPanel controlPanel(22, A0, A1);
 
 //Head Settings
 //(AccelStepper stepper, int limitPin, boolean invert, int maxSpeed, int defaultAcceleration, long maxPosition, int invertLimit=0) {
@@ -56,4 +197,24 @@ byte mac[] = {0xDE, 0xAD, 0xBE, 0xEF, 0xFE, 0xED};
 IPAddress ip(10, 4, 10, 33);
 NetworkHandler networkHandler(0, 3204, 3032, "tricaster", mac, ip);
 
+//Multicast address packets to groups can be sent to (see networkHandler.cpp)
+IPAddress multicastIP(239, 4, 10, 1);
+
+#ifdef VISCA
+ViscaHandler visca(VISCA_PORT);
+#endif
+
+#ifdef OSC
+OscHandler osc(OSC_PORT, networkHandler.id());
+#endif
+
+#ifdef DMX
+DmxHandler dmx(DMX_UNIVERSE, DMX_START_ADDRESS);
+#endif
+
+#ifdef FREED_OUTPUT
+IPAddress freeDIP(10, 4, 10, 20);
+FreeD freeD(networkHandler.id(), FREED_RATE);
+#endif
+
 #endif
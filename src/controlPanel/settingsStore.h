@@ -0,0 +1,173 @@
+/**
+    Settings store
+    Responsible for keeping the settings in EEPROM as a single versioned record
+
+    Record layout at SETTINGS_STORE_ADDR:
+    0       2           3           5       7
+    "KS"    VERSION     LENGTH      CRC     SETTINGS (LENGTH bytes)
+
+    The CRC (CRC-16/CCITT) covers the settings bytes. New fields must only be added to the end of StoredSettings,
+    a shorter record from older firmware then loads with the new fields left at their defaults. Anything more than
+    that (moving or changing a field) needs SETTINGS_VERSION bumping and a case in migrate()
+**/
+
+#ifndef SETTINGS_STORE
+#define SETTINGS_STORE
+
+#include <Arduino.h>
+#include <EEPROMex.h>
+#include <util/crc16.h>
+
+#define SETTINGS_VERSION 1
+#define SETTINGS_MAGIC_0 'K'
+#define SETTINGS_MAGIC_1 'S'
+#define SETTINGS_HEADER_SIZE 7
+
+struct StoredSettings {
+    JoyStick::Settings rightJoyStick;
+    ControlPanel::Settings controlPanel;
+    NetworkHandler::Settings network;
+};
+
+class SettingsStore {
+    public:
+    enum LoadResult {
+        Loaded,
+        Migrated,
+        Defaults
+    };
+
+    private:
+    int _address;
+    StoredSettings _settings;
+
+    static uint16_t crc(const byte *data, uint16_t length) {
+        uint16_t crc = 0xFFFF;
+        for(uint16_t i = 0; i < length; i++) {crc = _crc_ccitt_update(crc, data[i]);}
+        return crc;
+    }
+
+    //Defaults for a board that has never been calibrated
+    void setDefaults() {
+        memset(&_settings, 0, sizeof(_settings));
+        for(int axis = 0; axis < 3; axis++) {
+            _settings.rightJoyStick.curves[axis].type = JoyStick::Curve::Linear;
+            _settings.rightJoyStick.curves[axis].expo = DEFAULT_EXPO;
+            for(int i = 0; i < CURVE_POINTS; i++) {_settings.rightJoyStick.curves[axis].points[i] = i * (100 / (CURVE_POINTS - 1));}
+        }
+    }
+
+    //Bring a record from a older version up to date. The bytes that were read are already in _settings
+    bool migrate(byte fromVersion) {
+        switch(fromVersion) {
+            //case 1: convert the version 1 fields here when SETTINGS_VERSION goes to 2
+            default: {return false;}
+        }
+    }
+
+    //Read the field by field layout used before the versioned record (lead marker at 0, end marker after the control panel)
+    bool migrateLegacy() {
+        if(EEPROM.read(0) != LEGACY_MEMORY_LEAD_0 || EEPROM.read(1) != LEGACY_MEMORY_LEAD_1 || EEPROM.read(2) != LEGACY_MEMORY_LEAD_2 || EEPROM.read(3) != LEGACY_MEMORY_LEAD_3 ||
+            EEPROM.read(LEGACY_END_OF_MEMORY) != LEGACY_MEMORY_END_0 || EEPROM.read(LEGACY_END_OF_MEMORY + 1) != LEGACY_MEMORY_END_1) {
+            return false;
+        }
+
+        for(int axis = 0; axis < 3; axis++) {
+            for(int value = 0; value < 3; value++) {
+                uint16_t read = EEPROM.readInt(LEGACY_RIGHTJOY_MEM_ADDR + axis * 6 + value * 2);
+                _settings.rightJoyStick.axis[axis][value] = read == 0xFFFF ? 0 : read;
+            }
+        }
+        for(int pot = 0; pot < 2; pot++) {
+            for(int value = 0; value < 2; value++) {
+                int16_t read = EEPROM.readInt(LEGACY_CONTROLPANEL_MEM_ADDR + pot * 4 + value * 2);
+                _settings.controlPanel.pots[pot][value] = read == -1 ? 0 : read;
+            }
+        }
+
+        //Curves were kept after the end marker, 255 if they were never set
+        if(EEPROM.read(LEGACY_CURVE_MEM_ADDR) != 255) {
+            for(int axis = 0; axis < 3; axis++) {
+                JoyStick::AxisCurve &curve = _settings.rightJoyStick.curves[axis];
+                int address = LEGACY_CURVE_MEM_ADDR + axis * 8;
+                curve.type = EEPROM.read(address);
+                curve.expo = EEPROM.read(address + 1);
+                for(int i = 0; i < CURVE_POINTS; i++) {curve.points[i] = EEPROM.read(address + 2 + i);}
+            }
+        }
+        return true;
+    }
+
+    public:
+    SettingsStore(int address) {
+        _address = address;
+        setDefaults();
+    }
+
+    StoredSettings &settings() {return _settings;}
+
+    //Read the record. Older records and the legacy layout are migrated and written back straight away
+    LoadResult load() {
+        setDefaults();
+        if(EEPROM.read(_address) == SETTINGS_MAGIC_0 && EEPROM.read(_address + 1) == SETTINGS_MAGIC_1) {
+            byte version = EEPROM.read(_address + 2);
+            uint16_t length = EEPROM.readInt(_address + 3);
+            uint16_t storedCrc = EEPROM.readInt(_address + 5);
+
+            if(length <= SETTINGS_STORE_ALLOC - SETTINGS_HEADER_SIZE) {
+                //Check the CRC over what was written before trusting any of it
+                uint16_t check = 0xFFFF;
+                for(uint16_t i = 0; i < length; i++) {check = _crc_ccitt_update(check, EEPROM.read(_address + SETTINGS_HEADER_SIZE + i));}
+
+                if(check == storedCrc) {
+                    byte *data = (byte *)&_settings;
+                    for(uint16_t i = 0; i < length && i < sizeof(_settings); i++) {data[i] = EEPROM.read(_address + SETTINGS_HEADER_SIZE + i);}
+
+                    if(version == SETTINGS_VERSION && length == sizeof(_settings)) {return LoadResult::Loaded;}
+                    if(version == SETTINGS_VERSION || migrate(version)) {
+                        save();
+                        return LoadResult::Migrated;
+                    }
+                }
+            }
+            setDefaults();
+        }
+
+        if(migrateLegacy()) {
+            save();
+            //Only once the record is written, otherwise a reset() would bring the old settings back on the next boot
+            EEPROM.updateByte(0, 255);
+            return LoadResult::Migrated;
+        }
+        return LoadResult::Defaults;
+    }
+
+    //Write the record. Only bytes that differ from what is in EEPROM are written
+    void save() {
+        const byte *data = (const byte *)&_settings;
+        EEPROM.updateByte(_address, SETTINGS_MAGIC_0);
+        EEPROM.updateByte(_address + 1, SETTINGS_MAGIC_1);
+        EEPROM.updateByte(_address + 2, SETTINGS_VERSION);
+        EEPROM.updateInt(_address + 3, sizeof(_settings));
+        EEPROM.updateInt(_address + 5, crc(data, sizeof(_settings)));
+        for(uint16_t i = 0; i < sizeof(_settings); i++) {EEPROM.updateByte(_address + SETTINGS_HEADER_SIZE + i, data[i]);}
+    }
+
+    //Forget the saved settings, the next boot will start from defaults
+    void reset() {
+        setDefaults();
+        EEPROM.updateByte(_address, 255);
+        EEPROM.updateByte(_address + 1, 255);
+    }
+
+    //Print the record to the serial monitor for debug
+    void print() {
+        for(int i = 0; i < SETTINGS_HEADER_SIZE + (int)sizeof(_settings); i++) {
+            Serial.print(EEPROM.read(_address + i));
+            if(i % 10 == 9){Serial.println("");}else{Serial.print(",");}
+        }
+        Serial.println("");
+    }
+};
+
+#endif
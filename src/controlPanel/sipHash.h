@@ -0,0 +1,133 @@
+/**
+    SipHash-2-4
+    Responsible for the keyed MAC on network packets (see networkHandler.cpp)
+
+    avr-gcc turns 64 bit shifts into library calls that shift a bit at a time, so the rotations here are made from
+    16/32 bit word swaps and single bit steps instead. Adds and xors of 64 bit values are inlined
+**/
+
+#ifndef SIP_HASH
+#define SIP_HASH
+
+#include <stdint.h>
+#include <string.h>
+
+class SipHash {
+    private:
+    union Word {
+        uint64_t value;
+        uint32_t words[2];
+        uint16_t halves[4];
+    };
+
+    uint64_t _k0 = 0;
+    uint64_t _k1 = 0;
+
+    static uint64_t rotl16(uint64_t x) {
+        Word in, out;
+        in.value = x;
+        out.halves[0] = in.halves[3];
+        out.halves[1] = in.halves[0];
+        out.halves[2] = in.halves[1];
+        out.halves[3] = in.halves[2];
+        return out.value;
+    }
+
+    static uint64_t rotl32(uint64_t x) {
+        Word in, out;
+        in.value = x;
+        out.words[0] = in.words[1];
+        out.words[1] = in.words[0];
+        return out.value;
+    }
+
+    static uint64_t rotl1(uint64_t x) {
+        Word w;
+        w.value = x;
+        uint32_t low = w.words[0];
+        w.words[0] = (low << 1) | (w.words[1] >> 31);
+        w.words[1] = (w.words[1] << 1) | (low >> 31);
+        return w.value;
+    }
+
+    static uint64_t rotr1(uint64_t x) {
+        Word w;
+        w.value = x;
+        uint32_t low = w.words[0];
+        w.words[0] = (low >> 1) | (w.words[1] << 31);
+        w.words[1] = (w.words[1] >> 1) | (low << 31);
+        return w.value;
+    }
+
+    static uint64_t rotl13(uint64_t x) {return rotr1(rotr1(rotr1(rotl16(x))));}
+    static uint64_t rotl17(uint64_t x) {return rotl1(rotl16(x));}
+    static uint64_t rotl21(uint64_t x) {return rotl1(rotl1(rotl1(rotl1(rotl1(rotl16(x))))));}
+
+    static void round(uint64_t &v0, uint64_t &v1, uint64_t &v2, uint64_t &v3) {
+        v0 += v1; v1 = rotl13(v1); v1 ^= v0; v0 = rotl32(v0);
+        v2 += v3; v3 = rotl16(v3); v3 ^= v2;
+        v0 += v3; v3 = rotl21(v3); v3 ^= v0;
+        v2 += v1; v1 = rotl17(v1); v1 ^= v2; v2 = rotl32(v2);
+    }
+
+    //Little endian load, the AVR is little endian so this is a copy
+    static uint64_t load(const uint8_t *bytes, uint8_t count) {
+        Word w;
+        w.value = 0;
+        memcpy(&w, bytes, count);
+        return w.value;
+    }
+
+    public:
+    //Set the 128 bit key
+    void setKey(const uint8_t key[16]) {
+        _k0 = load(key, 8);
+        _k1 = load(key + 8, 8);
+    }
+
+    //Make the key from a password: two SipHashes of it under a zero key
+    void setKey(const char *password) {
+        uint8_t key[16];
+        SipHash derive;
+        uint8_t length = strlen(password);
+        uint8_t buffer[length + 1];
+        memcpy(buffer, password, length);
+        for(uint8_t i = 0; i < 2; i++) {
+            buffer[length] = i;
+            uint64_t half = derive.hash(buffer, length + 1);
+            memcpy(key + i * 8, &half, 8);
+        }
+        setKey(key);
+    }
+
+    uint64_t hash(const uint8_t *data, uint16_t length) {
+        uint64_t v0 = _k0 ^ 0x736f6d6570736575ULL;
+        uint64_t v1 = _k1 ^ 0x646f72616e646f6dULL;
+        uint64_t v2 = _k0 ^ 0x6c7967656e657261ULL;
+        uint64_t v3 = _k1 ^ 0x7465646279746573ULL;
+
+        uint16_t end = length & ~7;
+        for(uint16_t i = 0; i < end; i += 8) {
+            uint64_t m = load(data + i, 8);
+            v3 ^= m;
+            round(v0, v1, v2, v3);
+            round(v0, v1, v2, v3);
+            v0 ^= m;
+        }
+
+        //Last block is the remaining bytes with the length in the top byte
+        Word last;
+        last.value = load(data + end, length & 7);
+        ((uint8_t *)&last)[7] = length & 0xFF;
+        v3 ^= last.value;
+        round(v0, v1, v2, v3);
+        round(v0, v1, v2, v3);
+        v0 ^= last.value;
+
+        v2 ^= 0xFF;
+        for(uint8_t i = 0; i < 4; i++) {round(v0, v1, v2, v3);}
+        return v0 ^ v1 ^ v2 ^ v3;
+    }
+};
+
+#endif
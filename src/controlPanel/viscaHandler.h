@@ -0,0 +1,326 @@
+/**
+    VISCA handler
+    Responsible for taking VISCA commands from switchers and PTZ controllers on their own UDP port so they can drive
+    the head without a translation PC
+
+    VISCA over IP wraps each message in an 8 byte header, all big endian:
+    TYPE (2)    LENGTH (2)  SEQUENCE (4)    PAYLOAD (LENGTH)
+    0x0100 command, 0x0110 inquiry, 0x0200 control (0x01 resets the sequence number). Replies are 0x0111 with the
+    sequence number of the message they answer. Plain VISCA payloads without the header are also taken and answered
+    the same way, some controllers send those.
+
+    This device is camera 1, so payloads start 0x81 and replies 0x90. Understood payloads (p, q, r, s are nibbles):
+    81 01 06 01 VV WW 0p 0t FF                          Pan/tilt drive, p/t: 1 left/up, 2 right/down, 3 stop
+    81 01 06 02 VV WW 0p 0p 0p 0p 0t 0t 0t 0t FF        Absolute position
+    81 01 06 03 VV WW 0p 0p 0p 0p 0t 0t 0t 0t FF        Relative position
+    81 01 06 04 FF                                      Home
+    81 01 04 07 XX FF                                   Zoom: 00 stop, 02 tele, 03 wide, 2p tele at p, 3p wide at p
+    81 01 04 47 0p 0q 0r 0s FF                          Zoom direct
+    81 01 04 3F 0a pp FF                                Preset: a 0 clear, 1 set, 2 recall, pp the preset number
+    81 09 06 12 FF                                      Pan/tilt position inquiry
+    81 09 04 47 FF                                      Zoom position inquiry
+    VV and WW are the pan and tilt speeds. Commands are ACKed as soon as they are understood and completed once
+    the caller has run them (complete() or notExecutable()), anything else gets a syntax error
+**/
+
+#ifndef VISCA_HANDLER
+#define VISCA_HANDLER
+
+#include <Arduino.h>
+#include <Ethernet.h>
+#include <EthernetUdp.h>
+
+#define VISCA_HEADER_SIZE 8
+#define VISCA_MAX_PAYLOAD 16
+#define VISCA_COMMAND 0x0100
+#define VISCA_INQUIRY 0x0110
+#define VISCA_REPLY 0x0111
+#define VISCA_CONTROL 0x0200
+#define VISCA_CONTROL_REPLY 0x0201
+
+#define VISCA_PAN_SPEED_MAX 0x18
+#define VISCA_TILT_SPEED_MAX 0x14
+#define VISCA_ZOOM_SPEED_MAX 7
+
+class ViscaHandler {
+    public:
+    enum Command {
+        PanTiltDrive,
+        PanTiltAbsolute,
+        PanTiltRelative,
+        PanTiltHome,
+        Zoom,
+        ZoomDirect,
+        Preset,
+        PanTiltInquiry,
+        ZoomInquiry
+    };
+
+    private:
+    EthernetUDP _udp;
+    int _port;
+    byte _payload[VISCA_MAX_PAYLOAD];
+    byte _length = 0;
+
+    //Where the message being answered came from and how it was wrapped
+    IPAddress _remoteIP;
+    uint16_t _remotePort = 0;
+    bool _wrapped = false;
+    uint32_t _sequence = 0;
+    bool _awaitingReply = false;
+
+    Command _command;
+    int8_t _panDirection = 0;
+    int8_t _tiltDirection = 0;
+    byte _panSpeed = 0;
+    byte _tiltSpeed = 0;
+    int16_t _pan = 0;
+    int16_t _tilt = 0;
+    int8_t _zoomSpeed = 0;
+    uint16_t _zoomPosition = 0;
+    byte _presetAction = 0;
+    byte _presetNumber = 0;
+
+    static uint16_t get16(const byte *buffer) {return (uint16_t)buffer[0] << 8 | buffer[1];}
+
+    //Four 0x0n bytes to a 16 bit value
+    static uint16_t getNibbles(const byte *buffer) {
+        return (uint16_t)(buffer[0] & 0x0F) << 12 | (uint16_t)(buffer[1] & 0x0F) << 8 | (buffer[2] & 0x0F) << 4 | (buffer[3] & 0x0F);
+    }
+    static void putNibbles(byte *buffer, uint16_t value) {
+        for(byte i = 0; i < 4; i++) {buffer[i] = (value >> ((3 - i) * 4)) & 0x0F;}
+    }
+
+    //Pan/tilt direction byte to -1, 0 or 1. Returns false if it is not one
+    static bool direction(byte value, int8_t &result) {
+        switch(value) {
+            case 0x01: {result = -1; return true;}
+            case 0x02: {result = 1; return true;}
+            case 0x03: {result = 0; return true;}
+        }
+        return false;
+    }
+
+    void send(const byte *payload, byte length, uint16_t type = VISCA_REPLY) {
+        _udp.beginPacket(_remoteIP, _remotePort);
+        if(_wrapped) {
+            byte header[VISCA_HEADER_SIZE] = {
+                (byte)(type >> 8), (byte)(type & 0xFF), 0, length,
+                (byte)(_sequence >> 24), (byte)(_sequence >> 16), (byte)(_sequence >> 8), (byte)(_sequence & 0xFF)
+            };
+            _udp.write(header, VISCA_HEADER_SIZE);
+        }
+        _udp.write(payload, length);
+        _udp.endPacket();
+    }
+
+    void sendAck() {
+        const byte ack[] = {0x90, 0x41, 0xFF};
+        send(ack, sizeof(ack));
+    }
+
+    void sendSyntaxError() {
+        const byte error[] = {0x90, 0x60, 0x02, 0xFF};
+        send(error, sizeof(error));
+    }
+
+    //Work out what the payload in the buffer is. Returns false if it isn't one we understand
+    bool decode(bool inquiry) {
+        const byte *p = _payload;
+        byte n = _length;
+        if(n < 4 || p[0] != 0x81 || p[n - 1] != 0xFF){return false;}
+
+        if(inquiry || p[1] == 0x09) {
+            if(n != 5 || p[1] != 0x09){return false;}
+            if(p[2] == 0x06 && p[3] == 0x12){_command = Command::PanTiltInquiry; return true;}
+            if(p[2] == 0x04 && p[3] == 0x47){_command = Command::ZoomInquiry; return true;}
+            return false;
+        }
+        if(p[1] != 0x01){return false;}
+
+        if(p[2] == 0x06) {
+            switch(p[3]) {
+                case 0x01: {
+                    if(n != 9 || !direction(p[6], _panDirection) || !direction(p[7], _tiltDirection)){return false;}
+                    _panSpeed = p[4];
+                    _tiltSpeed = p[5];
+                    _command = Command::PanTiltDrive;
+                    return true;
+                }
+                case 0x02:
+                case 0x03: {
+                    if(n != 15){return false;}
+                    _panSpeed = p[4];
+                    _tiltSpeed = p[5];
+                    _pan = getNibbles(p + 6);
+                    _tilt = getNibbles(p + 10);
+                    _command = p[3] == 0x02 ? Command::PanTiltAbsolute : Command::PanTiltRelative;
+                    return true;
+                }
+                case 0x04: {
+                    if(n != 5){return false;}
+                    _command = Command::PanTiltHome;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        if(p[2] == 0x04) {
+            switch(p[3]) {
+                case 0x07: {
+                    if(n != 6){return false;}
+                    byte zoom = p[4];
+                    if(zoom == 0x00){_zoomSpeed = 0;}
+                    else if(zoom == 0x02 || zoom == 0x03){_zoomSpeed = zoom == 0x02 ? VISCA_ZOOM_STANDARD_SPEED : -VISCA_ZOOM_STANDARD_SPEED;}
+                    else if((zoom & 0xF0) == 0x20 || (zoom & 0xF0) == 0x30) {
+                        //Speeds 0 - 7 become lanc speeds 1 - 8
+                        int8_t speed = min(zoom & 0x0F, VISCA_ZOOM_SPEED_MAX) + 1;
+                        _zoomSpeed = (zoom & 0xF0) == 0x20 ? speed : -speed;
+                    }
+                    else {return false;}
+                    _command = Command::Zoom;
+                    return true;
+                }
+                case 0x47: {
+                    if(n != 9){return false;}
+                    _zoomPosition = getNibbles(p + 4);
+                    _command = Command::ZoomDirect;
+                    return true;
+                }
+                case 0x3F: {
+                    if(n != 7 || p[4] > 2){return false;}
+                    _presetAction = p[4];
+                    _presetNumber = p[5];
+                    _command = Command::Preset;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    public:
+    ViscaHandler(int port) {
+        _port = port;
+    }
+
+    //Start listening. Ethernet must already be up (NetworkHandler::begin()). Returns false if there was no socket free
+    bool begin() {
+        return _udp.begin(_port);
+    }
+
+    int port() {return _port;}
+
+    //Read an incoming message. Returns true if there is a command or inquiry for the caller to run
+    bool process() {
+        int packetSize = _udp.parsePacket();
+        if(packetSize <= 0){return false;}
+        _remoteIP = _udp.remoteIP();
+        _remotePort = _udp.remotePort();
+        _awaitingReply = false;
+
+        byte buffer[VISCA_HEADER_SIZE + VISCA_MAX_PAYLOAD];
+        if(packetSize > (int)sizeof(buffer)) {
+            _udp.flush();
+            return false;
+        }
+        _udp.read(buffer, packetSize);
+
+        //Plain VISCA starts with the address byte, otherwise it has the IP header
+        uint16_t type = VISCA_COMMAND;
+        byte *payload = buffer;
+        _wrapped = (buffer[0] & 0xF0) != 0x80;
+        if(_wrapped) {
+            if(packetSize < VISCA_HEADER_SIZE || get16(buffer + 2) != packetSize - VISCA_HEADER_SIZE){return false;}
+            type = get16(buffer);
+            _sequence = (uint32_t)get16(buffer + 4) << 16 | get16(buffer + 6);
+            payload = buffer + VISCA_HEADER_SIZE;
+            packetSize -= VISCA_HEADER_SIZE;
+        }
+        if(packetSize <= 0){return false;}
+
+        //Reset sequence number, we only ever echo them
+        if(type == VISCA_CONTROL) {
+            if(payload[0] == 0x01) {
+                const byte reply[] = {0x01};
+                send(reply, sizeof(reply), VISCA_CONTROL_REPLY);
+            }
+            return false;
+        }
+        if(type != VISCA_COMMAND && type != VISCA_INQUIRY){return false;}
+
+        _length = packetSize;
+        memcpy(_payload, payload, _length);
+        if(!decode(type == VISCA_INQUIRY)) {
+            sendSyntaxError();
+            return false;
+        }
+
+        //Inquiries are answered with the value, commands are ACKed now and completed once run
+        if(_command != Command::PanTiltInquiry && _command != Command::ZoomInquiry){sendAck();}
+        _awaitingReply = true;
+        return true;
+    }
+
+    Command command() {return _command;}
+
+    //Drive: -1, 0 or 1 per axis. Left and up are -1
+    int8_t panDirection() {return _panDirection;}
+    int8_t tiltDirection() {return _tiltDirection;}
+
+    //Speed as a percentage of the VISCA range
+    float panSpeed() {return constrain(_panSpeed, 1, VISCA_PAN_SPEED_MAX) * 100.0 / VISCA_PAN_SPEED_MAX;}
+    float tiltSpeed() {return constrain(_tiltSpeed, 1, VISCA_TILT_SPEED_MAX) * 100.0 / VISCA_TILT_SPEED_MAX;}
+
+    //Absolute or relative position in VISCA units, 0 is the middle
+    int16_t pan() {return _pan;}
+    int16_t tilt() {return _tilt;}
+
+    //Zoom as a lanc speed -8 to 8, positive is tele
+    int8_t zoomSpeed() {return _zoomSpeed;}
+    uint16_t zoomPosition() {return _zoomPosition;}
+
+    //Preset action 0 clear, 1 set, 2 recall
+    byte presetAction() {return _presetAction;}
+    byte presetNumber() {return _presetNumber;}
+
+    //The last command has been run
+    void complete() {
+        if(!_awaitingReply){return;}
+        _awaitingReply = false;
+        const byte completion[] = {0x90, 0x51, 0xFF};
+        send(completion, sizeof(completion));
+    }
+
+    //The last command was understood but can't be run right now
+    void notExecutable() {
+        if(!_awaitingReply){return;}
+        _awaitingReply = false;
+        const byte error[] = {0x90, 0x61, 0x41, 0xFF};
+        send(error, sizeof(error));
+    }
+
+    //Answer a pan/tilt position inquiry
+    void replyPanTilt(int16_t pan, int16_t tilt) {
+        if(!_awaitingReply){return;}
+        _awaitingReply = false;
+        byte reply[11] = {0x90, 0x50};
+        putNibbles(reply + 2, pan);
+        putNibbles(reply + 6, tilt);
+        reply[10] = 0xFF;
+        send(reply, sizeof(reply));
+    }
+
+    //Answer a zoom position inquiry
+    void replyZoom(uint16_t zoom) {
+        if(!_awaitingReply){return;}
+        _awaitingReply = false;
+        byte reply[7] = {0x90, 0x50};
+        putNibbles(reply + 2, zoom);
+        reply[6] = 0xFF;
+        send(reply, sizeof(reply));
+    }
+};
+
+#endif
@@ -1,6 +1,18 @@
 #ifndef GLOBALS_H
 #define GLOBALS_H
 
+//Link between the control panel (Serial1) and the lanc controller. Both boards must be built with the same settings.
+//Define LANC_LINK_HARDWARE_UART (here or as a build flag) to run the link on the lanc controller's hardware UART,
+//debug output then moves to AltSoftSerial (pins 8/9) or is removed with LANC_DEBUG_DISABLED
+//#define LANC_LINK_HARDWARE_UART
+#ifndef LANC_LINK_BAUD
+#ifdef LANC_LINK_HARDWARE_UART
+#define LANC_LINK_BAUD 115200
+#else
+#define LANC_LINK_BAUD 9600
+#endif
+#endif
+
 enum CommandType {
     Lanc,
     Movement,
@@ -15,14 +27,50 @@ enum LancCommand {
 
 enum ControlCommand {
     Reboot,
-    Ping
+    Ping,
+    JoystickCurve,
+    Recording,
+    TimeSync,
+    Groups,
+    Acknowledge
+};
+
+//VALUE of a ControlCommand::Acknowledge, what happened to a reliable command
+enum CommandResult {
+    CommandOk,
+    CommandUnknown,     //Type or command not known
+    CommandBadData,     //Missing or wrong data
+    CommandRefused,     //Can't be done right now, e.g. arming while moving
+    CommandNotFound     //Refers to something that isn't there, e.g. a preset that was never stored
+};
+
+//VALUE of a ControlCommand::Recording
+enum RecordingAction {
+    StopRecorder,
+    Record,
+    Play,
+    Download,
+    RecordingChunk,
+    RecordingEnd
 };
 
 enum MovementCommand {
     RelMove,
     AbsMove,
     MoveSpeed,
-    Stop
+    Stop,
+    Preset,
+    Arm,
+    Go
+};
+
+//VALUE of a MovementCommand::Arm
+enum ArmedMove {
+    ArmAbsolute,
+    ArmRelative,
+    ArmPreset,
+    ArmRecording,
+    Disarm = 255
 };
 
 #endif
\ No newline at end of file
@@ -49,16 +49,24 @@ static uint16_t rx_target;
 static uint16_t rx_stop_ticks=0;
 static volatile uint8_t rx_buffer_head;
 static volatile uint8_t rx_buffer_tail;
-#define RX_BUFFER_SIZE 80
+#define RX_BUFFER_SIZE ALTSS_RX_BUFFER_SIZE
 static volatile uint8_t rx_buffer[RX_BUFFER_SIZE];
+static volatile uint16_t rx_overflow_count=0;
+static volatile uint16_t rx_framing_error_count=0;
+static volatile uint8_t rx_buffer_peak=0;
 
 static volatile uint8_t tx_state=0;
 static uint8_t tx_byte;
 static uint8_t tx_bit;
 static volatile uint8_t tx_buffer_head;
 static volatile uint8_t tx_buffer_tail;
-#define TX_BUFFER_SIZE 68
+#define TX_BUFFER_SIZE ALTSS_TX_BUFFER_SIZE
 static volatile uint8_t tx_buffer[TX_BUFFER_SIZE];
+static uint16_t tx_full_count=0;
+
+#if RX_BUFFER_SIZE > 256 || TX_BUFFER_SIZE > 256
+#error "AltSoftSerial buffer sizes are limited to 256 bytes (8 bit head/tail indexes)"
+#endif
 
 
 #ifndef INPUT_PULLUP
@@ -110,6 +118,7 @@ void AltSoftSerial::init(uint32_t cycles_per_bit)
 	tx_state = 0;
 	tx_buffer_head = 0;
 	tx_buffer_tail = 0;
+	clearStatistics();
 	ENABLE_INT_INPUT_CAPTURE();
 }
 
@@ -134,6 +143,7 @@ void AltSoftSerial::writeByte(uint8_t b)
 
 	head = tx_buffer_head + 1;
 	if (head >= TX_BUFFER_SIZE) head = 0;
+	if (tx_buffer_tail == head) tx_full_count++;
 	while (tx_buffer_tail == head) ; // wait until space in buffer
 	intr_state = SREG;
 	cli();
@@ -219,9 +229,27 @@ void AltSoftSerial::flushOutput(void)
 /**            Reception               **/
 /****************************************/
 
+// Called from the receive interrupts only
+static inline void store_rx_byte(uint8_t b)
+{
+	uint8_t head, tail, used;
+
+	head = rx_buffer_head + 1;
+	if (head >= RX_BUFFER_SIZE) head = 0;
+	tail = rx_buffer_tail;
+	if (head == tail) {
+		if (rx_overflow_count < 0xFFFF) rx_overflow_count++;
+		return;
+	}
+	rx_buffer[head] = b;
+	rx_buffer_head = head;
+	used = (head >= tail) ? head - tail : RX_BUFFER_SIZE + head - tail;
+	if (used > rx_buffer_peak) rx_buffer_peak = used;
+}
+
 ISR(CAPTURE_INTERRUPT)
 {
-	uint8_t state, bit, head;
+	uint8_t state, bit;
 	uint16_t capture, target;
 	uint16_t offset, offset_overflow;
 
@@ -254,12 +282,9 @@ ISR(CAPTURE_INTERRUPT)
 			state++;
 			if (state >= 9) {
 				DISABLE_INT_COMPARE_B();
-				head = rx_buffer_head + 1;
-				if (head >= RX_BUFFER_SIZE) head = 0;
-				if (head != rx_buffer_tail) {
-					rx_buffer[head] = rx_byte;
-					rx_buffer_head = head;
-				}
+				// a falling edge this early means the stop bit was low
+				if (rx_bit) rx_framing_error_count++;
+				store_rx_byte(rx_byte);
 				CONFIG_CAPTURE_FALLING_EDGE();
 				rx_bit = 0;
 				rx_state = 0;
@@ -274,7 +299,7 @@ ISR(CAPTURE_INTERRUPT)
 
 ISR(COMPARE_B_INTERRUPT)
 {
-	uint8_t head, state, bit;
+	uint8_t state, bit;
 
 	DISABLE_INT_COMPARE_B();
 	CONFIG_CAPTURE_FALLING_EDGE();
@@ -284,12 +309,9 @@ ISR(COMPARE_B_INTERRUPT)
 		rx_byte = (rx_byte >> 1) | bit;
 		state++;
 	}
-	head = rx_buffer_head + 1;
-	if (head >= RX_BUFFER_SIZE) head = 0;
-	if (head != rx_buffer_tail) {
-		rx_buffer[head] = rx_byte;
-		rx_buffer_head = head;
-	}
+	// the line is sampled inside the stop bit, which must be high
+	if (!bit) rx_framing_error_count++;
+	store_rx_byte(rx_byte);
 	rx_state = 0;
 	CONFIG_CAPTURE_FALLING_EDGE();
 	rx_bit = 0;
@@ -346,6 +368,53 @@ void AltSoftSerial::flushInput(void)
 	rx_buffer_head = rx_buffer_tail;
 }
 
+uint16_t AltSoftSerial::rxOverflowCount(void)
+{
+	uint8_t intr_state;
+	uint16_t count;
+
+	intr_state = SREG;
+	cli();
+	count = rx_overflow_count;
+	SREG = intr_state;
+	return count;
+}
+
+uint16_t AltSoftSerial::framingErrorCount(void)
+{
+	uint8_t intr_state;
+	uint16_t count;
+
+	intr_state = SREG;
+	cli();
+	count = rx_framing_error_count;
+	SREG = intr_state;
+	return count;
+}
+
+uint8_t AltSoftSerial::rxBufferPeak(void)
+{
+	return rx_buffer_peak;
+}
+
+uint16_t AltSoftSerial::txFullCount(void)
+{
+	return tx_full_count;
+}
+
+void AltSoftSerial::clearStatistics(void)
+{
+	uint8_t intr_state;
+
+	intr_state = SREG;
+	cli();
+	rx_overflow_count = 0;
+	rx_framing_error_count = 0;
+	rx_buffer_peak = 0;
+	tx_full_count = 0;
+	SREG = intr_state;
+}
+
 
 #ifdef ALTSS_USE_FTM0
 void ftm0_isr(void)
@@ -33,6 +33,15 @@
 #include "pins_arduino.h"
 #endif
 
+// Buffer sizes may be overridden with build flags, eg -D ALTSS_RX_BUFFER_SIZE=128
+// One slot of each ring is kept free, so the usable size is one byte less.
+#ifndef ALTSS_RX_BUFFER_SIZE
+#define ALTSS_RX_BUFFER_SIZE 80
+#endif
+#ifndef ALTSS_TX_BUFFER_SIZE
+#define ALTSS_TX_BUFFER_SIZE 68
+#endif
+
 #if defined(__arm__) && defined(CORE_TEENSY)
 #define ALTSS_BASE_FREQ F_BUS
 #else
@@ -68,6 +77,12 @@ public:
 	static int library_version() { return 1; }
 	static void enable_timer0(bool enable) { }
 	static bool timing_error;
+	// Link statistics, counted since begin() or the last clearStatistics()
+	static uint16_t rxOverflowCount();	// bytes dropped because the rx buffer was full
+	static uint16_t framingErrorCount();	// bytes received without a valid stop bit
+	static uint8_t rxBufferPeak();		// most bytes ever waiting in the rx buffer
+	static uint16_t txFullCount();		// writes that had to wait for tx buffer space
+	static void clearStatistics();
 private:
 	static void init(uint32_t cycles_per_bit);
 	static void writeByte(uint8_t byte);
@@ -6,21 +6,48 @@
 #define SOFTWARE_VERSION_MAJOR 0
 #define SOFTWARE_VERSION_MINOR 3
 #define DEBUG_LED 13
-Lanc lanc(3, 4);
-AltSoftSerial Serial1;
+#define DEBUG_BAUD 115200
+#define DEBUG_ALTSS_BAUD 57600
 
 #include "../globals.h"
 
+Lanc lanc(3, 4);
+
+//The link to the control panel and the debug output swap ports when the link is on the hardware UART
+#ifdef LANC_LINK_HARDWARE_UART
+#define LinkSerial Serial
+#ifndef LANC_DEBUG_DISABLED
+AltSoftSerial DebugSerial;
+#endif
+#else
+AltSoftSerial LinkSerial;
+#define DebugSerial Serial
+#endif
+
 void(* resetFunc) (void) = 0;
 
+//Send a serial message to the debug output
+void sendSerial(String str) {
+#ifndef LANC_DEBUG_DISABLED
+  DebugSerial.println(str);
+#endif
+}
+
 void setup() {
-  Serial.begin(115200);
-  Serial.println("Kardinia Jib Controller 2020 - Lanc Controller");
-  Serial.println(String("Version:") + SOFTWARE_VERSION_MAJOR + String(".") + SOFTWARE_VERSION_MINOR);
-  Serial.println(String("Last Compile Date:` ") + __DATE__);
-  Serial.println("");
-  Serial1.begin(9600);
-  Serial1.println("Lanc controller ready!");
+#ifndef LANC_DEBUG_DISABLED
+#ifdef LANC_LINK_HARDWARE_UART
+  DebugSerial.begin(DEBUG_ALTSS_BAUD);
+#else
+  DebugSerial.begin(DEBUG_BAUD);
+#endif
+#endif
+  sendSerial("Kardinia Jib Controller 2020 - Lanc Controller");
+  sendSerial(String("Version:") + SOFTWARE_VERSION_MAJOR + String(".") + SOFTWARE_VERSION_MINOR);
+  sendSerial(String("Last Compile Date:` ") + __DATE__);
+  sendSerial(String("Link: ") + LANC_LINK_BAUD + String(" baud"));
+  sendSerial("");
+  LinkSerial.begin(LANC_LINK_BAUD);
+  LinkSerial.println("Lanc controller ready!");
   lanc.begin();
 }
 
@@ -33,8 +60,9 @@ int data[64];
 int serInc = 0;
 char previousChar = 0;
 bool processSerialCommunication() {
-    if (Serial1.available()) {
-      char current = (char)Serial1.read();
+    //Drain everything that arrived while lanc.loop() was blocking, stopping at the end of a command
+    while (LinkSerial.available()) {
+      char current = (char)LinkSerial.read();
       
       //Check if we're at the end of the input
       if(current == 10){
@@ -42,7 +70,7 @@ bool processSerialCommunication() {
           bool end = serInc == 5 + dataSize;
           serInc = 0; 
           previousChar = 0;
-          Serial1.println();
+          LinkSerial.println();
           return end;
         } 
         else {return false;}
@@ -67,11 +95,20 @@ bool processSerialCommunication() {
     return false;
 }
 
-//Send a serial message to both onboard serial and external serial for debugging
-void sendSerial(String str) {
-  //Serial1.println(str);
-  Serial.println(str); 
+#ifndef LANC_LINK_HARDWARE_UART
+//Report any change in the control panel link statistics
+uint16_t reportedOverflows = 0;
+uint16_t reportedFramingErrors = 0;
+void reportSerialStatistics() {
+  uint16_t overflows = LinkSerial.rxOverflowCount();
+  uint16_t framingErrors = LinkSerial.framingErrorCount();
+  if(overflows != reportedOverflows || framingErrors != reportedFramingErrors) {
+    reportedOverflows = overflows;
+    reportedFramingErrors = framingErrors;
+    sendSerial("Link RX overflows: " + (String)overflows + " framing errors: " + (String)framingErrors + " peak buffer: " + (String)LinkSerial.rxBufferPeak() + "/" + (String)(ALTSS_RX_BUFFER_SIZE - 1));
+  }
 }
+#endif
 
 //Heartbeat
 unsigned long heartBeat = 0;
@@ -79,6 +116,9 @@ void blinkDebugLed() {
   if(millis() - heartBeat >= 500) {
     heartBeat = millis();
     digitalWrite(DEBUG_LED, !digitalRead(DEBUG_LED));
+#ifndef LANC_LINK_HARDWARE_UART
+    reportSerialStatistics();
+#endif
   }
 }
 
@@ -109,13 +149,13 @@ void loop() {
       case CommandType::Control: {
         switch(command) {
           case ControlCommand::Reboot: {
-            Serial.println("Rebooting");
+            sendSerial("Rebooting");
             resetFunc();
             break;
           }
           case ControlCommand::Ping: {
-            Serial.println("Replied to ping command");
-            Serial1.println();
+            sendSerial("Replied to ping command");
+            LinkSerial.println();
             break;
           }
         }
@@ -0,0 +1,80 @@
+//Just enough of the Arduino core to build the control panel classes on the host for the native tests.
+//millis() and micros() run off a clock the test sets
+#ifndef ARDUINO_STUB
+#define ARDUINO_STUB
+
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <algorithm>
+#include <avr/pgmspace.h>
+
+#define ARDUINO 100
+
+typedef uint8_t byte;
+using std::min;
+using std::max;
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+
+#define constrain(amount, low, high) ((amount) < (low) ? (low) : ((amount) > (high) ? (high) : (amount)))
+
+namespace stub {
+    inline unsigned long &clock() {static unsigned long micros = 0; return micros;}
+}
+inline unsigned long micros() {return stub::clock();}
+inline unsigned long millis() {return stub::clock() / 1000;}
+inline void delay(unsigned long ms) {stub::clock() += ms * 1000;}
+inline void delayMicroseconds(unsigned int us) {stub::clock() += us;}
+
+class String : public std::string {
+    public:
+    String() {}
+    String(const char *text) : std::string(text) {}
+    String(const std::string &text) : std::string(text) {}
+    String(int value) : std::string(std::to_string(value)) {}
+    String(unsigned int value) : std::string(std::to_string(value)) {}
+    String(long value) : std::string(std::to_string(value)) {}
+    String(unsigned long value) : std::string(std::to_string(value)) {}
+    int indexOf(char c) const {size_t at = find(c); return at == npos ? -1 : (int)at;}
+};
+
+class Print {
+    public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size) {
+        for(size_t i = 0; i < size; i++){write(buffer[i]);}
+        return size;
+    }
+    size_t print(const char *text) {return write((const uint8_t *)text, strlen(text));}
+    size_t print(const String &text) {return print(text.c_str());}
+    size_t println() {return print("\r\n");}
+    size_t println(const char *text) {return print(text) + println();}
+    size_t println(const String &text) {return println(text.c_str());}
+};
+
+class Stream : public Print {
+    public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+struct SerialStub {
+    template<class T> void print(T) {}
+    template<class T> void println(T) {}
+    void println() {}
+};
+static SerialStub Serial;
+
+#endif
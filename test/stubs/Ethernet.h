@@ -0,0 +1,32 @@
+//Ethernet library stand in for the native tests
+#ifndef ETHERNET_STUB
+#define ETHERNET_STUB
+
+#include <Arduino.h>
+
+class IPAddress {
+    private:
+    byte _octets[4] = {0, 0, 0, 0};
+
+    public:
+    IPAddress() {}
+    IPAddress(byte a, byte b, byte c, byte d) {_octets[0] = a; _octets[1] = b; _octets[2] = c; _octets[3] = d;}
+    byte operator[](int index) const {return _octets[index];}
+    byte &operator[](int index) {return _octets[index];}
+    bool operator==(const IPAddress &other) const {return memcmp(_octets, other._octets, 4) == 0;}
+    bool operator!=(const IPAddress &other) const {return !(*this == other);}
+};
+
+enum EthernetLinkStatus {Unknown, LinkON, LinkOFF};
+
+class EthernetClass {
+    public:
+    IPAddress ip = IPAddress(10, 0, 0, 2);
+    int begin(byte *) {return 1;}
+    void begin(byte *, IPAddress address) {ip = address;}
+    IPAddress localIP() {return ip;}
+    EthernetLinkStatus linkStatus() {return LinkON;}
+};
+static EthernetClass Ethernet;
+
+#endif
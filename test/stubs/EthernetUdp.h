@@ -0,0 +1,69 @@
+//EthernetUDP stand in for the native tests. A socket is found by the port it was begun on, packets for it to read are
+//queued with receive() and the packets it sends are kept in sent
+#ifndef ETHERNET_UDP_STUB
+#define ETHERNET_UDP_STUB
+
+#include <Arduino.h>
+#include <Ethernet.h>
+#include <deque>
+#include <map>
+#include <vector>
+
+class EthernetUDP {
+    public:
+    struct Packet {
+        IPAddress ip;
+        uint16_t port;
+        std::vector<uint8_t> data;
+    };
+    std::deque<Packet> incoming;
+    std::vector<Packet> sent;
+
+    //What begin() returns, 0 is the W5100 being out of sockets
+    static uint8_t &socketsFree() {static uint8_t free = 1; return free;}
+
+    //The socket last begun on a port
+    static EthernetUDP *on(uint16_t port) {return sockets()[port];}
+
+    private:
+    Packet _reading;
+    size_t _position = 0;
+    Packet _writing;
+
+    static std::map<uint16_t, EthernetUDP *> &sockets() {static std::map<uint16_t, EthernetUDP *> open; return open;}
+
+    public:
+    void receive(const std::vector<uint8_t> &data, IPAddress ip = IPAddress(10, 0, 0, 1), uint16_t port = 50000) {incoming.push_back({ip, port, data});}
+
+    uint8_t begin(uint16_t port) {
+        if(socketsFree()){sockets()[port] = this;}
+        return socketsFree();
+    }
+    uint8_t beginMulticast(IPAddress, uint16_t port) {return begin(port);}
+
+    int parsePacket() {
+        if(incoming.empty()){return 0;}
+        _reading = incoming.front();
+        incoming.pop_front();
+        _position = 0;
+        return _reading.data.size();
+    }
+    int available() {return _reading.data.size() - _position;}
+    int read(uint8_t *buffer, size_t length) {
+        size_t count = std::min(length, _reading.data.size() - _position);
+        if(count == 0){return -1;}
+        memcpy(buffer, _reading.data.data() + _position, count);
+        _position += count;
+        return count;
+    }
+    int read(char *buffer, size_t length) {return read((uint8_t *)buffer, length);}
+    void flush() {_position = _reading.data.size();}
+    IPAddress remoteIP() {return _reading.ip;}
+    uint16_t remotePort() {return _reading.port;}
+
+    int beginPacket(IPAddress ip, uint16_t port) {_writing = {ip, port, {}}; return 1;}
+    size_t write(const uint8_t *buffer, size_t length) {_writing.data.insert(_writing.data.end(), buffer, buffer + length); return length;}
+    int endPacket() {sent.push_back(_writing); return 1;}
+};
+
+#endif
@@ -0,0 +1,3 @@
+#ifndef SPI_STUB
+#define SPI_STUB
+#endif
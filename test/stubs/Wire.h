@@ -0,0 +1,3 @@
+#ifndef WIRE_STUB
+#define WIRE_STUB
+#endif
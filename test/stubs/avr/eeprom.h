@@ -0,0 +1,29 @@
+//avr-libc EEPROM stand in for the native tests, a 4K array like the Mega's that is never busy
+#ifndef EEPROM_STUB
+#define EEPROM_STUB
+
+#include <stdint.h>
+#include <string.h>
+
+#define E2END 0xFFF
+#define EEPE 1
+#define _BV(bit) (1 << (bit))
+
+namespace stub {
+    inline uint8_t *eeprom() {static uint8_t memory[E2END + 1]; return memory;}
+}
+static uint8_t EECR = 0;
+
+inline uint8_t eeprom_read_byte(const uint8_t *address) {return stub::eeprom()[(uintptr_t)address];}
+inline uint16_t eeprom_read_word(const uint16_t *address) {
+    return eeprom_read_byte((const uint8_t *)address) | eeprom_read_byte((const uint8_t *)address + 1) << 8;
+}
+inline void eeprom_read_block(void *data, const void *address, size_t length) {memcpy(data, stub::eeprom() + (uintptr_t)address, length);}
+inline void eeprom_write_byte(uint8_t *address, uint8_t value) {stub::eeprom()[(uintptr_t)address] = value;}
+inline void eeprom_write_word(uint16_t *address, uint16_t value) {
+    eeprom_write_byte((uint8_t *)address, value);
+    eeprom_write_byte((uint8_t *)address + 1, value >> 8);
+}
+inline void eeprom_busy_wait() {}
+
+#endif
@@ -0,0 +1,12 @@
+//avr-libc program memory stand in for the native tests, flash is just memory on the host
+#ifndef PGMSPACE_STUB
+#define PGMSPACE_STUB
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+#define memcpy_P memcpy
+
+#endif
@@ -0,0 +1,19 @@
+//avr-libc CRC stand in for the native tests, the same sums as the reference versions in its documentation
+#ifndef CRC16_STUB
+#define CRC16_STUB
+
+#include <stdint.h>
+
+inline uint16_t _crc_ccitt_update(uint16_t crc, uint8_t data) {
+    data ^= crc & 0xFF;
+    data ^= data << 4;
+    return (((uint16_t)data << 8) | (crc >> 8)) ^ (uint8_t)(data >> 4) ^ ((uint16_t)data << 3);
+}
+
+inline uint8_t _crc8_ccitt_update(uint8_t crc, uint8_t data) {
+    crc ^= data;
+    for(uint8_t i = 0; i < 8; i++){crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;}
+    return crc;
+}
+
+#endif
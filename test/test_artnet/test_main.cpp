@@ -0,0 +1,120 @@
+//Art-Net input, run on the host with pio test -e native. sACN is in test_sacn, it is the other build of the handler
+
+#include <unity.h>
+#include <vector>
+#include "../../src/controlPanel/dmxHandler.h"
+
+#define UNIVERSE 0x123
+#define START_ADDRESS 500
+
+DmxHandler *dmx;
+EthernetUDP *udp;
+
+//An ArtDmx packet with slots from 1 up, start the slot at START_ADDRESS
+std::vector<uint8_t> artDmx(uint16_t universe, byte sequence, std::vector<uint8_t> start, int slots = 512) {
+    std::vector<uint8_t> packet = {'A', 'r', 't', '-', 'N', 'e', 't', 0, 0x00, 0x50, 0, 14, sequence, 0,
+        (uint8_t)(universe & 0xFF), (uint8_t)(universe >> 8), (uint8_t)(slots >> 8), (uint8_t)slots};
+    std::vector<uint8_t> data(slots, 0x11);
+    for(size_t i = 0; i < start.size() && START_ADDRESS - 1 + i < data.size(); i++){data[START_ADDRESS - 1 + i] = start[i];}
+    packet.insert(packet.end(), data.begin(), data.end());
+    return packet;
+}
+
+bool receive(const std::vector<uint8_t> &packet) {
+    udp->receive(packet);
+    return dmx->process();
+}
+
+void setUp() {
+    stub::clock() = 0;
+    dmx = new DmxHandler(UNIVERSE, START_ADDRESS);
+    TEST_ASSERT_TRUE(dmx->begin());
+    udp = EthernetUDP::on(DMX_ARTNET_PORT);
+}
+
+void tearDown() {
+    delete dmx;
+}
+
+void test_channels() {
+    TEST_ASSERT_TRUE(receive(artDmx(UNIVERSE, 1, {0x12, 0x34, 0xFF, 0x01, 0, 200, 150})));
+    TEST_ASSERT_EQUAL_HEX16(0x1234, dmx->pan());
+    TEST_ASSERT_EQUAL_HEX16(0xFF01, dmx->tilt());
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 100.0, dmx->speed());
+    TEST_ASSERT_EQUAL(200, dmx->channel(DmxHandler::Zoom));
+    TEST_ASSERT_EQUAL(150, dmx->channel(DmxHandler::Focus));
+    TEST_ASSERT_EQUAL(1, dmx->frames());
+}
+
+//A short universe only sets the channels it has, the rest keep their last values
+void test_short_universe() {
+    receive(artDmx(UNIVERSE, 1, {1, 2, 3, 4, 5, 6, 7}));
+    TEST_ASSERT_TRUE(receive(artDmx(UNIVERSE, 2, {9, 9, 9}, START_ADDRESS + 2)));
+    TEST_ASSERT_EQUAL_HEX16(0x0909, dmx->pan());
+    TEST_ASSERT_EQUAL_HEX16(0x0904, dmx->tilt());
+    TEST_ASSERT_EQUAL(7, dmx->channel(DmxHandler::Focus));
+    receive(artDmx(UNIVERSE, 3, {}, START_ADDRESS - 1));
+    TEST_ASSERT_EQUAL_HEX16(0x0909, dmx->pan());
+}
+
+void test_header_checks() {
+    TEST_ASSERT_FALSE(receive(artDmx(UNIVERSE + 1, 1, {1})));
+    //The top bit of the net byte isn't part of the port address
+    TEST_ASSERT_TRUE(receive(artDmx(UNIVERSE | 0x8000, 1, {1})));
+
+    std::vector<uint8_t> packet = artDmx(UNIVERSE, 2, {1});
+    packet[7] = '!';
+    TEST_ASSERT_FALSE(receive(packet));
+    packet = artDmx(UNIVERSE, 2, {1});
+    packet[9] = 0x20;   //OpPoll
+    TEST_ASSERT_FALSE(receive(packet));
+    packet = artDmx(UNIVERSE, 2, {1});
+    packet[11] = 13;
+    TEST_ASSERT_FALSE(receive(packet));
+    packet.resize(DMX_ARTNET_HEADER_SIZE - 1);
+    TEST_ASSERT_FALSE(receive(packet));
+    TEST_ASSERT_EQUAL(1, dmx->frames());
+}
+
+//Late packets are dropped, a big jump back is a restarted console and sequence 0 is never checked
+void test_sequence() {
+    TEST_ASSERT_TRUE(receive(artDmx(UNIVERSE, 100, {1})));
+    TEST_ASSERT_FALSE(receive(artDmx(UNIVERSE, 99, {2})));
+    TEST_ASSERT_FALSE(receive(artDmx(UNIVERSE, 100, {2})));
+    TEST_ASSERT_EQUAL(1, dmx->channel(DmxHandler::PanCoarse));
+    TEST_ASSERT_TRUE(receive(artDmx(UNIVERSE, 101, {3})));
+    TEST_ASSERT_TRUE(receive(artDmx(UNIVERSE, 30, {4})));
+    TEST_ASSERT_TRUE(receive(artDmx(UNIVERSE, 0, {5})));
+    TEST_ASSERT_TRUE(receive(artDmx(UNIVERSE, 0, {6})));
+    TEST_ASSERT_EQUAL(6, dmx->channel(DmxHandler::PanCoarse));
+}
+
+//Only the latest of the waiting packets counts, the interval is averaged from the frames
+void test_interval() {
+    udp->receive(artDmx(UNIVERSE, 1, {1}));
+    udp->receive(artDmx(UNIVERSE, 2, {2}));
+    TEST_ASSERT_TRUE(dmx->process());
+    TEST_ASSERT_EQUAL(2, dmx->channel(DmxHandler::PanCoarse));
+    TEST_ASSERT_EQUAL(1, dmx->frames());
+    TEST_ASSERT_EQUAL(DMX_DEFAULT_INTERVAL, dmx->interval());
+    for(byte sequence = 3; sequence < 40; sequence++) {
+        delay(40);
+        receive(artDmx(UNIVERSE, sequence, {sequence}));
+    }
+    //The average rounds down so it settles a little under
+    TEST_ASSERT_TRUE(dmx->interval() > 40 - 4 && dmx->interval() <= 40);
+    TEST_ASSERT_TRUE(dmx->receiving(1000));
+    delay(1000);
+    TEST_ASSERT_FALSE(dmx->receiving(1000));
+    TEST_ASSERT_EQUAL(DMX_DEFAULT_INTERVAL, dmx->interval());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_channels);
+    RUN_TEST(test_short_universe);
+    RUN_TEST(test_header_checks);
+    RUN_TEST(test_sequence);
+    RUN_TEST(test_interval);
+    return UNITY_END();
+}
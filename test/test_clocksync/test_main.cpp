@@ -0,0 +1,113 @@
+//Clock sync against a simulated show controller, run on the host with pio test -e native
+
+#include <unity.h>
+#include "../../src/controlPanel/clockSync.h"
+
+ClockSync *clockSync;
+uint32_t serverOffset;  //Server clock - our clock
+double serverRate;      //Server us per one of ours
+
+uint32_t serverAt(uint32_t local) {return local + serverOffset + (int32_t)((double)local * (serverRate - 1.0));}
+
+//One exchange with the given one way delays (us) and time the server holds the request
+bool exchange(uint32_t outbound, uint32_t inbound, uint32_t hold = 50) {
+    uint32_t t1 = clockSync->request();
+    uint32_t t2 = serverAt(t1 + outbound);
+    uint32_t t3 = serverAt(t1 + outbound + hold);
+    stub::clock() += outbound + hold + inbound;
+    return clockSync->response(t1, t2, t3, micros());
+}
+
+//How far toLocal() is from when the server's clock really reads serverTime (us)
+int32_t toLocalError(uint32_t serverTime) {
+    uint32_t local = clockSync->toLocal(serverTime);
+    return (int32_t)(serverTime - serverAt(local));
+}
+
+void setUp() {
+    stub::clock() = 1000000;
+    serverOffset = 0;
+    serverRate = 1.0;
+    clockSync = new ClockSync();
+}
+
+void tearDown() {
+    delete clockSync;
+}
+
+//The clocks are free running so they can be any distance apart, including past half the 32 bit range
+void test_any_offset() {
+    uint32_t offsets[] = {0, 12345, (uint32_t)-12345, 0x40000000, 0x60000000, 0x80000001, 0xA0000000, 0xFFFFFF00};
+    for(uint32_t offset : offsets) {
+        delete clockSync;
+        clockSync = new ClockSync();
+        serverOffset = offset;
+        TEST_ASSERT_TRUE(exchange(300, 300));
+        TEST_ASSERT_TRUE(clockSync->synced());
+        TEST_ASSERT_EQUAL(300, clockSync->accuracy());
+        TEST_ASSERT_EQUAL(0, toLocalError(serverAt(micros()) + 2000000));
+        TEST_ASSERT_EQUAL_HEX32(serverAt(micros()), clockSync->now());
+    }
+}
+
+//Uneven delays put the offset out by half the difference, never more than the accuracy reported
+void test_asymmetric_delay() {
+    serverOffset = 0xC0000000;
+    exchange(100, 900);
+    TEST_ASSERT_EQUAL(500, clockSync->accuracy());
+    int32_t error = toLocalError(serverAt(micros()) + 1000);
+    TEST_ASSERT_EQUAL(400, error < 0 ? -error : error);
+}
+
+//The exchange with the least delay is trusted
+void test_least_delay_trusted() {
+    serverOffset = 0x90000000;
+    exchange(2000, 5000);
+    exchange(150, 150);
+    exchange(3000, 100);
+    TEST_ASSERT_EQUAL(150, clockSync->accuracy());
+    TEST_ASSERT_EQUAL(0, toLocalError(serverAt(micros())));
+}
+
+//Our micros() wrapping doesn't upset the offset
+void test_local_wrap() {
+    serverOffset = 0x7FFFFFFF;
+    stub::clock() = 0xFFFFFF00;
+    exchange(200, 200);
+    stub::clock() = 0x100000100ULL;
+    TEST_ASSERT_EQUAL(0, toLocalError(serverAt((uint32_t)micros()) + 500));
+}
+
+//A server clock running fast is followed once the drift has been measured
+void test_drift() {
+    serverOffset = 0xB0000000;
+    serverRate = 1.0001;
+    //Every exchange takes as long so a trusted sample is only replaced when it drops out of the last CLOCK_SYNC_SAMPLES
+    for(int i = 0; i < CLOCK_SYNC_SAMPLES * 5 + 1; i++) {
+        exchange(200, 200);
+        stub::clock() += 10000000;
+    }
+    TEST_ASSERT_FLOAT_WITHIN(10.0, 100.0, clockSync->driftPpm());
+    //Ten seconds on from the last sample 100ppm would be a ms out without the drift
+    int32_t error = toLocalError(serverAt(micros()) + 10000000);
+    TEST_ASSERT_TRUE(error < 200 && error > -200);
+}
+
+void test_stale_reply_ignored() {
+    uint32_t t1 = clockSync->request();
+    stub::clock() += 1000;
+    clockSync->request();
+    TEST_ASSERT_FALSE(clockSync->response(t1, t1, t1, t1 + 100));
+    TEST_ASSERT_FALSE(clockSync->synced());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_any_offset);
+    RUN_TEST(test_asymmetric_delay);
+    RUN_TEST(test_least_delay_trusted);
+    RUN_TEST(test_local_wrap);
+    RUN_TEST(test_drift);
+    RUN_TEST(test_stale_reply_ignored);
+    return UNITY_END();
+}
@@ -0,0 +1,96 @@
+//FreeD D1 packets and their schedule, run on the host with pio test -e native
+
+#include <unity.h>
+#include "../../src/controlPanel/freeD.h"
+
+int32_t get24(const byte *buffer) {
+    int32_t value = (int32_t)buffer[0] << 16 | (int32_t)buffer[1] << 8 | buffer[2];
+    return value & 0x800000 ? value - 0x1000000 : value;
+}
+
+//The checksum makes every byte of the packet add up to 0x40
+bool checksumOk(const byte packet[FREED_PACKET_SIZE]) {
+    byte sum = 0;
+    for(byte i = 0; i < FREED_PACKET_SIZE; i++){sum += packet[i];}
+    return sum == 0x40;
+}
+
+void setUp() {
+    stub::clock() = 0;
+}
+
+void tearDown() {}
+
+void test_fields() {
+    FreeD freeD(5, 50);
+    byte packet[FREED_PACKET_SIZE];
+    memset(packet, 0xEE, sizeof(packet));
+    freeD.build(packet, 90.5, -12.25, 0x123456, -2);
+
+    TEST_ASSERT_EQUAL_HEX8(FREED_D1, packet[0]);
+    TEST_ASSERT_EQUAL(5, packet[1]);
+    TEST_ASSERT_EQUAL(90.5 * 32768, get24(packet + 2));
+    TEST_ASSERT_EQUAL(-12.25 * 32768, get24(packet + 5));
+    //Roll, X, Y and height
+    for(byte i = 8; i < 20; i++){TEST_ASSERT_EQUAL(0, packet[i]);}
+    TEST_ASSERT_EQUAL(0x123456, get24(packet + 20));
+    TEST_ASSERT_EQUAL(-2, get24(packet + 23));
+    TEST_ASSERT_EQUAL(0, packet[26]);
+    TEST_ASSERT_EQUAL(0, packet[27]);
+    TEST_ASSERT_TRUE(checksumOk(packet));
+}
+
+//Angles are kept to +-255 degrees so they don't wrap into the sign bit
+void test_angle_limits() {
+    FreeD freeD(1, 50);
+    byte packet[FREED_PACKET_SIZE];
+    freeD.build(packet, 400, -400, 0, 0);
+    TEST_ASSERT_EQUAL(255 * 32768, get24(packet + 2));
+    TEST_ASSERT_EQUAL(-255 * 32768, get24(packet + 5));
+    TEST_ASSERT_TRUE(checksumOk(packet));
+}
+
+void test_checksum() {
+    FreeD freeD(255, 50);
+    byte packet[FREED_PACKET_SIZE];
+    for(int i = 0; i < 100; i++) {
+        freeD.build(packet, i * 3.7 - 180, i * -1.3, i * 1000, -i * 77);
+        TEST_ASSERT_TRUE(checksumOk(packet));
+    }
+    //0x40 - 0xD1 - 0xFF with everything else zero
+    freeD.build(packet, 0, 0, 0, 0);
+    TEST_ASSERT_EQUAL_HEX8(0x70, packet[FREED_PACKET_SIZE - 1]);
+}
+
+//Packets are due every period, ones that were missed are counted and the schedule starts again
+void test_schedule() {
+    FreeD freeD(1, 100);
+    TEST_ASSERT_TRUE(freeD.due());
+    freeD.sent();
+    TEST_ASSERT_FALSE(freeD.due());
+    stub::clock() = 9999;
+    TEST_ASSERT_FALSE(freeD.due());
+    stub::clock() = 10000;
+    TEST_ASSERT_TRUE(freeD.due());
+    stub::clock() = 10500;
+    freeD.sent();
+    TEST_ASSERT_EQUAL(0, freeD.packetsDropped());
+
+    stub::clock() = 45000;
+    TEST_ASSERT_TRUE(freeD.due());
+    freeD.sent();
+    TEST_ASSERT_EQUAL(3, freeD.packetsSent());
+    TEST_ASSERT_EQUAL(2, freeD.packetsDropped());
+    TEST_ASSERT_FALSE(freeD.due());
+    stub::clock() = 55000;
+    TEST_ASSERT_TRUE(freeD.due());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_fields);
+    RUN_TEST(test_angle_limits);
+    RUN_TEST(test_checksum);
+    RUN_TEST(test_schedule);
+    return UNITY_END();
+}
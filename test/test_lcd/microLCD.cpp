@@ -0,0 +1,2 @@
+//The MicroLCD driver built for the host, it talks to the fake AsyncTwi in test_main.cpp
+#include "../../src/controlPanel/MicroLCD/MicroLCD.cpp"
@@ -0,0 +1,2 @@
+//SSD1306.h has no include guard so the driver's other half is built on its own
+#include "../../src/controlPanel/MicroLCD/SSD1306.cpp"
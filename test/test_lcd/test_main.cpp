@@ -0,0 +1,210 @@
+//LCD framebuffer, run on the host with pio test -e native. The MicroLCD driver is built as it is and the I2C
+//transmissions are played into a model of the SSD1306's memory. What the framebuffer puts on the panel is checked
+//against MicroLCD drawing the same lines a character at a time, the way the panel was drawn before the framebuffer
+
+#include <unity.h>
+
+#define LCD_FRAMEBUFFER
+#include "../../src/controlPanel/lcd.h"
+
+#define TEST_ADDRESS 0x3C
+#define REFERENCE_ADDRESS 0x3D
+
+//The display memory of an SSD1306 in page addressing mode
+struct Panel {
+    uint8_t pixels[SSD1306_LCDHEIGHT / 8][SSD1306_LCDWIDTH];
+    uint8_t page;
+    uint8_t column;
+
+    void transmission(const uint8_t *data, uint8_t length) {
+        if(length == 0){return;}
+        //Control byte 0x00 is followed by commands, 0x40 by data
+        if(data[0] == 0x40) {
+            for(uint8_t i = 1; i < length; i++) {
+                pixels[page][column] = data[i];
+                column = (column + 1) % SSD1306_LCDWIDTH;
+            }
+            return;
+        }
+        for(uint8_t i = 1; i < length; i++) {
+            if(data[i] >= 0xB0 && data[i] < 0xB0 + SSD1306_LCDHEIGHT / 8){page = data[i] - 0xB0;}
+            else if(data[i] < 0x10){column = (column & 0xF0) | data[i];}
+            else if(data[i] < 0x20){column = (column & 0x0F) | (data[i] - 0x10) << 4;}
+        }
+    }
+};
+
+Panel panels[2];
+uint8_t queueLimit = 128;
+
+Panel &panel(uint8_t address) {return panels[address == TEST_ADDRESS ? 0 : 1];}
+
+//AsyncTwi that hands each transmission straight to the panel. queueFree() reports queueLimit, as if the queue drained
+//between calls
+uint8_t twiAddress;
+uint8_t twiBuffer[ASYNC_TWI_MAX_TRANSMISSION];
+uint8_t twiLength;
+uint32_t twiBytes;
+void AsyncTwiClass::begin() {}
+void AsyncTwiClass::setClock(uint32_t) {}
+void AsyncTwiClass::beginTransmission(uint8_t address) {twiAddress = address; twiLength = 0;}
+size_t AsyncTwiClass::write(uint8_t data) {
+    TEST_ASSERT_TRUE_MESSAGE(twiLength < ASYNC_TWI_MAX_TRANSMISSION, "Transmission longer than AsyncTwi takes");
+    twiBuffer[twiLength++] = data;
+    return 1;
+}
+size_t AsyncTwiClass::write(const uint8_t *data, size_t length) {
+    for(size_t i = 0; i < length; i++){write(data[i]);}
+    return length;
+}
+uint8_t AsyncTwiClass::endTransmission() {
+    panel(twiAddress).transmission(twiBuffer, twiLength);
+    twiBytes += twiLength + 2;
+    return 0;
+}
+bool AsyncTwiClass::isBusy() {return false;}
+void AsyncTwiClass::flush() {}
+uint8_t AsyncTwiClass::queueFree() {return queueLimit;}
+uint16_t AsyncTwiClass::errorCount() {return 0;}
+uint32_t AsyncTwiClass::bytesSent() {return twiBytes;}
+AsyncTwiClass AsyncTwi;
+
+LCD *lcd;
+LCD_SSD1306 reference;
+char lines[4][LCD_LINE_LENGTH];
+int fonts[4];
+
+//Draw the lines the way LCD::update() does without the framebuffer, a character at a time from column 10
+void drawReference() {
+    memset(panel(REFERENCE_ADDRESS).pixels, 0, sizeof(Panel::pixels));
+    byte page = 0;
+    for(int line = 0; line < 4; line++) {
+        reference.setFontSize((FONT_SIZE)fonts[line]);
+        reference.setCursor(10, page);
+        for(const char *c = lines[line]; *c != 0; c++){reference.write((uint8_t)*c);}
+        page += fonts[line] == FONT_SIZE_SMALL ? 1 : 2;
+    }
+}
+
+void checkPanel() {
+    drawReference();
+    for(int page = 0; page < SSD1306_LCDHEIGHT / 8; page++) {
+        char message[32];
+        snprintf(message, sizeof(message), "Page %d", page);
+        TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(panel(REFERENCE_ADDRESS).pixels[page], panel(TEST_ADDRESS).pixels[page], SSD1306_LCDWIDTH, message);
+    }
+}
+
+//New random text for every line, short enough to fit from column 10 so MicroLCD doesn't wrap it. Sometimes the fonts
+//change too, which moves the lines, and the panel is cleared first like the dashboard does when it changes page
+void randomLines() {
+    if(rand() % 3 == 0) {
+        lcd->clear();
+        for(int line = 0; line < 4; line++){fonts[line] = rand() % 4;}
+    }
+    for(int line = 0; line < 4; line++) {
+        int maximum = fonts[line] == FONT_SIZE_SMALL ? (SSD1306_LCDWIDTH - 10) / 6 : (SSD1306_LCDWIDTH - 10) / 9;
+        int length = rand() % (maximum + 1);
+        for(int i = 0; i < length; i++){lines[line][i] = rand() % 4 == 0 ? ' ' : 0x21 + rand() % (0x7f - 0x21);}
+        lines[line][length] = 0;
+        lcd->setLine(line, lines[line], fonts[line]);
+    }
+}
+
+void setUp() {
+    srand(1);
+    queueLimit = 128;
+    lcd = new LCD(TEST_ADDRESS);
+    lcd->initalize();
+    reference.begin(SSD1306_SWITCHCAPVCC, REFERENCE_ADDRESS);
+    for(int line = 0; line < 4; line++) {
+        lines[line][0] = 0;
+        fonts[line] = FONT_SIZE_MEDIUM;
+    }
+}
+
+void tearDown() {
+    delete lcd;
+}
+
+//Every update() leaves the panel as MicroLCD would have drawn it
+void test_update_matches_microlcd() {
+    for(int i = 0; i < 200; i++) {
+        randomLines();
+        while(lcd->update());
+        checkPanel();
+    }
+}
+
+//Flushing in slices with small budgets and a nearly full AsyncTwi queue ends up the same
+void test_budgeted_refresh_matches_microlcd() {
+    for(int i = 0; i < 100; i++) {
+        randomLines();
+        for(int call = 0; call < 1000; call++) {
+            queueLimit = 10 + rand() % 60;
+            lcd->refresh(rand() % 1000);
+        }
+        TEST_ASSERT_FALSE(lcd->refresh(0));
+        checkPanel();
+    }
+}
+
+//A refresh never queues more than AsyncTwi has room for
+void test_refresh_keeps_to_queue() {
+    for(int i = 0; i < 20; i++) {
+        randomLines();
+        for(int call = 0; call < 400; call++) {
+            queueLimit = rand() % 40;
+            uint32_t before = twiBytes;
+            lcd->refresh(5000);
+            TEST_ASSERT_TRUE(twiBytes - before <= queueLimit);
+        }
+    }
+}
+
+//MicroLCD's run path, used when built without the framebuffer, draws text the same as a character at a time. That
+//includes line breaks, fonts without a run path and medium text that wraps. Small text is kept off the end of the
+//row, a character at a time it wraps onto the start of the same page where a run moves down a row
+void test_runs_match_characters() {
+    LCD_SSD1306 runs;
+    runs.begin(SSD1306_SWITCHCAPVCC, TEST_ADDRESS);
+    for(int i = 0; i < 200; i++) {
+        char text[48];
+        FONT_SIZE font = (FONT_SIZE)(rand() % 4);
+        byte column = rand() % SSD1306_LCDWIDTH;
+        byte page = rand() % 2;
+        int length = rand() % sizeof(text);
+        if(font == FONT_SIZE_SMALL){length = min(length, (SSD1306_LCDWIDTH - column) / 6);}
+        for(int c = 0; c < length; c++){text[c] = rand() % 16 == 0 ? '\n' : 0x20 + rand() % (0x7f - 0x20);}
+
+        memset(panel(TEST_ADDRESS).pixels, 0, sizeof(Panel::pixels));
+        memset(panel(REFERENCE_ADDRESS).pixels, 0, sizeof(Panel::pixels));
+        runs.setFontSize(font);
+        runs.setCursor(column, page);
+        runs.write((const uint8_t *)text, length);
+        reference.setFontSize(font);
+        reference.setCursor(column, page);
+        for(int c = 0; c < length; c++){reference.write((uint8_t)text[c]);}
+        for(int p = 0; p < SSD1306_LCDHEIGHT / 8; p++) {
+            TEST_ASSERT_EQUAL_HEX8_ARRAY(panel(REFERENCE_ADDRESS).pixels[p], panel(TEST_ADDRESS).pixels[p], SSD1306_LCDWIDTH);
+        }
+    }
+}
+
+//Lines that would run off the bottom of the panel aren't drawn
+void test_off_the_bottom() {
+    LCDFrameBuffer frameBuffer;
+    TEST_ASSERT_TRUE(frameBuffer.drawLine(SSD1306_LCDHEIGHT / 8 - 2, 2, 0, "Fits", FONT_SIZE_MEDIUM));
+    TEST_ASSERT_FALSE(frameBuffer.drawLine(SSD1306_LCDHEIGHT / 8 - 1, 2, 0, "Off", FONT_SIZE_MEDIUM));
+    TEST_ASSERT_FALSE(frameBuffer.drawLine(0, 1, SSD1306_LCDWIDTH, "Off", FONT_SIZE_SMALL));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_update_matches_microlcd);
+    RUN_TEST(test_budgeted_refresh_matches_microlcd);
+    RUN_TEST(test_refresh_keeps_to_queue);
+    RUN_TEST(test_runs_match_characters);
+    RUN_TEST(test_off_the_bottom);
+    return UNITY_END();
+}
@@ -0,0 +1,156 @@
+//Link receive buffer under bursts, run on the host with pio test -e native. The 328P's timer 1 is stood in for by
+//plain variables and the line is played into the receive interrupts edge by edge, as the input capture would see it
+
+#include <unity.h>
+#include <Arduino.h>
+#include <vector>
+
+#define __AVR_ATmega328P__
+#define F_CPU 16000000UL
+#define ALTSS_RX_BUFFER_SIZE 128
+
+volatile uint8_t SREG, TCCR1A, TCCR1B, TIMSK1, TIFR1;
+volatile uint16_t TCNT1, ICR1, OCR1A, OCR1B;
+#define ICNC1 7
+#define ICES1 6
+#define CS12 2
+#define CS11 1
+#define CS10 0
+#define COM1A1 7
+#define COM1A0 6
+#define ICF1 5
+#define ICIE1 5
+#define OCF1B 2
+#define OCIE1B 2
+#define OCF1A 1
+#define OCIE1A 1
+#define cli()
+#define ISR(vector) void vector()
+
+#include "../../src/lancController/AltSoftSerial/AltSoftSerial.cpp"
+
+#define BAUD 9600
+#define TICKS_PER_BIT ((F_CPU + BAUD / 2) / BAUD)
+
+AltSoftSerial link;
+unsigned long now;      //Timer ticks since the start, TCNT1 is the bottom 16 bits
+unsigned long stopAt;   //When compare B fires if it is enabled
+
+//Run the receive interrupts up to time, taking an edge on the line there if edge is set. Like the input capture
+//only the edge the interrupt is waiting for is seen
+void advance(unsigned long time, bool edge, bool rising = false) {
+    if((TIMSK1 & (1 << OCIE1B)) && stopAt <= time) {
+        now = stopAt;
+        TCNT1 = now;
+        TIMER1_COMPB_vect();
+    }
+    now = time;
+    TCNT1 = now;
+    if(!edge || rising != (bool)(TCCR1B & (1 << ICES1))){return;}
+    ICR1 = now;
+    bool compareB = TIMSK1 & (1 << OCIE1B);
+    TIMER1_CAPT_vect();
+    if(!compareB && (TIMSK1 & (1 << OCIE1B))){stopAt = now + (uint16_t)(OCR1B - (uint16_t)now);}
+}
+
+//Play bytes onto the line back to back, with a low stop bit for the ones in badStop, then let the line idle
+void send(const std::vector<uint8_t> &bytes, const std::vector<bool> &badStop = {}) {
+    bool level = true;
+    unsigned long time = now + TICKS_PER_BIT * 2;
+    for(size_t i = 0; i < bytes.size(); i++) {
+        bool stop = i >= badStop.size() || !badStop[i];
+        bool bits[10] = {false};
+        for(int b = 0; b < 8; b++){bits[b + 1] = bytes[i] >> b & 1;}
+        bits[9] = stop;
+        for(int b = 0; b < 10; b++) {
+            if(bits[b] != level) {
+                advance(time, true, bits[b]);
+                level = bits[b];
+            }
+            time += TICKS_PER_BIT;
+        }
+    }
+    if(!level) {
+        advance(time, true, true);
+        time += TICKS_PER_BIT;
+    }
+    advance(time + TICKS_PER_BIT * 20, false);
+}
+
+void setUp() {
+    now = 0;
+    link.begin(BAUD);
+}
+
+void tearDown() {}
+
+void test_bytes_arrive_intact() {
+    std::vector<uint8_t> bytes;
+    for(int i = 0; i < 100; i++){bytes.push_back(i * 37 + 5);}
+    send(bytes);
+    TEST_ASSERT_EQUAL(100, link.available());
+    for(int i = 0; i < 100; i++){TEST_ASSERT_EQUAL_HEX8(bytes[i], link.read());}
+    TEST_ASSERT_EQUAL(-1, link.read());
+    TEST_ASSERT_EQUAL(0, link.rxOverflowCount());
+    TEST_ASSERT_EQUAL(0, link.framingErrorCount());
+    TEST_ASSERT_EQUAL(100, link.rxBufferPeak());
+}
+
+//A burst bigger than the buffer keeps the first ALTSS_RX_BUFFER_SIZE - 1 bytes and counts the rest
+void test_overflow() {
+    std::vector<uint8_t> bytes;
+    for(int i = 0; i < 200; i++){bytes.push_back(i);}
+    send(bytes);
+    TEST_ASSERT_EQUAL(ALTSS_RX_BUFFER_SIZE - 1, link.available());
+    TEST_ASSERT_EQUAL(200 - (ALTSS_RX_BUFFER_SIZE - 1), link.rxOverflowCount());
+    TEST_ASSERT_EQUAL(ALTSS_RX_BUFFER_SIZE - 1, link.rxBufferPeak());
+    for(int i = 0; i < ALTSS_RX_BUFFER_SIZE - 1; i++){TEST_ASSERT_EQUAL(i, link.read());}
+
+    //Reading makes room again, the peak stays until cleared
+    send({0xAA, 0x55});
+    TEST_ASSERT_EQUAL(2, link.available());
+    TEST_ASSERT_EQUAL(200 - (ALTSS_RX_BUFFER_SIZE - 1), link.rxOverflowCount());
+    TEST_ASSERT_EQUAL(ALTSS_RX_BUFFER_SIZE - 1, link.rxBufferPeak());
+    link.clearStatistics();
+    TEST_ASSERT_EQUAL(0, link.rxOverflowCount());
+    TEST_ASSERT_EQUAL(0, link.rxBufferPeak());
+}
+
+//Bursts read between each other only fill the buffer as far as the biggest burst
+void test_peak_fill() {
+    for(int burst = 1; burst <= 5; burst++) {
+        std::vector<uint8_t> bytes(burst * 10, 0x42);
+        send(bytes);
+        while(link.read() >= 0) {}
+    }
+    send(std::vector<uint8_t>(20, 0x42));
+    TEST_ASSERT_EQUAL(50, link.rxBufferPeak());
+    TEST_ASSERT_EQUAL(0, link.rxOverflowCount());
+}
+
+//A byte whose stop bit is low is still stored but counted, whether the stop bit starts with an edge (caught by the
+//capture) or not (caught by the stop bit sample). A low stop bit swallows the next start bit so each goes on its own
+void test_framing_errors() {
+    send({0x80}, {true});
+    TEST_ASSERT_EQUAL(1, link.framingErrorCount());
+    send({0x12}, {true});
+    TEST_ASSERT_EQUAL(2, link.framingErrorCount());
+    send({0x34, 0xC3});
+    TEST_ASSERT_EQUAL(2, link.framingErrorCount());
+    TEST_ASSERT_EQUAL(0x80, link.read());
+    TEST_ASSERT_EQUAL(0x12, link.read());
+    TEST_ASSERT_EQUAL(0x34, link.read());
+    TEST_ASSERT_EQUAL(0xC3, link.read());
+
+    link.clearStatistics();
+    TEST_ASSERT_EQUAL(0, link.framingErrorCount());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_bytes_arrive_intact);
+    RUN_TEST(test_overflow);
+    RUN_TEST(test_peak_fill);
+    RUN_TEST(test_framing_errors);
+    return UNITY_END();
+}
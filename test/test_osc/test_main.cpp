@@ -0,0 +1,224 @@
+//OSC pattern matching and message parsing, run on the host with pio test -e native
+
+#include <unity.h>
+#include <vector>
+#include "../../src/controlPanel/oscHandler.h"
+
+#define PORT 8000
+#define ID 2
+
+OscHandler *osc;
+EthernetUDP *udp;
+
+//Append a string padded to 4 bytes with at least one null
+void putString(std::vector<uint8_t> &packet, const char *text) {
+    size_t length = strlen(text);
+    packet.insert(packet.end(), text, text + length);
+    packet.insert(packet.end(), 4 - length % 4, 0);
+}
+
+void put32(std::vector<uint8_t> &packet, uint32_t value) {
+    for(int i = 3; i >= 0; i--){packet.push_back(value >> (i * 8));}
+}
+
+void putFloat(std::vector<uint8_t> &packet, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, 4);
+    put32(packet, bits);
+}
+
+//A message with only int and float arguments, types like ",fi"
+std::vector<uint8_t> message(const char *address, const char *types = nullptr, std::vector<float> arguments = {}) {
+    std::vector<uint8_t> packet;
+    putString(packet, address);
+    if(types == nullptr){return packet;}
+    putString(packet, types);
+    for(size_t i = 0; i < arguments.size(); i++) {
+        if(types[i + 1] == 'f'){putFloat(packet, arguments[i]);}
+        else {put32(packet, (int32_t)arguments[i]);}
+    }
+    return packet;
+}
+
+//Every address the packet matches, in the order process() gives them
+std::vector<OscHandler::Address> receive(const std::vector<uint8_t> &packet) {
+    udp->receive(packet);
+    std::vector<OscHandler::Address> matched;
+    while(osc->process()){matched.push_back(osc->address());}
+    return matched;
+}
+
+void setUp() {
+    osc = new OscHandler(PORT, ID);
+    TEST_ASSERT_TRUE(osc->begin());
+    udp = EthernetUDP::on(PORT);
+}
+
+void tearDown() {
+    delete osc;
+}
+
+void test_match_plain() {
+    TEST_ASSERT_TRUE(OscHandler::match("/jib/2/stop", "/jib/2/stop"));
+    TEST_ASSERT_FALSE(OscHandler::match("/jib/2/stop", "/jib/2/sto"));
+    TEST_ASSERT_FALSE(OscHandler::match("/jib/2/sto", "/jib/2/stop"));
+    TEST_ASSERT_FALSE(OscHandler::match("/jib/2", "/jib/2/stop"));
+    TEST_ASSERT_FALSE(OscHandler::match("/jib/2/stop/", "/jib/2/stop"));
+}
+
+void test_match_wildcards() {
+    TEST_ASSERT_TRUE(OscHandler::match("/jib/?/stop", "/jib/2/stop"));
+    TEST_ASSERT_FALSE(OscHandler::match("/jib/?/stop", "/jib/12/stop"));
+    TEST_ASSERT_TRUE(OscHandler::match("/jib/*/stop", "/jib/12/stop"));
+    TEST_ASSERT_TRUE(OscHandler::match("/jib/2/*", "/jib/2/stop"));
+    TEST_ASSERT_TRUE(OscHandler::match("/jib/2/s*p", "/jib/2/stop"));
+    TEST_ASSERT_TRUE(OscHandler::match("/jib/2/*o*o*", "/jib/2/autofocus"));
+    TEST_ASSERT_FALSE(OscHandler::match("/jib/2/*o*o*o*", "/jib/2/autofocus"));
+    TEST_ASSERT_TRUE(OscHandler::match("/jib/[0-3]/stop", "/jib/2/stop"));
+    TEST_ASSERT_FALSE(OscHandler::match("/jib/[3-9]/stop", "/jib/2/stop"));
+    TEST_ASSERT_TRUE(OscHandler::match("/jib/[!3-9]/stop", "/jib/2/stop"));
+    TEST_ASSERT_TRUE(OscHandler::match("/jib/[123]/stop", "/jib/2/stop"));
+    TEST_ASSERT_TRUE(OscHandler::match("/jib/{0,2}/stop", "/jib/2/stop"));
+    TEST_ASSERT_FALSE(OscHandler::match("/jib/{0,1}/stop", "/jib/2/stop"));
+    TEST_ASSERT_TRUE(OscHandler::match("/jib/2/{pan,tilt}/speed", "/jib/2/tilt/speed"));
+    TEST_ASSERT_FALSE(OscHandler::match("/jib/2/{pan,tilt}/speed", "/jib/2/pantilt/speed"));
+    TEST_ASSERT_TRUE(OscHandler::match("/jib/2/{pan,}tilt/speed", "/jib/2/tilt/speed"));
+}
+
+//* and ? stay within a part, and a part too long for the matcher matches nothing
+void test_match_parts() {
+    TEST_ASSERT_FALSE(OscHandler::match("/jib/*", "/jib/2/stop"));
+    TEST_ASSERT_FALSE(OscHandler::match("/jib*stop", "/jib/2/stop"));
+    TEST_ASSERT_TRUE(OscHandler::match("/*/*/*", "/jib/2/stop"));
+    char longPart[OSC_PATTERN_PART_SIZE + 8] = "/jib/2/";
+    memset(longPart + 7, '*', OSC_PATTERN_PART_SIZE);
+    TEST_ASSERT_FALSE(OscHandler::match(longPart, "/jib/2/stop"));
+    longPart[7 + OSC_PATTERN_PART_SIZE - 1] = 0;
+    TEST_ASSERT_TRUE(OscHandler::match(longPart, "/jib/2/stop"));
+}
+
+void test_arguments() {
+    std::vector<OscHandler::Address> matched = receive(message("/jib/2/pantilt/speed", ",fi", {0.25, -40}));
+    TEST_ASSERT_EQUAL(1, matched.size());
+    TEST_ASSERT_EQUAL(OscHandler::PanTiltSpeed, matched[0]);
+    TEST_ASSERT_EQUAL(2, osc->argumentCount());
+    TEST_ASSERT_TRUE(osc->isFloat(0));
+    TEST_ASSERT_FALSE(osc->isFloat(1));
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 25.0, osc->percent(0));
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, -40.0, osc->percent(1));
+    TEST_ASSERT_EQUAL(-40, osc->intArgument(1));
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 0.0, osc->argument(2));
+}
+
+//Strings, blobs and 64 bit arguments are stepped over, T and F are ints
+void test_skipped_types() {
+    std::vector<uint8_t> packet;
+    putString(packet, "/jib/2/position");
+    putString(packet, ",sbhTfF");
+    putString(packet, "hello");
+    put32(packet, 5);
+    packet.insert(packet.end(), 8, 0xAA);
+    put32(packet, 0x01020304);
+    put32(packet, 0x05060708);
+    putFloat(packet, 0.75);
+    TEST_ASSERT_EQUAL(1, receive(packet).size());
+    TEST_ASSERT_EQUAL(OSC_MAX_ARGUMENTS, osc->argumentCount());
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 0.0, osc->argument(0));
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 1.0, osc->argument(3));
+}
+
+void test_buttons() {
+    receive(message("/jib/2/stop"));
+    TEST_ASSERT_TRUE(osc->triggered());
+    receive(message("/jib/2/stop", ",i", {1}));
+    TEST_ASSERT_TRUE(osc->triggered());
+    receive(message("/jib/2/stop", ",f", {0}));
+    TEST_ASSERT_FALSE(osc->triggered());
+    receive(message("/jib/2/stop", ",F"));
+    TEST_ASSERT_FALSE(osc->triggered());
+}
+
+//Each of our addresses a pattern matches comes out in turn, other jibs' addresses don't
+void test_wildcard_message() {
+    std::vector<OscHandler::Address> matched = receive(message("/jib/*/{pan,tilt,zoom}/speed", ",f", {0.5}));
+    TEST_ASSERT_EQUAL(3, matched.size());
+    TEST_ASSERT_EQUAL(OscHandler::PanSpeed, matched[0]);
+    TEST_ASSERT_EQUAL(OscHandler::TiltSpeed, matched[1]);
+    TEST_ASSERT_EQUAL(OscHandler::ZoomSpeed, matched[2]);
+    TEST_ASSERT_EQUAL(0, receive(message("/jib/3/stop")).size());
+    TEST_ASSERT_EQUAL(0, receive(message("/jib/2/unknown")).size());
+}
+
+void test_bundle() {
+    std::vector<uint8_t> packet;
+    putString(packet, "#bundle");
+    put32(packet, 0);
+    put32(packet, 1);
+    std::vector<uint8_t> first = message("/jib/2/preset/recall", ",i", {4});
+    std::vector<uint8_t> second = message("/jib/2/go");
+    put32(packet, first.size());
+    packet.insert(packet.end(), first.begin(), first.end());
+    put32(packet, second.size());
+    packet.insert(packet.end(), second.begin(), second.end());
+
+    udp->receive(packet);
+    TEST_ASSERT_TRUE(osc->process());
+    TEST_ASSERT_EQUAL(OscHandler::PresetRecall, osc->address());
+    TEST_ASSERT_EQUAL(4, osc->intArgument(0));
+    TEST_ASSERT_TRUE(osc->process());
+    TEST_ASSERT_EQUAL(OscHandler::Go, osc->address());
+    TEST_ASSERT_EQUAL(0, osc->argumentCount());
+    TEST_ASSERT_FALSE(osc->process());
+}
+
+void test_malformed() {
+    //Argument missing off the end
+    std::vector<uint8_t> packet = message("/jib/2/preset/store", ",i");
+    TEST_ASSERT_EQUAL(0, receive(packet).size());
+    //Address not ended
+    packet = {'/', 'j', 'i', 'b'};
+    TEST_ASSERT_EQUAL(0, receive(packet).size());
+    //Bundle element longer than the packet
+    packet.clear();
+    putString(packet, "#bundle");
+    put32(packet, 0);
+    put32(packet, 1);
+    put32(packet, 64);
+    std::vector<uint8_t> stop = message("/jib/2/stop");
+    packet.insert(packet.end(), stop.begin(), stop.end());
+    TEST_ASSERT_EQUAL(0, receive(packet).size());
+    //Blob sizes that would run past the end, the huge one would wrap back to before the message if it was added
+    uint32_t blobSizes[] = {0xFFFFFFF0, 0x7FFFFFFF, 9};
+    for(uint32_t size : blobSizes) {
+        packet = message("/jib/2/position", ",bf");
+        put32(packet, size);
+        packet.insert(packet.end(), 8, 0);
+        putFloat(packet, 0.5);
+        TEST_ASSERT_EQUAL(0, receive(packet).size());
+    }
+    //64 bit argument cut short
+    packet = message("/jib/2/position", ",hf");
+    put32(packet, 0);
+    TEST_ASSERT_EQUAL(0, receive(packet).size());
+    //Too big for the buffer
+    packet = message("/jib/2/stop");
+    packet.resize(OSC_PACKET_SIZE + 1);
+    TEST_ASSERT_EQUAL(0, receive(packet).size());
+    TEST_ASSERT_EQUAL(1, osc->dropped());
+    //Still working after all of that
+    TEST_ASSERT_EQUAL(1, receive(message("/jib/2/stop")).size());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_match_plain);
+    RUN_TEST(test_match_wildcards);
+    RUN_TEST(test_match_parts);
+    RUN_TEST(test_arguments);
+    RUN_TEST(test_skipped_types);
+    RUN_TEST(test_buttons);
+    RUN_TEST(test_wildcard_message);
+    RUN_TEST(test_bundle);
+    RUN_TEST(test_malformed);
+    return UNITY_END();
+}
@@ -0,0 +1,142 @@
+//Recorder encoding and playback, run on the host with pio test -e native
+
+#include <unity.h>
+#include <vector>
+
+#define RECORDER_TICK 40
+#define RECORDER_BUFFER_SIZE 256
+#include "../../src/controlPanel/recorder.h"
+
+struct Sample {
+    int32_t x;
+    int32_t y;
+    int8_t zoom;
+};
+
+Recorder recorder;
+
+//Record the samples then play them back, checking every tick comes out as it went in
+void roundTrip(int32_t startX, int32_t startY, const std::vector<Sample> &samples) {
+    recorder.startRecording(startX, startY, 1234);
+    for(const Sample &sample : samples){TEST_ASSERT_TRUE(recorder.addSample(sample.x, sample.y, sample.zoom));}
+    recorder.stop();
+
+    TEST_ASSERT_EQUAL(RECORDER_TICK, recorder.tick());
+    TEST_ASSERT_EQUAL(startX, recorder.startX());
+    TEST_ASSERT_EQUAL(startY, recorder.startY());
+    TEST_ASSERT_EQUAL(1234, recorder.startZoom());
+    TEST_ASSERT_TRUE(recorder.startPositioning());
+    recorder.startPlaying();
+    for(const Sample &sample : samples) {
+        int32_t x, y;
+        int8_t zoom;
+        TEST_ASSERT_TRUE(recorder.nextSample(x, y, zoom));
+        TEST_ASSERT_EQUAL(sample.x, x);
+        TEST_ASSERT_EQUAL(sample.y, y);
+        TEST_ASSERT_EQUAL(sample.zoom, zoom);
+    }
+    int32_t x, y;
+    int8_t zoom;
+    TEST_ASSERT_FALSE(recorder.nextSample(x, y, zoom));
+    TEST_ASSERT_EQUAL(Recorder::State::Idle, recorder.state());
+}
+
+void setUp() {
+    recorder = Recorder();
+}
+
+void tearDown() {}
+
+void test_small_steps() {
+    std::vector<Sample> samples;
+    int32_t x = -500000, y = 70000;
+    for(int i = 0; i < 50; i++) {
+        x += (i * 13) % 255 - 127;
+        y -= (i * 7) % 200 - 90;
+        samples.push_back({x, y, 0});
+    }
+    roundTrip(-500000, 70000, samples);
+    TEST_ASSERT_EQUAL(RECORDER_HEADER_SIZE + 50 * 2, recorder.length());
+}
+
+//-128 is the escape so a step of it has to go as a large sample, as does anything past +-127
+void test_large_steps_and_zoom() {
+    std::vector<Sample> samples = {
+        {-128, 0, 0},
+        {-128, 127, 0},
+        {1000, -2000, 5},
+        {1000, -2000, 5},
+        {1001, -2128, -3},
+        {-31767, 30000, -3},
+        {-31767, 30000, 0}
+    };
+    roundTrip(0, 0, samples);
+    //Large, small, zoom + large, small, zoom + large, large, zoom + small
+    TEST_ASSERT_EQUAL(RECORDER_HEADER_SIZE + 6 + 2 + 9 + 2 + 9 + 6 + 5, recorder.length());
+}
+
+//Steps beyond 16 bits are cut to what fits, playback follows the recording rather than the head
+void test_clamped_step() {
+    recorder.startRecording(0, 0, 0);
+    TEST_ASSERT_TRUE(recorder.addSample(100000, 0, 0));
+    TEST_ASSERT_TRUE(recorder.addSample(100000, 0, 0));
+    recorder.stop();
+    recorder.startPositioning();
+    recorder.startPlaying();
+    int32_t x, y;
+    int8_t zoom;
+    TEST_ASSERT_TRUE(recorder.nextSample(x, y, zoom));
+    TEST_ASSERT_EQUAL(32767, x);
+    TEST_ASSERT_TRUE(recorder.nextSample(x, y, zoom));
+    TEST_ASSERT_EQUAL(65534, x);
+}
+
+void test_full_buffer_stops_recording() {
+    recorder.startRecording(0, 0, 0);
+    int samples = 0;
+    while(recorder.addSample((samples + 1) * 1000, 0, 0)){samples++;}
+    TEST_ASSERT_EQUAL(Recorder::State::Idle, recorder.state());
+    TEST_ASSERT_EQUAL((RECORDER_BUFFER_SIZE - RECORDER_HEADER_SIZE - RECORDER_MAX_SAMPLE_SIZE) / 6 + 1, samples);
+    TEST_ASSERT_TRUE(recorder.length() <= RECORDER_BUFFER_SIZE);
+    TEST_ASSERT_FALSE(recorder.addSample(0, 0, 0));
+}
+
+//A recording sent to the server in chunks and back is kept only when the length and CRC match
+void test_upload() {
+    std::vector<Sample> samples = {{10, 10, 0}, {500, 20, 2}, {510, 20, 2}};
+    roundTrip(7, 8, samples);
+    std::vector<int> data(recorder.data(), recorder.data() + recorder.length());
+    uint16_t length = recorder.length();
+    uint16_t crc = recorder.crc();
+
+    Recorder copy;
+    for(uint16_t offset = 0; offset < length; offset += 10) {
+        byte count = min(10, length - offset);
+        TEST_ASSERT_TRUE(copy.writeChunk(offset, data.data() + offset, count));
+    }
+    TEST_ASSERT_FALSE(copy.hasRecording());
+    TEST_ASSERT_FALSE(copy.finishUpload(length, crc ^ 1));
+    TEST_ASSERT_FALSE(copy.hasRecording());
+    TEST_ASSERT_TRUE(copy.finishUpload(length, crc));
+    TEST_ASSERT_EQUAL(crc, copy.crc());
+    recorder = copy;
+    recorder.startPositioning();
+    recorder.startPlaying();
+    for(const Sample &sample : samples) {
+        int32_t x, y;
+        int8_t zoom;
+        TEST_ASSERT_TRUE(recorder.nextSample(x, y, zoom));
+        TEST_ASSERT_EQUAL(sample.x, x);
+        TEST_ASSERT_EQUAL(sample.zoom, zoom);
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_small_steps);
+    RUN_TEST(test_large_steps_and_zoom);
+    RUN_TEST(test_clamped_step);
+    RUN_TEST(test_full_buffer_stops_recording);
+    RUN_TEST(test_upload);
+    return UNITY_END();
+}
@@ -0,0 +1,186 @@
+//Reliable commands and their duplicate suppression, run on the host with pio test -e native. Authentication is on so
+//retries carry new counters like they do from the server
+
+#include <unity.h>
+#include <vector>
+
+#define NETWORK_AUTHENTICATION
+#include "../../src/controlPanel/networkHandler.cpp"
+
+#define ID 3
+#define SERVER 250
+#define INCOMING_PORT 6000
+#define OUTGOING_PORT 6001
+#define PASSWORD "password"
+
+byte mac[6] = {0};
+NetworkHandler *network;
+EthernetUDP *udp;
+SipHash sipHash;
+uint32_t counter;
+
+//A signed packet from the server
+std::vector<uint8_t> sign(std::vector<uint8_t> packet, uint32_t count) {
+    packet.push_back(SERVER);
+    for(int i = 0; i < 4; i++){packet.push_back(count >> (i * 8));}
+    uint64_t tag = sipHash.hash(packet.data(), packet.size());
+    packet.insert(packet.end(), (uint8_t *)&tag, (uint8_t *)&tag + 8);
+    return packet;
+}
+
+//Queue a reliable command and process it
+bool receive(uint16_t sequence, CommandType type, int command, int value, IPAddress from = IPAddress(10, 0, 0, 1)) {
+    std::vector<uint8_t> packet = {'K', 'J', 'I', 'B', ID, (uint8_t)(type | NETWORK_RELIABLE), (uint8_t)command, (uint8_t)value, 0,
+        (uint8_t)(sequence >> 8), (uint8_t)sequence};
+    udp->sent.clear();
+    udp->receive(sign(packet, ++counter), from);
+    return network->process();
+}
+
+//Check the only packet sent is an acknowledge of the command with the result and return the ip it went to
+IPAddress checkResult(uint16_t sequence, CommandType type, int command, CommandResult result) {
+    TEST_ASSERT_EQUAL(1, udp->sent.size());
+    std::vector<uint8_t> data = udp->sent[0].data;
+    TEST_ASSERT_EQUAL(OUTGOING_PORT, udp->sent[0].port);
+    TEST_ASSERT_EQUAL(13 + NETWORK_AUTH_SIZE, data.size());
+    uint8_t expected[] = {'K', 'J', 'I', 'B', ID, Control, Acknowledge, (uint8_t)result, 4, (uint8_t)(sequence >> 8), (uint8_t)sequence, (uint8_t)type, (uint8_t)command, ID};
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, data.data(), sizeof(expected));
+    uint64_t tag = sipHash.hash(data.data(), data.size() - NETWORK_AUTH_TAG_SIZE);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY((uint8_t *)&tag, data.data() + data.size() - NETWORK_AUTH_TAG_SIZE, NETWORK_AUTH_TAG_SIZE);
+    return udp->sent[0].ip;
+}
+
+void setUp() {
+    counter = 0;
+    sipHash.setKey(PASSWORD);
+    network = new NetworkHandler(ID, INCOMING_PORT, OUTGOING_PORT, PASSWORD, mac, IPAddress(10, 0, 0, 2));
+    TEST_ASSERT_TRUE(network->begin());
+    udp = EthernetUDP::on(INCOMING_PORT);
+}
+
+void tearDown() {
+    delete network;
+}
+
+//A retry of a command already run isn't run again, it gets the first answer again
+void test_retry_is_answered_not_run() {
+    TEST_ASSERT_TRUE(receive(7, Movement, Stop, 0));
+    TEST_ASSERT_TRUE(network->reliable());
+    TEST_ASSERT_EQUAL(Movement, network->type());
+    TEST_ASSERT_EQUAL(Stop, network->command());
+    TEST_ASSERT_EQUAL(0, udp->sent.size());
+    network->acknowledge(CommandOk);
+    TEST_ASSERT_TRUE(checkResult(7, Movement, Stop, CommandOk) == IPAddress(10, 0, 0, 1));
+
+    TEST_ASSERT_FALSE(receive(7, Movement, Stop, 0));
+    TEST_ASSERT_EQUAL(1, network->duplicates());
+    checkResult(7, Movement, Stop, CommandOk);
+}
+
+//A NACK is final, a retry is told the same
+void test_nack_is_repeated() {
+    TEST_ASSERT_TRUE(receive(300, Movement, Preset, 9));
+    network->acknowledge(CommandNotFound);
+    checkResult(300, Movement, Preset, CommandNotFound);
+    TEST_ASSERT_FALSE(receive(300, Movement, Preset, 9));
+    checkResult(300, Movement, Preset, CommandNotFound);
+}
+
+//Only the first acknowledge of a command sends anything, unreliable commands are never answered
+void test_acknowledge_once() {
+    TEST_ASSERT_TRUE(receive(1, Movement, Stop, 0));
+    network->acknowledge(CommandOk);
+    udp->sent.clear();
+    network->acknowledge(CommandRefused);
+    TEST_ASSERT_EQUAL(0, udp->sent.size());
+
+    std::vector<uint8_t> packet = {'K', 'J', 'I', 'B', ID, Movement, Stop, 0, 0};
+    udp->receive(sign(packet, ++counter));
+    TEST_ASSERT_TRUE(network->process());
+    TEST_ASSERT_FALSE(network->reliable());
+    network->acknowledge(CommandOk);
+    TEST_ASSERT_EQUAL(0, udp->sent.size());
+}
+
+//Sequence numbers are per sender, the same one from another address is a different command
+void test_sequence_per_sender() {
+    TEST_ASSERT_TRUE(receive(5, Movement, Stop, 0, IPAddress(10, 0, 0, 1)));
+    network->acknowledge(CommandOk);
+    TEST_ASSERT_TRUE(receive(5, Movement, Stop, 0, IPAddress(10, 0, 0, 20)));
+    network->acknowledge(CommandOk);
+    TEST_ASSERT_TRUE(checkResult(5, Movement, Stop, CommandOk) == IPAddress(10, 0, 0, 20));
+    TEST_ASSERT_EQUAL(0, network->duplicates());
+}
+
+//Only the last NETWORK_DUPLICATE_WINDOW commands are remembered
+void test_window() {
+    for(uint16_t sequence = 0; sequence < NETWORK_DUPLICATE_WINDOW; sequence++) {
+        TEST_ASSERT_TRUE(receive(sequence, Movement, Stop, 0));
+        network->acknowledge(CommandOk);
+    }
+    TEST_ASSERT_FALSE(receive(0, Movement, Stop, 0));
+    TEST_ASSERT_FALSE(receive(NETWORK_DUPLICATE_WINDOW - 1, Movement, Stop, 0));
+    TEST_ASSERT_TRUE(receive(NETWORK_DUPLICATE_WINDOW, Movement, Stop, 0));
+    network->acknowledge(CommandOk);
+    TEST_ASSERT_TRUE(receive(0, Movement, Stop, 0));
+    TEST_ASSERT_EQUAL(2, network->duplicates());
+}
+
+//The window is shared, commands from another sender push the first sender's out of it
+void test_window_shared() {
+    TEST_ASSERT_TRUE(receive(1, Movement, Stop, 0, IPAddress(10, 0, 0, 1)));
+    network->acknowledge(CommandOk);
+    for(uint16_t sequence = 0; sequence < NETWORK_DUPLICATE_WINDOW - 1; sequence++) {
+        TEST_ASSERT_TRUE(receive(sequence, Movement, Stop, 0, IPAddress(10, 0, 0, 20)));
+        network->acknowledge(CommandOk);
+    }
+    TEST_ASSERT_FALSE(receive(1, Movement, Stop, 0, IPAddress(10, 0, 0, 1)));
+    TEST_ASSERT_TRUE(receive(NETWORK_DUPLICATE_WINDOW, Movement, Stop, 0, IPAddress(10, 0, 0, 20)));
+    network->acknowledge(CommandOk);
+    TEST_ASSERT_TRUE(receive(1, Movement, Stop, 0, IPAddress(10, 0, 0, 1)));
+    TEST_ASSERT_EQUAL(1, network->duplicates());
+}
+
+//Sending the same packet again isn't a retry, its counter has been used so it is dropped before the duplicate check
+void test_replayed_packet_dropped() {
+    std::vector<uint8_t> packet = {'K', 'J', 'I', 'B', ID, Movement | NETWORK_RELIABLE, Stop, 0, 0, 0, 1};
+    std::vector<uint8_t> signedPacket = sign(packet, 10);
+    udp->receive(signedPacket);
+    TEST_ASSERT_TRUE(network->process());
+    network->acknowledge(CommandOk);
+    udp->sent.clear();
+    udp->receive(signedPacket);
+    TEST_ASSERT_FALSE(network->process());
+    TEST_ASSERT_EQUAL(0, udp->sent.size());
+    TEST_ASSERT_EQUAL(1, network->authFailures());
+    TEST_ASSERT_EQUAL(0, network->duplicates());
+}
+
+//A command that comes in while setup waits for the server isn't run, so it and its retries are refused
+void test_refused_while_connecting() {
+    std::vector<uint8_t> move = {'K', 'J', 'I', 'B', ID, Movement | NETWORK_RELIABLE, RelMove, 0, 0, 0, 9};
+    std::vector<uint8_t> reply = {'K', 'J', 'I', 'B', ID, Control, Ping, 0, 0};
+    udp->receive(sign(move, ++counter));
+    udp->receive(sign(reply, ++counter));
+    TEST_ASSERT_TRUE(network->serverConnected());
+    //The ping then the NACK
+    TEST_ASSERT_EQUAL(2, udp->sent.size());
+    udp->sent.erase(udp->sent.begin());
+    checkResult(9, Movement, RelMove, CommandRefused);
+
+    TEST_ASSERT_FALSE(receive(9, Movement, RelMove, 0));
+    checkResult(9, Movement, RelMove, CommandRefused);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_retry_is_answered_not_run);
+    RUN_TEST(test_nack_is_repeated);
+    RUN_TEST(test_acknowledge_once);
+    RUN_TEST(test_sequence_per_sender);
+    RUN_TEST(test_window);
+    RUN_TEST(test_window_shared);
+    RUN_TEST(test_replayed_packet_dropped);
+    RUN_TEST(test_refused_while_connecting);
+    return UNITY_END();
+}
@@ -0,0 +1,115 @@
+//sACN / E1.31 input, run on the host with pio test -e native. Art-Net is in test_artnet
+
+#include <unity.h>
+#include <vector>
+
+#define DMX_SACN
+#include "../../src/controlPanel/dmxHandler.h"
+
+#define UNIVERSE 7
+#define START_ADDRESS 1
+
+DmxHandler *dmx;
+EthernetUDP *udp;
+
+void put16(std::vector<uint8_t> &packet, int offset, uint16_t value) {
+    packet[offset] = value >> 8;
+    packet[offset + 1] = value & 0xFF;
+}
+
+//An E1.31 data packet with a null start code and the slots given
+std::vector<uint8_t> e131(uint16_t universe, byte sequence, std::vector<uint8_t> slots, byte options = 0) {
+    std::vector<uint8_t> packet(DMX_SACN_HEADER_SIZE, 0);
+    put16(packet, 0, 0x0010);
+    memcpy(packet.data() + 4, "ASC-E1.17\0\0\0", 12);
+    put16(packet, 20, 0x0004);
+    put16(packet, 42, 0x0002);
+    memcpy(packet.data() + 44, "console", 7);
+    packet[108] = 100;
+    packet[111] = sequence;
+    packet[112] = options;
+    put16(packet, 113, universe);
+    packet[117] = 0x02;
+    packet[118] = 0xA1;
+    put16(packet, 121, 1);
+    put16(packet, 123, slots.size() + 1);
+    packet.insert(packet.end(), slots.begin(), slots.end());
+    return packet;
+}
+
+bool receive(const std::vector<uint8_t> &packet) {
+    udp->receive(packet);
+    return dmx->process();
+}
+
+void setUp() {
+    stub::clock() = 0;
+    dmx = new DmxHandler(UNIVERSE, START_ADDRESS);
+    TEST_ASSERT_TRUE(dmx->begin());
+    udp = EthernetUDP::on(DMX_SACN_PORT);
+}
+
+void tearDown() {
+    delete dmx;
+}
+
+void test_channels() {
+    TEST_ASSERT_TRUE(receive(e131(UNIVERSE, 1, {0xAB, 0xCD, 0x01, 0x02, 255, 10, 70, 99})));
+    TEST_ASSERT_EQUAL_HEX16(0xABCD, dmx->pan());
+    TEST_ASSERT_EQUAL_HEX16(0x0102, dmx->tilt());
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 1.0, dmx->speed());
+    TEST_ASSERT_EQUAL(10, dmx->channel(DmxHandler::Zoom));
+    TEST_ASSERT_EQUAL(70, dmx->channel(DmxHandler::Focus));
+}
+
+void test_header_checks() {
+    TEST_ASSERT_FALSE(receive(e131(UNIVERSE + 1, 1, {1})));
+
+    std::vector<uint8_t> packet = e131(UNIVERSE, 1, {1});
+    packet[4] = 'B';
+    TEST_ASSERT_FALSE(receive(packet));
+    packet = e131(UNIVERSE, 1, {1});
+    put16(packet, 20, 0x0008);     //Extended root vector, synchronisation and discovery
+    TEST_ASSERT_FALSE(receive(packet));
+    packet = e131(UNIVERSE, 1, {1});
+    put16(packet, 42, 0x0001);
+    TEST_ASSERT_FALSE(receive(packet));
+    packet = e131(UNIVERSE, 1, {1});
+    packet[117] = 0x01;
+    TEST_ASSERT_FALSE(receive(packet));
+    packet = e131(UNIVERSE, 1, {1});
+    packet[125] = 0xDD;             //Per slot priority, not levels
+    TEST_ASSERT_FALSE(receive(packet));
+    packet = e131(UNIVERSE, 1, {1});
+    packet.resize(DMX_SACN_HEADER_SIZE - 1);
+    TEST_ASSERT_FALSE(receive(packet));
+    TEST_ASSERT_EQUAL(0, dmx->frames());
+}
+
+//Preview data is ignored, a terminated stream stops us receiving straight away
+void test_options() {
+    TEST_ASSERT_FALSE(receive(e131(UNIVERSE, 1, {5}, 0x80)));
+    TEST_ASSERT_TRUE(receive(e131(UNIVERSE, 2, {6})));
+    TEST_ASSERT_TRUE(dmx->receiving(1000));
+    TEST_ASSERT_FALSE(receive(e131(UNIVERSE, 3, {7}, 0x40)));
+    TEST_ASSERT_FALSE(dmx->receiving(1000));
+    TEST_ASSERT_EQUAL(6, dmx->channel(DmxHandler::PanCoarse));
+}
+
+//sACN sequence 0 is just the next after 255, there is no unnumbered case
+void test_sequence() {
+    TEST_ASSERT_TRUE(receive(e131(UNIVERSE, 255, {1})));
+    TEST_ASSERT_TRUE(receive(e131(UNIVERSE, 0, {2})));
+    TEST_ASSERT_FALSE(receive(e131(UNIVERSE, 0, {3})));
+    TEST_ASSERT_FALSE(receive(e131(UNIVERSE, 250, {3})));
+    TEST_ASSERT_EQUAL(2, dmx->channel(DmxHandler::PanCoarse));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_channels);
+    RUN_TEST(test_header_checks);
+    RUN_TEST(test_options);
+    RUN_TEST(test_sequence);
+    return UNITY_END();
+}
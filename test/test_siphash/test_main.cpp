@@ -0,0 +1,95 @@
+//SipHash-2-4 against the reference vectors and a benchmark, run on the host with pio test -e native
+
+#include <unity.h>
+#include <stdio.h>
+#include <chrono>
+#include "../../src/controlPanel/sipHash.h"
+
+//Reference outputs from the SipHash paper for key 00 01 .. 0f and message 00 01 .. length - 1, little endian
+struct Vector {
+    uint8_t length;
+    uint8_t hash[8];
+};
+
+const Vector vectors[] = {
+    {0, {0x31, 0x0e, 0x0e, 0xdd, 0x47, 0xdb, 0x6f, 0x72}},
+    {1, {0xfd, 0x67, 0xdc, 0x93, 0xc5, 0x39, 0xf8, 0x74}},
+    {2, {0x5a, 0x4f, 0xa9, 0xd9, 0x09, 0x80, 0x6c, 0x0d}},
+    {3, {0x2d, 0x7e, 0xfb, 0xd7, 0x96, 0x66, 0x67, 0x85}},
+    {4, {0xb7, 0x87, 0x71, 0x27, 0xe0, 0x94, 0x27, 0xcf}},
+    {5, {0x8d, 0xa6, 0x99, 0xcd, 0x64, 0x55, 0x76, 0x18}},
+    {6, {0xce, 0xe3, 0xfe, 0x58, 0x6e, 0x46, 0xc9, 0xcb}},
+    {7, {0x37, 0xd1, 0x01, 0x8b, 0xf5, 0x00, 0x02, 0xab}},
+    {8, {0x62, 0x24, 0x93, 0x9a, 0x79, 0xf5, 0xf5, 0x93}},
+    {9, {0xb0, 0xe4, 0xa9, 0x0b, 0xdf, 0x82, 0x00, 0x9e}},
+    {15, {0xe5, 0x45, 0xbe, 0x49, 0x61, 0xca, 0x29, 0xa1}},
+    {16, {0xdb, 0x9b, 0xc2, 0x57, 0x7f, 0xcc, 0x2a, 0x3f}},
+    {17, {0x94, 0x47, 0xbe, 0x2c, 0xf5, 0xe9, 0x9a, 0x69}},
+    {31, {0x42, 0xc3, 0x41, 0xd8, 0xfa, 0x92, 0xd8, 0x32}},
+    {32, {0xce, 0x7c, 0xf2, 0x72, 0x2f, 0x51, 0x27, 0x71}},
+    {63, {0x72, 0x45, 0x06, 0xeb, 0x4c, 0x32, 0x8a, 0x95}}
+};
+
+uint8_t key[16];
+uint8_t message[64];
+
+void setUp() {
+    for(uint8_t i = 0; i < 16; i++){key[i] = i;}
+    for(uint8_t i = 0; i < 64; i++){message[i] = i;}
+}
+
+void tearDown() {}
+
+void test_reference_vectors() {
+    SipHash sipHash;
+    sipHash.setKey(key);
+    for(const Vector &vector : vectors) {
+        uint64_t hash = sipHash.hash(message, vector.length);
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(vector.hash, (uint8_t *)&hash, 8);
+    }
+}
+
+//The key from a password is the hash of it with 0 then 1 on the end, under a zero key
+void test_password_key() {
+    uint8_t zero[16] = {0};
+    SipHash derive;
+    derive.setKey(zero);
+    uint8_t buffer[] = {'k', 'j', 'i', 'b', 0};
+    uint8_t derived[16];
+    uint64_t half = derive.hash(buffer, 5);
+    memcpy(derived, &half, 8);
+    buffer[4] = 1;
+    half = derive.hash(buffer, 5);
+    memcpy(derived + 8, &half, 8);
+
+    SipHash fromPassword, fromKey;
+    fromPassword.setKey("kjib");
+    fromKey.setKey(derived);
+    TEST_ASSERT_TRUE(fromPassword.hash(message, 20) == fromKey.hash(message, 20));
+    TEST_ASSERT_FALSE(fromPassword.hash(message, 20) == derive.hash(message, 20));
+}
+
+//Time a packet sized hash. The host only shows the relative cost of the word swap rotations, the AVR figure comes
+//from the board
+void test_benchmark() {
+    SipHash sipHash;
+    sipHash.setKey(key);
+    const uint32_t count = 200000;
+    uint64_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < count; i++) {
+        message[0] = i;
+        sink ^= sipHash.hash(message, 24);
+    }
+    double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    printf("SipHash-2-4 of 24 bytes: %.1f ns (%llx)\n", elapsed / count, (unsigned long long)sink);
+    TEST_ASSERT_TRUE(elapsed > 0);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_reference_vectors);
+    RUN_TEST(test_password_key);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
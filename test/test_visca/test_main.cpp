@@ -0,0 +1,202 @@
+//VISCA decoding and replies, run on the host with pio test -e native
+
+#include <unity.h>
+
+#define VISCA_ZOOM_STANDARD_SPEED 4
+#include "../../src/controlPanel/viscaHandler.h"
+
+#define PORT 52381
+
+ViscaHandler *visca;
+EthernetUDP *udp;
+
+//Queue a payload, wrapped in the VISCA over IP header or as plain VISCA, and process it
+bool receive(std::vector<uint8_t> payload, bool wrapped, uint16_t type = VISCA_COMMAND, uint32_t sequence = 0x01020304) {
+    std::vector<uint8_t> packet;
+    if(wrapped) {
+        packet = {(uint8_t)(type >> 8), (uint8_t)type, 0, (uint8_t)payload.size(),
+            (uint8_t)(sequence >> 24), (uint8_t)(sequence >> 16), (uint8_t)(sequence >> 8), (uint8_t)sequence};
+    }
+    packet.insert(packet.end(), payload.begin(), payload.end());
+    udp->sent.clear();
+    udp->receive(packet, IPAddress(10, 0, 0, 9), 52000);
+    return visca->process();
+}
+
+//The payload of a sent reply, checking the header when it was wrapped
+std::vector<uint8_t> reply(size_t index, bool wrapped, uint32_t sequence = 0x01020304) {
+    TEST_ASSERT_TRUE(index < udp->sent.size());
+    std::vector<uint8_t> data = udp->sent[index].data;
+    TEST_ASSERT_TRUE(udp->sent[index].ip == IPAddress(10, 0, 0, 9));
+    TEST_ASSERT_EQUAL(52000, udp->sent[index].port);
+    if(!wrapped){return data;}
+    TEST_ASSERT_TRUE(data.size() >= VISCA_HEADER_SIZE);
+    TEST_ASSERT_EQUAL_HEX16(VISCA_REPLY, data[0] << 8 | data[1]);
+    TEST_ASSERT_EQUAL(data.size() - VISCA_HEADER_SIZE, data[2] << 8 | data[3]);
+    TEST_ASSERT_EQUAL_HEX32(sequence, (uint32_t)data[4] << 24 | (uint32_t)data[5] << 16 | data[6] << 8 | data[7]);
+    return std::vector<uint8_t>(data.begin() + VISCA_HEADER_SIZE, data.end());
+}
+
+void setUp() {
+    visca = new ViscaHandler(PORT);
+    TEST_ASSERT_TRUE(visca->begin());
+    udp = EthernetUDP::on(PORT);
+}
+
+void tearDown() {
+    delete visca;
+}
+
+void test_drive() {
+    for(int wrapped = 0; wrapped < 2; wrapped++) {
+        TEST_ASSERT_TRUE(receive({0x81, 0x01, 0x06, 0x01, 0x18, 0x0A, 0x02, 0x01, 0xFF}, wrapped));
+        TEST_ASSERT_EQUAL(ViscaHandler::PanTiltDrive, visca->command());
+        TEST_ASSERT_EQUAL(1, visca->panDirection());
+        TEST_ASSERT_EQUAL(-1, visca->tiltDirection());
+        TEST_ASSERT_FLOAT_WITHIN(0.01, 100.0, visca->panSpeed());
+        TEST_ASSERT_FLOAT_WITHIN(0.01, 50.0, visca->tiltSpeed());
+
+        TEST_ASSERT_TRUE(receive({0x81, 0x01, 0x06, 0x01, 0x01, 0x01, 0x03, 0x03, 0xFF}, wrapped));
+        TEST_ASSERT_EQUAL(0, visca->panDirection());
+        TEST_ASSERT_EQUAL(0, visca->tiltDirection());
+    }
+}
+
+void test_absolute() {
+    for(int wrapped = 0; wrapped < 2; wrapped++) {
+        //Pan -2 (0xFFFE), tilt 0x0510
+        TEST_ASSERT_TRUE(receive({0x81, 0x01, 0x06, 0x02, 0x10, 0x08, 0x0F, 0x0F, 0x0F, 0x0E, 0x00, 0x05, 0x01, 0x00, 0xFF}, wrapped));
+        TEST_ASSERT_EQUAL(ViscaHandler::PanTiltAbsolute, visca->command());
+        TEST_ASSERT_EQUAL(-2, visca->pan());
+        TEST_ASSERT_EQUAL(0x0510, visca->tilt());
+
+        TEST_ASSERT_TRUE(receive({0x81, 0x01, 0x06, 0x03, 0x10, 0x08, 0x00, 0x00, 0x01, 0x00, 0x0F, 0x0F, 0x0F, 0x00, 0xFF}, wrapped));
+        TEST_ASSERT_EQUAL(ViscaHandler::PanTiltRelative, visca->command());
+        TEST_ASSERT_EQUAL(16, visca->pan());
+        TEST_ASSERT_EQUAL(-16, visca->tilt());
+    }
+}
+
+void test_zoom() {
+    for(int wrapped = 0; wrapped < 2; wrapped++) {
+        TEST_ASSERT_TRUE(receive({0x81, 0x01, 0x04, 0x07, 0x02, 0xFF}, wrapped));
+        TEST_ASSERT_EQUAL(ViscaHandler::Zoom, visca->command());
+        TEST_ASSERT_EQUAL(VISCA_ZOOM_STANDARD_SPEED, visca->zoomSpeed());
+        TEST_ASSERT_TRUE(receive({0x81, 0x01, 0x04, 0x07, 0x03, 0xFF}, wrapped));
+        TEST_ASSERT_EQUAL(-VISCA_ZOOM_STANDARD_SPEED, visca->zoomSpeed());
+        TEST_ASSERT_TRUE(receive({0x81, 0x01, 0x04, 0x07, 0x25, 0xFF}, wrapped));
+        TEST_ASSERT_EQUAL(6, visca->zoomSpeed());
+        TEST_ASSERT_TRUE(receive({0x81, 0x01, 0x04, 0x07, 0x37, 0xFF}, wrapped));
+        TEST_ASSERT_EQUAL(-8, visca->zoomSpeed());
+        TEST_ASSERT_TRUE(receive({0x81, 0x01, 0x04, 0x07, 0x00, 0xFF}, wrapped));
+        TEST_ASSERT_EQUAL(0, visca->zoomSpeed());
+
+        TEST_ASSERT_TRUE(receive({0x81, 0x01, 0x04, 0x47, 0x01, 0x02, 0x03, 0x04, 0xFF}, wrapped));
+        TEST_ASSERT_EQUAL(ViscaHandler::ZoomDirect, visca->command());
+        TEST_ASSERT_EQUAL_HEX16(0x1234, visca->zoomPosition());
+    }
+}
+
+void test_preset() {
+    for(int wrapped = 0; wrapped < 2; wrapped++) {
+        TEST_ASSERT_TRUE(receive({0x81, 0x01, 0x04, 0x3F, 0x02, 0x05, 0xFF}, wrapped));
+        TEST_ASSERT_EQUAL(ViscaHandler::Preset, visca->command());
+        TEST_ASSERT_EQUAL(2, visca->presetAction());
+        TEST_ASSERT_EQUAL(5, visca->presetNumber());
+        TEST_ASSERT_TRUE(receive({0x81, 0x01, 0x04, 0x3F, 0x01, 0x00, 0xFF}, wrapped));
+        TEST_ASSERT_EQUAL(1, visca->presetAction());
+        TEST_ASSERT_FALSE(receive({0x81, 0x01, 0x04, 0x3F, 0x03, 0x00, 0xFF}, wrapped));
+    }
+}
+
+//Commands are ACKed straight away and completed once run, only once
+void test_ack_and_completion() {
+    for(int wrapped = 0; wrapped < 2; wrapped++) {
+        TEST_ASSERT_TRUE(receive({0x81, 0x01, 0x06, 0x04, 0xFF}, wrapped));
+        TEST_ASSERT_EQUAL(ViscaHandler::PanTiltHome, visca->command());
+        TEST_ASSERT_EQUAL(1, udp->sent.size());
+        const uint8_t ack[] = {0x90, 0x41, 0xFF};
+        std::vector<uint8_t> sent = reply(0, wrapped);
+        TEST_ASSERT_EQUAL(sizeof(ack), sent.size());
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(ack, sent.data(), sizeof(ack));
+
+        visca->complete();
+        visca->complete();
+        TEST_ASSERT_EQUAL(2, udp->sent.size());
+        const uint8_t completion[] = {0x90, 0x51, 0xFF};
+        sent = reply(1, wrapped);
+        TEST_ASSERT_EQUAL(sizeof(completion), sent.size());
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(completion, sent.data(), sizeof(completion));
+
+        TEST_ASSERT_TRUE(receive({0x81, 0x01, 0x04, 0x3F, 0x02, 0x05, 0xFF}, wrapped));
+        visca->notExecutable();
+        const uint8_t error[] = {0x90, 0x61, 0x41, 0xFF};
+        sent = reply(1, wrapped);
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(error, sent.data(), sizeof(error));
+    }
+}
+
+void test_syntax_error() {
+    const std::vector<std::vector<uint8_t>> bad = {
+        {0x81, 0x01, 0x04, 0x99, 0xFF},                         //Unknown command
+        {0x81, 0x01, 0x06, 0x01, 0x18, 0x14, 0x04, 0x01, 0xFF}, //Bad direction
+        {0x81, 0x01, 0x06, 0x02, 0x10, 0x08, 0x00, 0xFF},       //Too short
+        {0x81, 0x01, 0x04, 0x07, 0x02, 0x00},                   //No terminator
+    };
+    for(int wrapped = 0; wrapped < 2; wrapped++) {
+        for(const std::vector<uint8_t> &payload : bad) {
+            TEST_ASSERT_FALSE(receive(payload, wrapped));
+            TEST_ASSERT_EQUAL(1, udp->sent.size());
+            const uint8_t error[] = {0x90, 0x60, 0x02, 0xFF};
+            std::vector<uint8_t> sent = reply(0, wrapped);
+            TEST_ASSERT_EQUAL(sizeof(error), sent.size());
+            TEST_ASSERT_EQUAL_HEX8_ARRAY(error, sent.data(), sizeof(error));
+        }
+    }
+}
+
+//Inquiries get no ACK, the answer is the reply
+void test_inquiry() {
+    TEST_ASSERT_TRUE(receive({0x81, 0x09, 0x06, 0x12, 0xFF}, true, VISCA_INQUIRY, 7));
+    TEST_ASSERT_EQUAL(ViscaHandler::PanTiltInquiry, visca->command());
+    TEST_ASSERT_EQUAL(0, udp->sent.size());
+    visca->replyPanTilt(-2, 0x1234);
+    const uint8_t position[] = {0x90, 0x50, 0x0F, 0x0F, 0x0F, 0x0E, 0x01, 0x02, 0x03, 0x04, 0xFF};
+    std::vector<uint8_t> sent = reply(0, true, 7);
+    TEST_ASSERT_EQUAL(sizeof(position), sent.size());
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(position, sent.data(), sizeof(position));
+
+    TEST_ASSERT_TRUE(receive({0x81, 0x09, 0x04, 0x47, 0xFF}, false));
+    TEST_ASSERT_EQUAL(ViscaHandler::ZoomInquiry, visca->command());
+    visca->replyZoom(0x4000);
+    const uint8_t zoom[] = {0x90, 0x50, 0x04, 0x00, 0x00, 0x00, 0xFF};
+    sent = reply(0, false);
+    TEST_ASSERT_EQUAL(sizeof(zoom), sent.size());
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(zoom, sent.data(), sizeof(zoom));
+}
+
+//A sequence reset is answered with a control reply, a header whose length is wrong is ignored
+void test_control_and_bad_header() {
+    TEST_ASSERT_FALSE(receive({0x01}, true, VISCA_CONTROL));
+    TEST_ASSERT_EQUAL(1, udp->sent.size());
+    TEST_ASSERT_EQUAL_HEX16(VISCA_CONTROL_REPLY, udp->sent[0].data[0] << 8 | udp->sent[0].data[1]);
+    TEST_ASSERT_EQUAL_HEX8(0x01, udp->sent[0].data[VISCA_HEADER_SIZE]);
+
+    udp->sent.clear();
+    udp->receive({0x01, 0x00, 0x00, 0x09, 0, 0, 0, 1, 0x81, 0x01, 0x06, 0x04, 0xFF});
+    TEST_ASSERT_FALSE(visca->process());
+    TEST_ASSERT_EQUAL(0, udp->sent.size());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_drive);
+    RUN_TEST(test_absolute);
+    RUN_TEST(test_zoom);
+    RUN_TEST(test_preset);
+    RUN_TEST(test_ack_and_completion);
+    RUN_TEST(test_syntax_error);
+    RUN_TEST(test_inquiry);
+    RUN_TEST(test_control_and_bad_header);
+    return UNITY_END();
+}
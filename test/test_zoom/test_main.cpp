@@ -0,0 +1,70 @@
+//Zoom position estimate, run on the host with pio test -e native
+
+#include <unity.h>
+
+#define PRESET_COUNT 16
+#define PRESET_ZOOM_TRAVEL_TIME 4000
+#include "../../src/controlPanel/presets.h"
+
+ZoomTracker *zoom;
+
+void setUp() {
+    stub::clock() = 0;
+    zoom = new ZoomTracker();
+}
+
+void tearDown() {
+    delete zoom;
+}
+
+//Step the clock a millisecond at a time reading the position each time like the loop does
+void run(unsigned long ms) {
+    for(unsigned long i = 0; i < ms; i++) {
+        delay(1);
+        zoom->position();
+    }
+}
+
+//Full speed moves 1 per ms
+void test_full_speed() {
+    zoom->setSpeed(8);
+    run(1000);
+    TEST_ASSERT_EQUAL(1000, zoom->position());
+    zoom->setSpeed(-8);
+    run(400);
+    TEST_ASSERT_EQUAL(600, zoom->position());
+}
+
+//The slow speeds move less than 1 per update, it still has to add up
+void test_slow_speed_frequent_updates() {
+    zoom->setSpeed(1);
+    run(800);
+    TEST_ASSERT_EQUAL(100, zoom->position());
+    zoom->setSpeed(3);
+    run(800);
+    TEST_ASSERT_EQUAL(400, zoom->position());
+    zoom->setSpeed(-1);
+    run(800);
+    TEST_ASSERT_EQUAL(300, zoom->position());
+}
+
+//The estimate stops at either end
+void test_ends() {
+    zoom->setSpeed(-8);
+    run(100);
+    TEST_ASSERT_EQUAL(0, zoom->position());
+    zoom->setSpeed(8);
+    run(PRESET_ZOOM_TRAVEL_TIME + 100);
+    TEST_ASSERT_EQUAL(PRESET_ZOOM_TRAVEL_TIME, zoom->position());
+    zoom->setSpeed(-1);
+    run(8);
+    TEST_ASSERT_EQUAL(PRESET_ZOOM_TRAVEL_TIME - 1, zoom->position());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_full_speed);
+    RUN_TEST(test_slow_speed_frequent_updates);
+    RUN_TEST(test_ends);
+    return UNITY_END();
+}